@@ -0,0 +1,163 @@
+/*!
+ * \file AffineExpr.hpp
+ *
+ * \brief Typed representation of the affine expressions and constraints
+ * which make up iteration spaces
+ */
+
+#ifndef SPFIE_AFFINEEXPR_HPP
+#define SPFIE_AFFINEEXPR_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BuilderSession.hpp"
+#include "clang/AST/Expr.h"
+#include "clang/AST/OperationKinds.h"
+#include "iegenlib.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+class AffineExpr;
+
+/*!
+ * \struct AffineTerm
+ *
+ * \brief One term of an AffineExpr: a coefficient multiplied by an
+ * iterator, a symbolic constant, or an uninterpreted function call
+ */
+struct AffineTerm {
+    enum class Kind { Iterator, Symbol, UFCall };
+
+    AffineTerm(Kind kind, int coefficient, std::string name)
+        : kind(kind), coefficient(coefficient), name(name), iteratorIndex(0) {}
+
+    Kind kind;
+    int coefficient;
+    //! Name of the iterator, symbolic constant, or function
+    std::string name;
+    //! Position of the iterator in the iteration tuple (iterators only)
+    unsigned int iteratorIndex;
+    //! Arguments of the call (UF calls only)
+    std::vector<std::shared_ptr<const AffineExpr>> args;
+
+    //! Check whether this term has the same iterator, symbol, or call as
+    //! another, such that the two may be combined
+    bool hasSameAtom(const AffineTerm& other) const;
+};
+
+/*!
+ * \class AffineExpr
+ *
+ * \brief An affine combination of iterators, symbolic constants, and
+ * uninterpreted function calls, plus a constant
+ */
+class AffineExpr {
+   public:
+    //! Create a constant expression
+    explicit AffineExpr(int constant = 0) : constant(constant) {}
+
+    //! Create an expression consisting of an iterator
+    //! \param[in] name Iterator name
+    //! \param[in] index Position of the iterator in the iteration tuple
+    static AffineExpr makeIterator(std::string name, unsigned int index);
+
+    //! Create an expression consisting of a symbolic constant
+    static AffineExpr makeSymbol(std::string name);
+
+    //! Create an expression consisting of an uninterpreted function call
+    static AffineExpr makeUFCall(std::string name,
+                                 const std::vector<AffineExpr>& args);
+
+    //! Build an expression from the AST, exiting with an error if it is not
+    //! affine. Array accesses become uninterpreted function calls.
+    //! \param[in] expr Expression to convert
+    //! \param[in] iterators Iterators in scope, outermost first; other
+    //! variables are treated as symbolic constants
+    //! \param[in] session Session of the builder doing the conversion
+    static AffineExpr fromExpr(Expr* expr,
+                               const std::vector<std::string>& iterators,
+                               BuilderSession& session);
+
+    //! Like fromExpr, but report an expression which is not affine instead
+    //! of exiting
+    //! \param[out] result The converted expression, on success
+    //! \param[out] nonAffine If given, set to the offending subexpression on
+    //! failure
+    //! \return whether the expression is affine
+    static bool tryFromExpr(Expr* expr,
+                            const std::vector<std::string>& iterators,
+                            BuilderSession& session, AffineExpr& result,
+                            Expr** nonAffine = nullptr);
+
+    AffineExpr operator+(const AffineExpr& other) const;
+    AffineExpr operator-(const AffineExpr& other) const;
+
+    //! Get this expression multiplied by a constant factor
+    AffineExpr scale(int factor) const;
+
+    //! Whether this expression is just a constant
+    bool isConstant() const { return terms.empty(); }
+
+    //! Get the constant part of this expression
+    int getConstant() const { return constant; }
+
+    //! Get the non-constant terms of this expression
+    const std::vector<AffineTerm>& getTerms() const { return terms; }
+
+    //! Get a string representation, like "index(i + 1) - 2*j"
+    std::string toString() const;
+
+    //! Get a string representation with iterators renamed by their position
+    //! \param[in] iterators Name to print for each iterator, outermost first
+    std::string toString(const std::vector<std::string>& iterators) const;
+
+    //! Build the equivalent IEGenLib expression, with iterators referring to
+    //! tuple variables by their position (caller adopts the result)
+    iegenlib::Exp* toIEGenLibExp() const;
+
+   private:
+    //! Non-constant terms, no two of which have the same atom
+    std::vector<AffineTerm> terms;
+    //! Constant term
+    int constant;
+
+    //! Add a term, combining it with any existing term of the same atom
+    void addTerm(const AffineTerm& term);
+
+    //! Common implementation of the toString methods
+    //! \param[in] iterators Names to print for iterators, or null to use
+    //! their own
+    std::string toString(const std::vector<std::string>* iterators) const;
+};
+
+/*!
+ * \struct Constraint
+ *
+ * \brief An (in)equality between two affine expressions
+ */
+struct Constraint {
+    Constraint(AffineExpr lhs, AffineExpr rhs, BinaryOperatorKind oper)
+        : lhs(lhs), rhs(rhs), oper(oper) {}
+
+    AffineExpr lhs;
+    AffineExpr rhs;
+    //! Comparison operator; any of <, <=, >, >=, ==
+    BinaryOperatorKind oper;
+
+    //! Get a string representation, like "0 <= i"
+    std::string toString() const;
+
+    //! Get a string representation with iterators renamed by their position
+    std::string toString(const std::vector<std::string>& iterators) const;
+
+    //! Add this constraint to an IEGenLib conjunction
+    void addToConjunction(iegenlib::Conjunction* conjunction) const;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SPFIE_BUILDERSESSION_HPP
+#define SPFIE_BUILDERSESSION_HPP
+
+#include <string>
+#include <unordered_map>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/*!
+ * \class BuilderSession
+ *
+ * \brief State used while building Computations from one translation unit
+ *
+ * Carries the ASTContext being read, whether errors in building are
+ * recoverable, the generator for replacement variable names, and memoized
+ * strings for the AST nodes of the function being built. Each
+ * SPFComputationBuilder owns its own session, so separate builders share no
+ * mutable state and may run concurrently.
+ */
+class BuilderSession {
+   public:
+    BuilderSession(const ASTContext& astContext, bool recoverableErrors);
+
+    BuilderSession(const BuilderSession&) = delete;
+    BuilderSession& operator=(const BuilderSession&) = delete;
+
+    //! Get the ASTContext of the translation unit being processed
+    const ASTContext& getASTContext() const { return astContext; }
+
+    //! Whether errors in building are passed on to the caller (so that it
+    //! may skip the function and carry on) instead of exiting
+    bool areErrorsRecoverable() const { return recoverableErrors; }
+
+    //! Get a unique variable name to use in substitutions
+    std::string getVarReplacementName();
+
+    //! Get the source code of a statement, computing it only the first time
+    //! it is requested for this function
+    const std::string& getSourceText(Stmt* stmt);
+
+    //! Get the SPF representation of an expression (see SPFExprPrinter),
+    //! computing it only the first time it is requested for this function
+    const std::string& getSPFString(Expr* expr);
+
+    //! Record an already-built SPF representation of an expression, so that
+    //! later lookups (such as from enclosing accesses) reuse it
+    void setSPFString(Expr* expr, std::string str);
+
+    //! Restart replacement variable numbering and drop memoized strings, so
+    //! that the session holds only state for the function about to be built
+    void startFunction();
+
+   private:
+    //! ASTContext of the translation unit being processed
+    const ASTContext& astContext;
+    //! Whether errors in building are passed on instead of exiting
+    const bool recoverableErrors;
+    //! Number to be used (and incremented) when creating replacement variable
+    //! names
+    unsigned int replacementVarNumber;
+    //! Memoized source code, by statement
+    std::unordered_map<const Stmt*, std::string> sourceTexts;
+    //! Memoized SPF representations, by expression
+    std::unordered_map<const Expr*, std::string> spfStrings;
+};
+
+}  // namespace spf_ie
+
+#endif
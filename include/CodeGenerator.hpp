@@ -0,0 +1,207 @@
+/*!
+ * \file CodeGenerator.hpp
+ *
+ * \brief Generation of executor code from the statements built from a
+ * function
+ */
+
+#ifndef SPFIE_CODEGENERATOR_HPP
+#define SPFIE_CODEGENERATOR_HPP
+
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "BuilderSession.hpp"
+#include "DependenceAnalysis.hpp"
+#include "LoopTiling.hpp"
+#include "StmtContext.hpp"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/*!
+ * \class CodeGenerator
+ *
+ * \brief Generates code which runs the statements of a function over their
+ * iteration spaces, in the order given by their execution schedules
+ *
+ * Loops and guards are rebuilt from the constraints of each statement's
+ * scopes, and statements are copied from the source. The outermost loop of
+ * each nest which carries no dependence, other than through its reductions,
+ * is marked parallel.
+ *
+ * When generating level sets, an outermost loop which does carry
+ * dependences, through arrays whose elements can be located before the loop
+ * runs (like x[col[k]] when col is not written in it), is instead preceded
+ * by an inspector. The inspector replays the loop's array accesses at
+ * runtime, placing each iteration one level after the latest iteration it
+ * depends on; the executor then runs the levels in order, and the
+ * iterations of each level in parallel.
+ *
+ * A tiled band of loops (see LoopTiling) is written as loops over its tiles,
+ * outermost first, around loops over the iterations of each tile. Tiles at
+ * the end of a loop's range are cut short by its own condition.
+ */
+class CodeGenerator {
+   public:
+    //! Languages code can be generated in
+    enum class Target {
+        COpenMP,          //!< C, with OpenMP pragmas on parallel loops
+        COpenMPLevelSets  //!< As COpenMP, also running outermost loops
+                          //!< which carry dependences as level sets
+    };
+
+    //! \param[in] stmtContexts Statements of the function, in order
+    //! \param[in] dependences Dependences between the statements
+    //! \param[in] session Session of the builder the statements came from
+    //! \param[in] tiledBands Bands of loops to write tiled
+    CodeGenerator(const std::vector<StmtContext>& stmtContexts,
+                  const DependenceGraph& dependences, BuilderSession& session,
+                  const std::vector<TiledBand>& tiledBands);
+
+    //! Generate a definition of the function the statements were built from
+    //! \param[in] funcDecl The function, for its signature
+    //! \param[in] target Language to generate
+    std::string generate(FunctionDecl* funcDecl, Target target);
+
+    //! Get the C form of an expression, with uninterpreted function calls as
+    //! array accesses, like "index[i + 1] - 2*j"
+    static std::string toC(const AffineExpr& expr);
+
+    //! Get the C form of a constraint, like "k < index[i + 1]"
+    static std::string toC(const Constraint& constraint);
+
+   private:
+    //! What to write in place of each statement
+    enum class StmtMode {
+        Source,         //!< the statement itself
+        CheckAccesses,  //!< inspector code finding the statement's level
+        RecordAccesses  //!< inspector code recording the statement's
+                        //!< accesses at its level
+    };
+
+    /*!
+     * \struct LevelSetArray
+     *
+     * \brief An array whose accesses are replayed by a level-set inspector
+     */
+    struct LevelSetArray {
+        std::string name;
+        //! Size of each dimension, as C expressions, outermost first
+        std::vector<std::string> extents;
+    };
+
+    const std::vector<StmtContext>& stmtContexts;
+    const DependenceGraph& dependences;
+    BuilderSession& session;
+    const std::vector<TiledBand>& tiledBands;
+    //! Language being generated
+    Target target;
+    //! Loop marked parallel which is currently open, if any
+    const Scope* parallelLoop;
+    //! Arrays replayed by the inspector being written, if any
+    std::vector<LevelSetArray> levelSetArrays;
+
+    //! Write statements, opening and closing the scopes they are nested in
+    //! \param[in] stmts Positions of the statements, in order
+    //! \param[in] numOpen Number of (outermost) scopes enclosing every one
+    //! of the statements which are already open
+    //! \param[in] depth Nesting depth of the first scope to open, counting
+    //! the function body as 1
+    //! \param[in] isParallel Whether loops may be marked parallel
+    void writeStmts(const std::vector<unsigned int>& stmts,
+                    unsigned int numOpen, unsigned int depth, StmtMode mode,
+                    bool isParallel, std::ostream& os);
+
+    //! Write one statement, or the inspector code standing in for it
+    void writeStmt(unsigned int stmtIndex, unsigned int depth, StmtMode mode,
+                   std::ostream& os);
+
+    //! Write the opening line(s) of a loop or guard
+    //! \param[in] depth Nesting depth of the scope, counting the function
+    //! body as 1
+    //! \param[in] isParallel Whether the loop may be marked parallel
+    void openScope(const Scope* scope, unsigned int depth, bool isParallel,
+                   std::ostream& os);
+
+    //! Write the header of a loop, as "for (...) {"
+    void writeLoopHeader(const Scope* loop, unsigned int depth,
+                         std::ostream& os);
+
+    //! Check whether a loop is to be run as level sets, and if so, get the
+    //! arrays its inspector must replay the accesses of
+    bool getLevelSetArrays(const Scope* loop,
+                           std::vector<LevelSetArray>& arrays) const;
+
+    //! Write the inspector and executor running a loop as level sets
+    //! \param[in] stmts Positions of the statements in the loop
+    //! \param[in] numOpen Number of scopes enclosing the loop
+    //! \param[in] depth Nesting depth of the loop
+    void writeLevelSets(const Scope* loop,
+                        const std::vector<unsigned int>& stmts,
+                        unsigned int numOpen, unsigned int depth,
+                        std::ostream& os);
+
+    //! Get the tiled band starting at a loop, if there is one
+    const TiledBand* getTiledBand(const Scope* loop) const;
+
+    //! Write the loops over the tiles of a band, then over the iterations of
+    //! each tile
+    //! \param[in] stmts Positions of the statements in the band
+    //! \param[in] numOpen Number of scopes enclosing the band
+    //! \param[in] depth Nesting depth of the band
+    //! \param[in] isParallel Whether loops may be marked parallel
+    void writeTiledBand(const TiledBand& band,
+                        const std::vector<unsigned int>& stmts,
+                        unsigned int numOpen, unsigned int depth,
+                        bool isParallel, std::ostream& os);
+
+    //! Write the OpenMP pragma marking a loop parallel, if it can be
+    //! \param[in] isIteratorPrivate Whether the loop's own iterator is
+    //! already private to its iterations
+    void writeParallelPragma(const Scope* loop, unsigned int depth,
+                             bool isIteratorPrivate, std::ostream& os);
+
+    //! Get the positions of the statements in a scope
+    std::vector<unsigned int> getStmtsIn(const Scope* scope) const;
+
+    //! Check whether an array subscript can be evaluated by an inspector,
+    //! from the statement's iterators, parameters, and arrays which are not
+    //! written in the loop
+    static bool isInspectable(Expr* expr,
+                              const std::vector<std::string>& iterators,
+                              const std::unordered_set<std::string>& written,
+                              BuilderSession& session);
+
+    //! Get the expressions a loop or guard evaluates to decide which
+    //! statement instances run: a loop's initial value and condition, or a
+    //! guard's condition
+    static std::vector<Expr*> getScopeExprs(const Scope* scope);
+
+    //! Get the OpenMP clause for a reduction, like
+    //! "reduction(+:product[i:1])"
+    static std::string toReductionClause(const Reduction& reduction);
+
+    //! Get the iterators of loops nested in a loop which are declared
+    //! outside it, and so must be made private to its parallel iterations
+    std::vector<std::string> getSharedInnerIterators(const Scope* loop) const;
+
+    //! Get the scopes enclosing a statement, outermost first
+    static std::vector<const Scope*> getScopeChain(const Scope* scope);
+
+    //! Get the type of a loop's iterator, like "int"
+    static std::string getIteratorType(ForStmt* forStmt);
+
+    //! Get the indentation for a nesting depth
+    static std::string indent(unsigned int depth);
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SPFIE_COMPUTATIONCACHE_HPP
+#define SPFIE_COMPUTATIONCACHE_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "iegenlib.h"
+#include "llvm/ADT/StringRef.h"
+
+//! Version of the builder's output, part of every cache key. Bump whenever
+//! a change affects the Computations built from unchanged source.
+#define SPFIE_BUILDER_VERSION "spf-ie-4"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/*!
+ * \class ComputationCache
+ *
+ * \brief On-disk, content-addressed cache of built Computations
+ *
+ * Entries are keyed by a hash of a function's source text, the builder
+ * version, and the flags the file was compiled with, and hold the
+ * Computation serialized by ComputationSerializer. The key covers only the
+ * text of the function itself, so changes to macros or types it uses from
+ * elsewhere are not noticed unless they also change the flags.
+ *
+ * Safe to use from several threads (and processes) at once.
+ */
+class ComputationCache {
+   public:
+    //! \param[in] directory Directory holding cache entries, created if
+    //! needed
+    explicit ComputationCache(std::string directory);
+
+    //! Compute the cache key for a function
+    //! \param[in] funcDecl Function to compute the key of
+    //! \param[in] Ctx ASTContext the function belongs to
+    //! \param[in] flags Compilation flags of the file containing the function
+    static std::string computeKey(FunctionDecl* funcDecl, const ASTContext& Ctx,
+                                  llvm::StringRef flags);
+
+    //! Look up the Computation stored for a key, counting a hit or a miss
+    //! \return the stored Computation, or nullptr on a miss
+    std::unique_ptr<iegenlib::Computation> lookup(const std::string& key);
+
+    //! Store a Computation for a key, replacing any existing entry
+    void store(const std::string& key, iegenlib::Computation* computation);
+
+    //! Get the number of lookups which found an entry
+    unsigned int getHits() const { return hits; }
+
+    //! Get the number of lookups which found no (usable) entry
+    unsigned int getMisses() const { return misses; }
+
+   private:
+    //! Directory holding cache entries
+    std::string directory;
+    //! Number of lookups which found an entry
+    std::atomic<unsigned int> hits;
+    //! Number of lookups which found no (usable) entry
+    std::atomic<unsigned int> misses;
+
+    //! Get the path of the cache entry for a key
+    std::string getEntryPath(const std::string& key) const;
+};
+
+}  // namespace spf_ie
+
+#endif
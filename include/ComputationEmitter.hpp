@@ -0,0 +1,112 @@
+/*!
+ * \file ComputationEmitter.hpp
+ *
+ * \brief Streaming machine-readable output of built Computations
+ */
+
+#ifndef SPFIE_COMPUTATIONEMITTER_HPP
+#define SPFIE_COMPUTATIONEMITTER_HPP
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "iegenlib.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+//! Marker at the start of a binary output file
+#define EMIT_FILE_MAGIC "SPFE"
+//! Version of the binary output file framing; bump on any change to it
+#define SPFIE_EMIT_FORMAT_VERSION 1
+
+namespace spf_ie {
+
+/*!
+ * \class ComputationEmitter
+ *
+ * \brief Writes each Computation to an output file as soon as it is built
+ *
+ * In JSON Lines format, every function is one line: an object with "file",
+ * "function", "dataSpaces" and "stmts", where each statement has "source",
+ * "iterationSpace", "executionSchedule", and "reads"/"writes" lists of
+ * {"dataSpace", "relation"} objects. Sets and relations are in IEGenLib
+ * syntax.
+ *
+ * In binary format, the file starts with EMIT_FILE_MAGIC and a 32-bit
+ * SPFIE_EMIT_FORMAT_VERSION, followed by one entry per function: the source
+ * file name, the function name, and a ComputationSerializer record, each as
+ * a length-prefixed string. Readers can skip entries without decoding them.
+ *
+ * Entries are rendered as soon as their functions are built, which may be
+ * on several threads at once, and written by the caller in a fixed order
+ * (see write) so that the output is the same from run to run.
+ */
+class ComputationEmitter {
+   public:
+    //! Output formats
+    enum class Format { JSONLines, Binary };
+
+    //! Open an output file and write its header
+    //! \param[in] format Format to write
+    //! \param[in] path File to (over)write
+    //! \param[out] error Reason for failure, if any
+    //! \return the emitter, or nullptr if the file could not be opened
+    static std::unique_ptr<ComputationEmitter> create(Format format,
+                                                      llvm::StringRef path,
+                                                      std::string& error);
+
+    ComputationEmitter(const ComputationEmitter&) = delete;
+    ComputationEmitter& operator=(const ComputationEmitter&) = delete;
+
+    //! Render the entry for the Computation built from a function. Takes
+    //! Utils::iegenlibMutex itself, so callers must not hold it.
+    //! \param[in] fileName Source file the function is in
+    //! \param[in] functionName Qualified name of the function
+    //! \param[in] computation Computation to render
+    //! \return the entry, to be passed to write
+    std::string render(llvm::StringRef fileName, llvm::StringRef functionName,
+                       iegenlib::Computation* computation);
+
+    //! Append an entry to the output file. The driver writes the entries of
+    //! each source file in declaration order, and files in input order.
+    //! \param[in] entry Entry from render
+    void write(llvm::StringRef entry);
+
+    //! Whether all output so far has been written successfully
+    bool ok();
+
+    //! Write a Computation as a JSON object, in the form used for each line
+    //! of JSON Lines output. Callers must hold Utils::iegenlibMutex.
+    static void writeJSON(llvm::json::OStream& J, llvm::StringRef fileName,
+                          llvm::StringRef functionName,
+                          iegenlib::Computation* computation);
+
+   private:
+    ComputationEmitter(Format format,
+                       std::unique_ptr<llvm::raw_fd_ostream> os)
+        : format(format), os(std::move(os)) {}
+
+    //! Build the JSON Lines representation of a Computation
+    static void writeJSONLine(llvm::raw_ostream& os, llvm::StringRef fileName,
+                              llvm::StringRef functionName,
+                              iegenlib::Computation* computation);
+
+    //! Build the binary entry for a Computation
+    static void writeBinaryEntry(llvm::raw_ostream& os,
+                                 llvm::StringRef fileName,
+                                 llvm::StringRef functionName,
+                                 iegenlib::Computation* computation);
+
+    //! Format being written
+    const Format format;
+    //! Output file
+    std::unique_ptr<llvm::raw_fd_ostream> os;
+    //! Lock to hold while writing to the output file
+    std::mutex outputMutex;
+};
+
+}  // namespace spf_ie
+
+#endif
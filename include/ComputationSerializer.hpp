@@ -0,0 +1,63 @@
+#ifndef SPFIE_COMPUTATIONSERIALIZER_HPP
+#define SPFIE_COMPUTATIONSERIALIZER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "iegenlib.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+//! Version of the serialized Computation format; bump on any change to it
+#define SPFIE_SERIALIZED_FORMAT_VERSION 1
+
+namespace spf_ie {
+
+/*!
+ * \class ComputationSerializer
+ *
+ * \brief Converts Computations to and from a compact binary record
+ *
+ * A record holds the data spaces and, for each statement, its source code,
+ * iteration space, execution schedule, and data reads and writes. Records
+ * are self-delimiting, so several may be written to one stream.
+ *
+ * IEGenLib is not thread-safe, so callers must hold Utils::iegenlibMutex.
+ */
+class ComputationSerializer {
+   public:
+    //! Write a Computation as a binary record
+    //! \param[in] computation Computation to write
+    //! \param[out] os Stream to write to
+    static void write(iegenlib::Computation* computation,
+                      llvm::raw_ostream& os);
+
+    //! Read a binary record from the front of a buffer and rebuild the
+    //! Computation it describes
+    //! \param[in,out] data Buffer to read from; advanced past the record
+    //! \return the Computation, or nullptr if the record is malformed
+    static std::unique_ptr<iegenlib::Computation> read(llvm::StringRef& data);
+
+    //! Write a length-prefixed string (also used to frame records in larger
+    //! files)
+    static void writeString(llvm::raw_ostream& os, llvm::StringRef str);
+
+    //! Write a little-endian 32-bit integer
+    static void writeInt(llvm::raw_ostream& os, uint32_t value);
+
+   private:
+    //! Read a length-prefixed string
+    //! \return false if data is too short
+    static bool readString(llvm::StringRef& data, std::string& str);
+
+    //! Read a little-endian 32-bit integer
+    //! \return false if data is too short
+    static bool readInt(llvm::StringRef& data, uint32_t& value);
+
+    ComputationSerializer() = delete;
+};
+
+}  // namespace spf_ie
+
+#endif
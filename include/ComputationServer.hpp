@@ -0,0 +1,109 @@
+/*!
+ * \file ComputationServer.hpp
+ *
+ * \brief Long-running server which builds Computations on request, keeping
+ * parsed translation units warm between requests
+ */
+
+#ifndef SPFIE_COMPUTATIONSERVER_HPP
+#define SPFIE_COMPUTATIONSERVER_HPP
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+//! Most translation units to keep parsed at once
+#define MAX_CACHED_UNITS 32
+
+using namespace clang;
+
+namespace spf_ie {
+
+/*!
+ * \class ComputationServer
+ *
+ * \brief Answers requests to build the Computations of a source file
+ *
+ * Requests and responses are one JSON object per line. A request names a
+ * "file" and may give its contents as "code" (for unsaved or synthetic
+ * sources), a "function" regular expression selecting functions by
+ * qualified name, and an "id" which is echoed back. The response holds
+ * the "id", the "file", the "computations" built (one object each, as in
+ * --emit=jsonl output), and "errors" for anything which could not be built.
+ *
+ * Each file's translation unit is kept after its first request. Its
+ * preamble (the headers included at the top) is precompiled, so later
+ * requests reparse only the main file. Only functions defined in the main
+ * file are built. Errors never stop the server.
+ */
+class ComputationServer {
+   public:
+    //! \param[in] compilations Compilation database to get commands from
+    //! \param[in] resourceDir Clang resource directory (builtin headers)
+    ComputationServer(const tooling::CompilationDatabase& compilations,
+                      std::string resourceDir);
+
+    ComputationServer(const ComputationServer&) = delete;
+    ComputationServer& operator=(const ComputationServer&) = delete;
+
+    //! Answer requests read from a stream until it ends
+    void serve(std::FILE* in, llvm::raw_ostream& out);
+
+    //! Accept connections on a Unix domain socket, answering the requests
+    //! on each until it is closed. Connections are served one at a time.
+    //! \return nonzero if the socket could not be set up
+    int serveUnixSocket(const std::string& path);
+
+    //! Answer a single request
+    //! \param[in] request Request line
+    //! \return response line, without the trailing newline
+    std::string handleRequest(llvm::StringRef request);
+
+   private:
+    /*!
+     * \struct CachedUnit
+     *
+     * \brief A parsed translation unit kept between requests
+     */
+    struct CachedUnit {
+        //! Arguments the unit was parsed with
+        std::vector<std::string> args;
+        std::unique_ptr<ASTUnit> unit;
+        //! Request number of the last use, for eviction
+        unsigned long lastUsed;
+    };
+
+    //! Get a freshly (re)parsed translation unit for a file
+    //! \param[in] file Path of the source file
+    //! \param[in] code Contents to use instead of the file's, if non-null
+    //! \param[out] error Reason for failure, if any
+    //! \return the unit, or nullptr if it could not be parsed at all
+    ASTUnit* getUnit(const std::string& file, const std::string* code,
+                     std::string& error);
+
+    //! Get the arguments to parse a file with
+    std::vector<std::string> getCompileArgs(const std::string& file);
+
+    //! Drop the least recently used unit if there are too many
+    void evictUnits();
+
+    const tooling::CompilationDatabase& compilations;
+    std::string resourceDir;
+    std::shared_ptr<PCHContainerOperations> pchContainerOps;
+    //! Parsed translation units, by file
+    std::map<std::string, CachedUnit> units;
+    //! Number of requests handled
+    unsigned long requestNumber;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -1,12 +1,14 @@
 #ifndef SPFIE_DATAACCESSHANDLER_HPP
 #define SPFIE_DATAACCESSHANDLER_HPP
 
+#include <cstdint>
 #include <stack>
 #include <string>
-#include <unordered_set>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "BuilderSession.hpp"
 #include "clang/AST/Expr.h"
 
 //! Maximum allowed array dimension (a safe estimate to avoid stack overflow)
@@ -38,18 +40,35 @@ struct ArrayAccess {
     bool isRead;
 };
 
+/*!
+ * \struct DataSpace
+ *
+ * \brief Type information kept for an array accessed
+ */
+struct DataSpace {
+    //! Type of the array's elements, like "double"
+    std::string elementType;
+    //! Size in bytes of an element, or 0 if it is not known, like for an
+    //! incomplete type
+    uint64_t elementSize = 0;
+};
+
 /*!
  * \struct DataAccessHandler
  *
  * \brief Handles data accesses (both reads and writes) for a statement
+ *
+ * Unlike iteration spaces, the relations for data accesses are still built
+ * as strings (see StmtContext::getDataAccessString) and parsed by IEGenLib,
+ * since subscripts need not be affine.
  */
 struct DataAccessHandler {
    public:
     //! Add all the arrays accessed in the expression as reads
-    void processAsReads(Expr* expr);
+    void processAsReads(Expr* expr, BuilderSession& session);
 
     //! Add the array accessed as a write, and any accessed within it as reads
-    void processAsWrite(ArraySubscriptExpr* expr);
+    void processAsWrite(ArraySubscriptExpr* expr, BuilderSession& session);
 
     //! Make ArrayAccess and sub-accesses (recursively) from the given
     //! expression
@@ -57,28 +76,50 @@ struct DataAccessHandler {
     //! \param[in] isRead Whether this access is a read
     //! \param[in,out] accessComponents Current list of sub-accesses; after
     //! processing completes, the last element will be the outermost access.
+    //! \param[in] session Session of the builder doing the processing
     static void buildDataAccess(
         ArraySubscriptExpr* expr, bool isRead,
-        std::vector<std::pair<std::string, ArrayAccess>>& accessComponents);
+        std::vector<std::pair<std::string, ArrayAccess>>& accessComponents,
+        BuilderSession& session);
 
     //! Get a string representation of the array access, like A(i,j).
     //! This method isn't on ArrayAccess itself in case we run into something
-    //! like A[B[i]]; in this case, the B[j] component will already have a
-    //! string representation saved, and we use that instead of building a new
-    //! one.
-    static std::string makeStringForArrayAccess(
-        ArrayAccess* access,
-        const std::vector<std::pair<std::string, ArrayAccess>>& components);
-
-    //! Data spaces accessed
-    std::unordered_set<std::string> dataSpaces;
+    //! like A[B[i]]; in this case, the B[i] component will already have a
+    //! string representation saved in the session, and we use that instead of
+    //! building a new one.
+    static std::string makeStringForArrayAccess(ArrayAccess* access,
+                                                BuilderSession& session);
+
+    //! Get the array element a statement writes as a whole, by assigning
+    //! to it or incrementing or decrementing it; this is the only write
+    //! recorded for the statement
+    //! \return the access, or nullptr if there is none
+    static ArraySubscriptExpr* getWrittenArrayAccess(Stmt* stmt);
+
+    //! Get the declared extent of each dimension of an array, outermost
+    //! first, as source code; a dimension whose extent is not written, like
+    //! the first of int A[][n], gets an empty string
+    //! \param[in] base Base of an access to the array
+    //! \param[out] extents Extent of each dimension
+    //! \return false if the base is not a variable declared as an array
+    static bool getArrayExtents(Expr* base, BuilderSession& session,
+                                std::vector<std::string>& extents);
+
+    //! Data spaces accessed, by name
+    std::unordered_map<std::string, DataSpace> dataSpaces;
     //! Array accesses
     std::vector<std::pair<std::string, ArrayAccess>> arrayAccesses;
 
    private:
     //! Make an ArrayAccess from an ArraySubscriptExpr and add it to the
     //! appropriate map appropriate map
-    void addDataAccess(ArraySubscriptExpr* expr, bool isRead);
+    void addDataAccess(ArraySubscriptExpr* expr, bool isRead,
+                       BuilderSession& session);
+
+    //! Make the DataSpace of the array an access is to, from the type its
+    //! subscripts reach
+    static DataSpace makeDataSpace(const ArrayAccess& access,
+                                   BuilderSession& session);
 
     //! Do the recursive work of getting array access info
     //! \param[in] fullExpr array access to process
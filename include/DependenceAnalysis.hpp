@@ -0,0 +1,312 @@
+/*!
+ * \file DependenceAnalysis.hpp
+ *
+ * \brief Data dependence analysis between the statements built from a
+ * function
+ */
+
+#ifndef SPFIE_DEPENDENCEANALYSIS_HPP
+#define SPFIE_DEPENDENCEANALYSIS_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "BuilderSession.hpp"
+#include "StmtContext.hpp"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Stmt.h"
+
+//! Suffix appended to the sink statement's iterators in dependence
+//! relations, to tell them apart from the source's
+#define DEPENDENCE_SINK_SUFFIX "p"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/*!
+ * \struct Dependence
+ *
+ * \brief A (possible) dependence from instances of one statement to later
+ * instances of another, through one data space
+ */
+struct Dependence {
+    //! Whether the source and sink write or read the data space
+    enum class Kind {
+        Flow,   //!< write, then read
+        Anti,   //!< read, then write
+        Output  //!< write, then write
+    };
+
+    Kind kind;
+    //! Position of the source statement in the Computation
+    unsigned int source;
+    //! Position of the sink statement in the Computation
+    unsigned int sink;
+    //! Array or scalar variable the dependence is through
+    std::string dataSpace;
+    //! Loop level carrying the dependence, counting the outermost loop as 1,
+    //! or 0 if it is loop-independent
+    unsigned int level;
+    //! Loop carrying the dependence, null if it is loop-independent
+    ForStmt* loop;
+    //! Direction of the dependence in each loop enclosing both statements,
+    //! outermost first: one of <, =, > or * (unknown)
+    std::string direction;
+    //! Relation from source to sink iterations, in IEGenLib syntax. Sink
+    //! iterators carry DEPENDENCE_SINK_SUFFIX.
+    std::string relation;
+    //! Whether this is a reduction statement's dependence on itself through
+    //! its accumulator, carried by the reduction loop
+    bool isReduction = false;
+
+    //! Get a string representation, like
+    //! "S0 -> S1: flow on A, carried at level 1 (<,=): {...}"
+    std::string toString() const;
+
+    //! Get the name of a kind of dependence, like "flow"
+    static std::string kindToString(Kind kind);
+};
+
+/*!
+ * \struct Reduction
+ *
+ * \brief A statement which accumulates into the same location on every
+ * iteration of a loop, with an associative operator, like
+ * product[i] += x[i][j] * y[j] in a loop over j. The loop's iterations may
+ * then run in parallel, each accumulating a partial result.
+ */
+struct Reduction {
+    //! Position of the statement in the Computation
+    unsigned int stmt;
+    //! Loop reduced over
+    ForStmt* loop;
+    //! Level of the loop reduced over, counting the outermost loop as 1
+    unsigned int level;
+    //! Compound assignment operator, like +=
+    BinaryOperatorKind oper;
+    //! Array or scalar variable accumulated into
+    std::string dataSpace;
+    //! Subscripts of the location accumulated into, outermost dimension
+    //! first (none for scalars)
+    std::vector<AffineExpr> subscripts;
+
+    //! Get a string representation, like
+    //! "S1: + reduction into product(i) over level 2"
+    std::string toString() const;
+};
+
+/*!
+ * \class DependenceGraph
+ *
+ * \brief Dependences between the statements of a Computation, with
+ * statements as nodes (by position) and dependences as edges
+ */
+class DependenceGraph {
+   public:
+    explicit DependenceGraph(unsigned int numStmts) : numStmts(numStmts) {}
+
+    //! Add a dependence, merging it into an existing one between the same
+    //! statements, of the same kind, through the same data space, carried at
+    //! the same level
+    void addDependence(const Dependence& dependence);
+
+    //! Get the number of statements (nodes)
+    unsigned int getNumStmts() const { return numStmts; }
+
+    //! Get every dependence, ordered by source, then sink
+    const std::vector<Dependence>& getDependences() const {
+        return dependences;
+    }
+
+    //! Add a reduction
+    void addReduction(const Reduction& reduction) {
+        reductions.push_back(reduction);
+    }
+
+    //! Get every reduction, ordered by statement
+    const std::vector<Reduction>& getReductions() const { return reductions; }
+
+    //! Get the reductions over a loop
+    std::vector<const Reduction*> getReductions(const ForStmt* loop) const;
+
+    //! Check whether any dependence is carried by a loop, meaning its
+    //! iterations cannot run in parallel
+    bool isCarried(const ForStmt* loop) const;
+
+    //! Check whether the iterations of a loop can run in parallel, once its
+    //! reductions (if any) are accounted for
+    bool isParallelizable(const ForStmt* loop) const;
+
+    //! Get a string representation, one dependence, then one reduction per
+    //! line
+    std::string toString() const;
+
+   private:
+    //! Number of statements
+    unsigned int numStmts;
+    //! Dependences, ordered by source, then sink
+    std::vector<Dependence> dependences;
+    //! Reductions, ordered by statement
+    std::vector<Reduction> reductions;
+};
+
+/*!
+ * \class DependenceAnalysis
+ *
+ * \brief Finds the dependences between the statements built from a function
+ *
+ * Every pair of accesses to the same data space, at least one of which is a
+ * write, is tested for each loop level it could be carried at. Subscripts
+ * are compared with the ZIV, GCD and strong SIV tests. Subscripts which
+ * differ in symbolic constants, mention scalars written inside the loops
+ * (like A[k] after int k = n - i), or go through uninterpreted functions
+ * (like x[col[k]]) cannot be decided, so they are assumed to depend in every
+ * direction; their relations still hold the exact constraints, for tools
+ * which can reason about the functions involved.
+ *
+ * Scalar variables are included as data spaces without subscripts, since
+ * they do not appear in the Computation. A scalar declared inside a loop is
+ * private to each of its iterations.
+ *
+ * Accesses which cannot be located, like writes through pointers or to
+ * struct members, reads through pointers, and calls to functions which are
+ * not known to be free of side effects, are taken to touch every data
+ * space. A statement writing such a location depends on itself in every
+ * loop around it, so none of them can run in parallel.
+ *
+ * Compound assignments with an associative operator are recognized as
+ * reductions over each enclosing loop whose iterator, and those of the loops
+ * nested in it, do not appear in the location assigned, provided nothing else
+ * in the loop touches that data space. The dependences they carry over such
+ * loops are marked as reduction dependences.
+ */
+class DependenceAnalysis {
+   public:
+    /*!
+     * \struct Access
+     *
+     * \brief A read or write of a data space by a statement
+     */
+    struct Access {
+        //! Name of the data space
+        std::string dataSpace;
+        //! Declaration of a scalar variable, null for arrays
+        const VarDecl* scalar = nullptr;
+        bool isRead;
+        //! Subscripts, outermost dimension first
+        std::vector<AffineExpr> subscripts;
+        //! Whether each subscript is affine (otherwise it is not compared)
+        std::vector<bool> isAffine;
+        //! Number of loops the data space is private to, counting from the
+        //! outermost
+        unsigned int privateDepth = 0;
+        //! Whether the location accessed is not known, so that it may be
+        //! anywhere; the data space is then the source code of the access
+        bool isUnknown = false;
+    };
+
+    //! \param[in] stmtContexts Statements of the function, in order
+    //! \param[in] session Session of the builder the statements came from
+    DependenceAnalysis(const std::vector<StmtContext>& stmtContexts,
+                       BuilderSession& session);
+
+    //! Run the analysis
+    DependenceGraph analyze();
+
+    //! Get the accesses made by a statement, including to scalars, as found
+    //! by the last analysis
+    const std::vector<Access>& getAccesses(unsigned int stmtIndex) const {
+        return accesses[stmtIndex];
+    }
+
+    //! Check whether fusing the loop at a level enclosing one statement with
+    //! the loop at that level enclosing a later statement would reverse a
+    //! dependence between them, by running an instance of the later
+    //! statement before one of the first in a later iteration. The loops
+    //! outside that level are taken to enclose both statements, as if they
+    //! had already been fused. Needs the accesses found by analyze().
+    //! \param[in] level Level of the loops, counting the outermost as 1
+    bool preventsFusion(unsigned int first, unsigned int second,
+                        unsigned int level) const;
+
+   private:
+    //! Directions a distance may take, as a set of bits
+    enum Direction : unsigned int {
+        DIR_LT = 1,
+        DIR_EQ = 2,
+        DIR_GT = 4,
+        DIR_ALL = DIR_LT | DIR_EQ | DIR_GT
+    };
+
+    const std::vector<StmtContext>& stmtContexts;
+    BuilderSession& session;
+    //! Accesses made by each statement
+    std::vector<std::vector<Access>> accesses;
+    //! Iterator names of each statement, and their sink (suffixed) versions
+    std::vector<std::vector<std::string>> iterators;
+    std::vector<std::vector<std::string>> sinkIterators;
+    //! Loops enclosing each statement, outermost first
+    std::vector<std::vector<ForStmt*>> loops;
+    //! Number of loops enclosing the declaration of each local scalar
+    std::map<const VarDecl*, unsigned int> declDepths;
+
+    //! Gather the accesses made by a statement
+    void collectAccesses(unsigned int stmtIndex);
+
+    //! Find the loops a statement is a reduction over
+    void findReductions(unsigned int stmtIndex, DependenceGraph& graph) const;
+
+    //! Gather the scalar variables read or written by an expression, and
+    //! any accesses to locations which are not known
+    //! \param[in] isWrite Whether the expression itself is being written
+    void collectScalarAccesses(Expr* expr, bool isWrite,
+                               unsigned int stmtIndex);
+
+    //! Add an access to a location which is not known
+    void addUnknownAccess(Expr* expr, bool isRead, unsigned int stmtIndex);
+
+    //! Check whether a call may have side effects, unless its callee is
+    //! known to only compute its result
+    bool hasSideEffects(const CallExpr* call) const;
+
+    //! Check whether two accesses may touch the same location, at least
+    //! one of them writing it
+    static bool mayConflict(const Access& first, const Access& second);
+
+    //! Test two accesses for dependence
+    //! \param[in] numCommonLoops Number of loops enclosing both statements
+    //! \param[in] varying Scalars which may change between the instances
+    //! compared, and so do not cancel out of subscripts
+    //! \param[out] directions Possible directions at each common loop
+    //! \return false if the accesses are proven independent
+    bool testSubscripts(const Access& source, const Access& sink,
+                        unsigned int numCommonLoops,
+                        const std::set<std::string>& varying,
+                        std::vector<unsigned int>& directions) const;
+
+    //! Get the scalars which may be written between an instance of one
+    //! statement and an instance of another: those written inside the
+    //! outermost loop enclosing both, or anywhere if no loop encloses both
+    std::set<std::string> getVaryingScalars(unsigned int first,
+                                            unsigned int second) const;
+
+    //! Build the relation from source to sink iterations of a dependence
+    //! \param[in] level Level carrying the dependence, 0 if loop-independent
+    std::string buildRelation(unsigned int source, unsigned int sink,
+                              const Access& sourceAccess,
+                              const Access& sinkAccess,
+                              unsigned int numCommonLoops,
+                              unsigned int level) const;
+
+    //! Get the number of loops enclosing both of two statements
+    unsigned int getNumCommonLoops(unsigned int first,
+                                   unsigned int second) const;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -1,13 +1,39 @@
 #ifndef SPFIE_EXECSCHEDULE_HPP
 #define SPFIE_EXECSCHEDULE_HPP
 
-#include <memory>
 #include <string>
 #include <vector>
 
+#include "iegenlib.h"
+#include "llvm/ADT/SmallVector.h"
+
 namespace spf_ie {
 
-struct ScheduleVal;
+/*!
+ * \struct ScheduleVal
+ *
+ * \brief An entry of an execution schedule, which may be a variable or
+ * simply a number.
+ *
+ * Variables are stored as the index of their iterator in the statement's
+ * iterator tuple, so an entry is a plain value with no heap storage.
+ */
+struct ScheduleVal {
+    //! Make an entry holding a number
+    explicit ScheduleVal(int num) : value(num), valueIsVar(false) {}
+
+    //! Make an entry holding the iterator at the given index
+    static ScheduleVal makeVar(unsigned int iteratorIndex) {
+        ScheduleVal val(static_cast<int>(iteratorIndex));
+        val.valueIsVar = true;
+        return val;
+    }
+
+    //! The number, or the iterator index if this is a variable
+    int value;
+    //! Whether this ScheduleVal contains a variable
+    bool valueIsVar;
+};
 
 /*!
  * \struct ExecSchedule
@@ -15,14 +41,14 @@ struct ScheduleVal;
  * \brief An execution schedule tuple, plus a few utilities for it
  */
 struct ExecSchedule {
-    ExecSchedule() {}
-
-    //! Copy constructor
-    ExecSchedule(const ExecSchedule &other);
+    ExecSchedule() : numIterators(0) {}
 
     //! Add a value to the end of the schedule tuple
     void pushValue(ScheduleVal value);
 
+    //! Add the next innermost iterator to the end of the schedule tuple
+    void pushIterator();
+
     //! Remove the value at the end of the schedule tuple
     //! \return the removed value
     ScheduleVal popValue();
@@ -31,29 +57,27 @@ struct ExecSchedule {
     void advanceSchedule();
 
     //! Get the dimension of the execution schedule
-    int getDimension() { return scheduleTuple.size(); }
+    int getDimension() const { return scheduleTuple.size(); }
 
     //! Zero-pad this execution schedule up to a certain dimension
     void zeroPadDimension(int dim);
 
-    //! Actual execution schedule ordering tuple
-    std::vector<std::shared_ptr<ScheduleVal>> scheduleTuple;
-};
+    //! Get the schedule as a string, like "{[i,j]->[0,i,1,j,0]}"
+    //! \param[in] iterators Names of the iterators, outermost first
+    std::string toString(const std::vector<std::string>& iterators) const;
 
-/*!
- * \struct ScheduleVal
- *
- * \brief An entry of an execution schedule, which may be a variable or
- * simply a number.
- */
-struct ScheduleVal {
-    ScheduleVal(std::string var);
-    ScheduleVal(int num);
+    //! Build the schedule as an IEGenLib relation directly, without going
+    //! through IEGenLib's parser (caller adopts the result)
+    //! \param[in] iterators Names of the iterators, outermost first
+    iegenlib::Relation* toRelation(
+        const std::vector<std::string>& iterators) const;
 
-    std::string var;
-    int num;
-    //! Whether this ScheduleVal contains a variable
-    bool valueIsVar;
+    //! Actual execution schedule ordering tuple
+    llvm::SmallVector<ScheduleVal, 8> scheduleTuple;
+
+   private:
+    //! Number of iterators currently in the schedule tuple
+    unsigned int numIterators;
 };
 
 }  // namespace spf_ie
@@ -0,0 +1,182 @@
+/*!
+ * \file Instrumentation.hpp
+ *
+ * \brief Per-phase timers, counters and trace recording for diagnosing where
+ * processing time goes
+ */
+
+#ifndef SPFIE_INSTRUMENTATION_HPP
+#define SPFIE_INSTRUMENTATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace spf_ie {
+
+/*!
+ * \class Instrumentation
+ *
+ * \brief Process-wide timing and counting of processing phases
+ *
+ * Phases are timed with PhaseTimer. Totals are accumulated atomically, so
+ * timers may run on any thread. When tracing is enabled, coarse phases also
+ * record one span per occurrence, which can be written as a Chrome
+ * trace-event file. Everything is a no-op until enabled.
+ */
+class Instrumentation {
+   public:
+    //! Phases of processing which are timed. Phases nest, so times in the
+    //! report are inclusive.
+    enum class Phase {
+        TranslationUnit,
+        Parse,
+        Function,
+        ProcessBody,
+        BuildStmts,
+        AccessStrings,
+        CheckComplete,
+        Dependences,
+        Locality,
+        Intensity,
+        Schedule,
+        CodeGen,
+        Emit,
+        NumPhases
+    };
+
+    //! Quantities which are counted
+    enum class Counter {
+        Statements,
+        Accesses,
+        Constraints,
+        ReplacementVars,
+        NumCounters
+    };
+
+    //! Start collecting timings and counters
+    //! \param[in] trace Whether to also record spans for a trace file
+    static void enable(bool trace);
+
+    //! Whether timings and counters are being collected
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    //! Add to a counter
+    static void count(Counter counter, uint64_t amount = 1) {
+        if (isEnabled()) {
+            counters[static_cast<int>(counter)].fetch_add(
+                amount, std::memory_order_relaxed);
+        }
+    }
+
+    //! Record a completed occurrence of a phase
+    //! \param[in] phase Phase which occurred
+    //! \param[in] detail What the phase operated on, such as a file or
+    //! function name, for the trace
+    //! \param[in] start When the phase started
+    //! \param[in] end When the phase ended
+    static void recordPhase(Phase phase, llvm::StringRef detail,
+                            std::chrono::steady_clock::time_point start,
+                            std::chrono::steady_clock::time_point end);
+
+    //! Print the totals for each phase and counter
+    static void printReport(llvm::raw_ostream& os);
+
+    //! Write recorded spans as a Chrome trace-event JSON file
+    //! \param[in] path File to (over)write
+    //! \param[out] error Reason for failure, if any
+    //! \return false on failure
+    static bool writeTrace(llvm::StringRef path, std::string& error);
+
+   private:
+    /*!
+     * \struct TraceEvent
+     *
+     * \brief One recorded span
+     */
+    struct TraceEvent {
+        Phase phase;
+        std::string detail;
+        uint64_t threadID;
+        //! Start, in microseconds since instrumentation was enabled
+        int64_t start;
+        //! Duration, in microseconds
+        int64_t duration;
+    };
+
+    //! Name of a phase, for reports and traces
+    static const char* getPhaseName(Phase phase);
+
+    //! Whether a phase gets trace spans; very frequent phases are only
+    //! totalled, to keep traces small
+    static bool isTraced(Phase phase);
+
+    //! Name of a counter, for reports
+    static const char* getCounterName(Counter counter);
+
+    static std::atomic<bool> enabled;
+    static std::atomic<bool> tracing;
+    //! When instrumentation was enabled, used as the trace's time origin
+    static std::chrono::steady_clock::time_point origin;
+    //! Total time spent in each phase, in nanoseconds
+    static std::atomic<uint64_t>
+        phaseNanos[static_cast<int>(Phase::NumPhases)];
+    //! Number of occurrences of each phase
+    static std::atomic<uint64_t>
+        phaseCounts[static_cast<int>(Phase::NumPhases)];
+    static std::atomic<uint64_t>
+        counters[static_cast<int>(Counter::NumCounters)];
+    //! Lock to hold while accessing traceEvents
+    static std::mutex traceMutex;
+    static std::vector<TraceEvent> traceEvents;
+
+    Instrumentation() = delete;
+};
+
+/*!
+ * \class PhaseTimer
+ *
+ * \brief Times a phase from construction until destruction
+ */
+class PhaseTimer {
+   public:
+    //! \param[in] phase Phase being timed
+    //! \param[in] detail What the phase operates on, for the trace
+    explicit PhaseTimer(Instrumentation::Phase phase,
+                        llvm::StringRef detail = "")
+        : phase(phase), active(Instrumentation::isEnabled()) {
+        if (active) {
+            this->detail = detail.str();
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~PhaseTimer() {
+        if (active) {
+            Instrumentation::recordPhase(phase, detail, start,
+                                         std::chrono::steady_clock::now());
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+   private:
+    Instrumentation::Phase phase;
+    //! Whether instrumentation was enabled when the timer started
+    bool active;
+    std::string detail;
+    std::chrono::steady_clock::time_point start;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,127 @@
+/*!
+ * \file IntensityEstimator.hpp
+ *
+ * \brief Static estimate of the memory traffic and arithmetic of the
+ * statements built from a function, for a roofline-style view of whether
+ * they are bound by memory bandwidth or by computation
+ */
+
+#ifndef SPFIE_INTENSITYESTIMATOR_HPP
+#define SPFIE_INTENSITYESTIMATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BuilderSession.hpp"
+#include "StmtContext.hpp"
+#include "clang/AST/Stmt.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/*!
+ * \struct TrafficEstimate
+ *
+ * \brief Bytes moved and arithmetic operations performed by one instance of
+ * a statement, or by one iteration of the innermost loops of a loop nest
+ */
+struct TrafficEstimate {
+    //! What is estimated, like "S2" or "loop j"
+    std::string label;
+    //! Bytes read from arrays
+    uint64_t bytesRead = 0;
+    //! Bytes written to arrays
+    uint64_t bytesWritten = 0;
+    //! Arithmetic operations on values
+    unsigned int operations = 0;
+
+    //! Get the arithmetic intensity, in operations per byte moved, or 0 if
+    //! no bytes are moved
+    double getIntensity() const;
+};
+
+/*!
+ * \class IntensityReport
+ *
+ * \brief Traffic estimates for the statements and loop nests of a
+ * Computation
+ */
+class IntensityReport {
+   public:
+    //! Add the estimate for a statement instance
+    void addStmt(const TrafficEstimate& estimate) {
+        stmts.push_back(estimate);
+    }
+
+    //! Add the estimate for a loop nest
+    void addNest(const TrafficEstimate& estimate) {
+        nests.push_back(estimate);
+    }
+
+    //! Get the estimate for every statement which moves data or computes,
+    //! in order
+    const std::vector<TrafficEstimate>& getStmts() const { return stmts; }
+
+    //! Get the estimate for every loop nest, in source order
+    const std::vector<TrafficEstimate>& getNests() const { return nests; }
+
+    //! Get a table with a row per statement, then per loop nest
+    //! \param[in] machineBalance Operations per byte the target machine can
+    //! sustain; if nonzero, each row is marked memory-bound (below it) or
+    //! compute-bound
+    std::string toString(double machineBalance = 0) const;
+
+   private:
+    std::vector<TrafficEstimate> stmts;
+    std::vector<TrafficEstimate> nests;
+};
+
+/*!
+ * \class IntensityEstimator
+ *
+ * \brief Estimates the bytes read and written and the arithmetic operations
+ * of each statement instance and loop nest, from the element types of the
+ * arrays accessed
+ *
+ * A statement instance moves an element of each distinct array access it
+ * makes, and performs one operation per arithmetic operator (+, -, *, /, %,
+ * or their compound assignments) outside of subscripts. Scalars are assumed
+ * to stay in registers. A loop nest is estimated over one iteration of its
+ * innermost loops, counting the statements at its greatest depth. Accesses
+ * to the same element on every iteration of their innermost loop (see
+ * LocalityAnalysis) are assumed to stay in registers there, and move no
+ * bytes.
+ */
+class IntensityEstimator {
+   public:
+    //! \param[in] stmtContexts Statements of the function, in order
+    //! \param[in] session Session of the builder the statements came from
+    IntensityEstimator(const std::vector<StmtContext>& stmtContexts,
+                       BuilderSession& session);
+
+    //! Estimate every statement and loop nest
+    IntensityReport estimate();
+
+   private:
+    const std::vector<StmtContext>& stmtContexts;
+    BuilderSession& session;
+
+    //! Estimate one instance of a statement
+    //! \param[in] isInvariant Whether each array access of the statement
+    //! touches the same element on every iteration of its innermost loop
+    //! \param[in] isSteadyState Whether to leave out accesses to the same
+    //! element on every iteration of the innermost loop
+    TrafficEstimate estimateStmt(unsigned int stmtIndex,
+                                 const std::vector<bool>& isInvariant,
+                                 bool isSteadyState) const;
+
+    //! Count the arithmetic operations performed by a statement, leaving out
+    //! the address arithmetic of subscripts
+    static unsigned int countOperations(const Stmt* stmt);
+};
+
+}  // namespace spf_ie
+
+#endif
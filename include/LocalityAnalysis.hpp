@@ -0,0 +1,146 @@
+/*!
+ * \file LocalityAnalysis.hpp
+ *
+ * \brief Classification of the array accesses built from a function by how
+ * their addresses change from one iteration of the innermost loop to the next
+ */
+
+#ifndef SPFIE_LOCALITYANALYSIS_HPP
+#define SPFIE_LOCALITYANALYSIS_HPP
+
+#include <string>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "BuilderSession.hpp"
+#include "StmtContext.hpp"
+#include "clang/AST/Stmt.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/*!
+ * \struct AccessLocality
+ *
+ * \brief How the element an array access touches moves as the innermost
+ * loop enclosing it advances
+ */
+struct AccessLocality {
+    //! Pattern of the addresses touched
+    enum class Kind {
+        Invariant,  //!< the same element every iteration (stride-0)
+        Unit,       //!< neighbouring elements (unit-stride)
+        Strided,    //!< elements a fixed distance apart (constant-stride)
+        Gather      //!< elements found through an index array, or by a
+                    //!< non-affine subscript
+    };
+
+    Kind kind;
+    //! Position of the statement in the Computation
+    unsigned int stmt;
+    //! Position of the access among the array accesses of the statement
+    unsigned int accessIndex;
+    //! The access, like "l(i,j)"
+    std::string access;
+    //! Whether the access is a read or a write
+    bool isRead;
+    //! Distance in elements between the elements of consecutive iterations,
+    //! assuming row-major layout, like "1" or "n"; empty for gathers, or
+    //! when an extent it depends on is not declared
+    std::string stride;
+    //! Whether the access moves along a dimension other than the last, so
+    //! that it walks down a column rather than along a row
+    bool isColumnWalk = false;
+
+    //! Get a string representation, like
+    //! "S2 read l(i,j): constant-stride n, column walk"
+    std::string toString() const;
+
+    //! Get the name of a kind of access, like "unit-stride"
+    static std::string kindToString(Kind kind);
+};
+
+/*!
+ * \struct LoopLocality
+ *
+ * \brief The accesses of the statements directly in the body of a loop
+ */
+struct LoopLocality {
+    //! The loop
+    ForStmt* loop;
+    //! Iterator of the loop
+    std::string iterator;
+    //! Level of the loop, counting the outermost loop as 1
+    unsigned int level;
+    //! Accesses of the statements directly in the loop's body, in order
+    std::vector<AccessLocality> accesses;
+};
+
+/*!
+ * \class LocalityReport
+ *
+ * \brief Locality of the array accesses of a Computation, grouped by the
+ * innermost loop enclosing them
+ */
+class LocalityReport {
+   public:
+    //! Add an access, under the loop it is classified against
+    void addAccess(const AccessLocality& access, ForStmt* loop,
+                   const std::string& iterator, unsigned int level);
+
+    //! Get every loop directly holding statements, in source order
+    const std::vector<LoopLocality>& getLoops() const { return loops; }
+
+    //! Get a string representation, a line per loop followed by a line per
+    //! access
+    std::string toString() const;
+
+   private:
+    std::vector<LoopLocality> loops;
+};
+
+/*!
+ * \class LocalityAnalysis
+ *
+ * \brief Classifies every array access by its stride along the innermost loop
+ * enclosing it
+ *
+ * Each subscript is read as an affine expression of the iterators. The
+ * coefficient of the innermost loop's iterator in each dimension, weighted by
+ * the declared extents of the dimensions after it, gives the distance between
+ * the elements touched by consecutive iterations in a row-major array. A
+ * subscript which goes through an index array depending on that iterator,
+ * like x[col[k]], or which is not affine, makes the access a gather.
+ * Statements outside every loop have no innermost loop, so they are left out.
+ */
+class LocalityAnalysis {
+   public:
+    //! \param[in] stmtContexts Statements of the function, in order
+    //! \param[in] session Session of the builder the statements came from
+    LocalityAnalysis(const std::vector<StmtContext>& stmtContexts,
+                     BuilderSession& session);
+
+    //! Classify every array access of the statements
+    LocalityReport analyze();
+
+   private:
+    const std::vector<StmtContext>& stmtContexts;
+    BuilderSession& session;
+
+    //! Classify one access against the iterator at a position
+    //! \param[in] iterators Iterators enclosing the access, outermost first
+    AccessLocality classify(const ArrayAccess& access,
+                            const std::vector<std::string>& iterators,
+                            unsigned int iteratorIndex);
+
+    //! Build the stride of an access from the coefficient of the iterator in
+    //! each of its dimensions, or an empty string if an extent needed is not
+    //! known
+    static std::string makeStride(const std::vector<int>& coefficients,
+                                  const std::vector<std::string>& extents);
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,77 @@
+/*!
+ * \file LoopFusion.hpp
+ *
+ * \brief Fusion of adjacent loops with the same bounds, by rewriting the
+ * execution schedules of the statements built from a function
+ */
+
+#ifndef SPFIE_LOOPFUSION_HPP
+#define SPFIE_LOOPFUSION_HPP
+
+#include <vector>
+
+#include "BuilderSession.hpp"
+#include "DependenceAnalysis.hpp"
+#include "ExecSchedule.hpp"
+#include "StmtContext.hpp"
+#include "iegenlib.h"
+
+namespace spf_ie {
+
+/*!
+ * \class LoopFusion
+ *
+ * \brief Fuses adjacent loops of a Computation which iterate over the same
+ * range, so that the data they share is streamed through once
+ *
+ * Two loops are fused when they are consecutive in the same loop body (or
+ * the function body), have identical bounds, and no dependence between their
+ * statements goes from a later iteration of the first loop to an earlier one
+ * of the second. The statements of the second loop are moved into the first,
+ * after its own, by rewriting their execution schedules; the loop following
+ * the pair moves up into its place. Fusion is repeated until no more loops
+ * can be fused, so loops nested in fused loops may be fused in turn.
+ */
+class LoopFusion {
+   public:
+    //! \param[in] stmtContexts Statements of the function, in order
+    //! \param[in] session Session of the builder the statements came from
+    LoopFusion(const std::vector<StmtContext>& stmtContexts,
+               BuilderSession& session);
+
+    //! Fuse every pair of loops that can be, and write the resulting
+    //! execution schedules into a Computation built from the statements
+    //! \return Number of pairs of loops fused
+    unsigned int fuse(iegenlib::Computation* computation);
+
+    //! Get the execution schedule of each statement after fusion
+    const std::vector<ExecSchedule>& getSchedules() const { return schedules; }
+
+   private:
+    const std::vector<StmtContext>& stmtContexts;
+    BuilderSession& session;
+    //! Execution schedule of each statement, as fused so far
+    std::vector<ExecSchedule> schedules;
+    //! Scopes of the loops enclosing each statement in the source,
+    //! outermost first
+    std::vector<std::vector<const Scope*>> loops;
+
+    //! Try to fuse a loop enclosing a statement with the loop following it
+    //! \param[in] depth Number of loops outside the loop
+    //! \return whether the loops were fused
+    bool tryFuse(unsigned int stmtIndex, unsigned int depth,
+                 const DependenceAnalysis& analysis);
+
+    //! Check whether two statements' schedules agree up to some position
+    bool haveSamePrefix(unsigned int first, unsigned int second,
+                        unsigned int length) const;
+
+    //! Check whether two loops, with the same number of loops outside them,
+    //! have the same bounds
+    static bool haveSameBounds(const Scope* first, const Scope* second,
+                               unsigned int depth);
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,111 @@
+/*!
+ * \file LoopTiling.hpp
+ *
+ * \brief Tiling of nested loops, by rewriting the execution schedules of the
+ * statements built from a function
+ */
+
+#ifndef SPFIE_LOOPTILING_HPP
+#define SPFIE_LOOPTILING_HPP
+
+#include <string>
+#include <vector>
+
+#include "BuilderSession.hpp"
+#include "DependenceAnalysis.hpp"
+#include "StmtContext.hpp"
+#include "iegenlib.h"
+
+namespace spf_ie {
+
+/*!
+ * \struct TiledBand
+ *
+ * \brief Loops nested one directly inside the next, which are tiled together
+ */
+struct TiledBand {
+    //! Loops of the band, outermost first
+    std::vector<const Scope*> loops;
+    //! Tile size of each loop
+    std::vector<unsigned int> sizes;
+    //! Level of the outermost loop, counting the outermost loop of its nest
+    //! as 1
+    unsigned int level;
+
+    //! Get the name of the variable iterating over the tiles of a loop in
+    //! the band, like "tile_i"
+    std::string getTileIterator(unsigned int index) const;
+};
+
+/*!
+ * \class LoopTiling
+ *
+ * \brief Tiles loop nests of a Computation with the given tile size at each
+ * loop level, so that each tile's data can stay in cache while it is reused
+ *
+ * A band is a run of loops at levels with a nonzero tile size, each directly
+ * in the body of the one before. The body of each loop but the innermost
+ * holds the next loop, and may also hold statements before that loop. The
+ * bounds of each loop must not depend on the iterators of the band, so the
+ * tiles are rectangular. Each statement's schedule gains a tile dimension
+ * per loop of its band, ahead of the band's iterators. Statements ahead of
+ * an inner loop of the band run in its first tile.
+ *
+ * Tiling is legal when the loops of the band are fully permutable, meaning
+ * no dependence within the band goes backwards at any of its levels. In
+ * addition, a statement ahead of an inner loop must not depend on that loop
+ * through a dependence carried by the band. Bands which fail this are
+ * shortened from the inside until they pass, or left alone.
+ */
+class LoopTiling {
+   public:
+    //! \param[in] stmtContexts Statements of the function, in order
+    //! \param[in] dependences Dependences between the statements
+    LoopTiling(const std::vector<StmtContext>& stmtContexts,
+               const DependenceGraph& dependences);
+
+    //! Tile every band that can be, and write the resulting execution
+    //! schedules into a Computation built from the statements
+    //! \param[in] sizes Tile size for each loop level, outermost first; 0
+    //! (or no size at all) leaves the loops at a level untiled
+    //! \return Number of bands tiled
+    unsigned int tile(iegenlib::Computation* computation,
+                      const std::vector<unsigned int>& sizes);
+
+    //! Get the bands tiled
+    const std::vector<TiledBand>& getBands() const { return bands; }
+
+    //! Get the new schedule of each statement, in IEGenLib syntax, like
+    //! "{[i,j]->[0,tile_i,tile_j,i,0,j,0]: 32*tile_i <= i && ...}"
+    const std::vector<std::string>& getSchedules() const { return schedules; }
+
+   private:
+    const std::vector<StmtContext>& stmtContexts;
+    const DependenceGraph& dependences;
+    //! Bands tiled
+    std::vector<TiledBand> bands;
+    //! New schedule of each statement
+    std::vector<std::string> schedules;
+
+    //! Find the longest band starting at a loop
+    //! \param[in] level Level of the loop
+    TiledBand findBand(const Scope* loop, unsigned int level,
+                       const std::vector<unsigned int>& sizes) const;
+
+    //! Check whether tiling a band preserves every dependence
+    bool isLegal(const TiledBand& band) const;
+
+    //! Build the new schedule of a statement
+    //! \param[in] band Band the statement is in, if any
+    //! \param[in] dimension Dimension to zero-pad the schedule to
+    std::string buildSchedule(unsigned int stmtIndex, const TiledBand* band,
+                              unsigned int dimension) const;
+
+    //! Get the number of loops of a band enclosing a statement
+    unsigned int getDepthIn(unsigned int stmtIndex,
+                            const TiledBand& band) const;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,133 @@
+/*!
+ * \file PreambleCache.hpp
+ *
+ * \brief Ways to spend less time in the front end: reusing precompiled
+ * preambles across runs, and loading translation units serialized to AST
+ * files
+ */
+
+#ifndef SPFIE_PREAMBLECACHE_HPP
+#define SPFIE_PREAMBLECACHE_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringRef.h"
+
+using namespace clang;
+using namespace clang::tooling;
+
+namespace spf_ie {
+
+/*!
+ * \class PreambleCache
+ *
+ * \brief On-disk cache of precompiled headers built from the preambles of
+ * source files
+ *
+ * The preamble of a file is the run of preprocessor directives (mostly
+ * #includes) at its top, which is usually where almost all parsing time
+ * goes. The first time a preamble is seen it is copied into a header and
+ * precompiled; later runs over the same file, and other files starting
+ * with the same preamble and compiled with the same flags, load that PCH
+ * instead of parsing the headers again.
+ *
+ * A PCH is rebuilt whenever anything it was built from is newer than it.
+ * Files whose preamble cannot be precompiled are simply parsed in full.
+ *
+ * Safe to use from several threads (and processes) at once.
+ */
+class PreambleCache {
+   public:
+    /*!
+     * \struct Preamble
+     *
+     * \brief A precompiled preamble ready to be used by one ClangTool run
+     */
+    struct Preamble {
+        //! Whether a PCH is available (otherwise the file is parsed as is)
+        bool isValid() const { return !pchPath.empty(); }
+
+        //! Precompiled header to include
+        std::string pchPath;
+        //! Absolute path of the source file
+        std::string mainFilePath;
+        //! Contents of the source file, with its preamble blanked out (line
+        //! breaks are kept so that locations do not move)
+        std::string mainFileContents;
+        //! Directory of the source file, searched for its quoted includes
+        std::string mainFileDir;
+    };
+
+    //! \param[in] directory Directory holding precompiled preambles, created
+    //! if needed
+    explicit PreambleCache(std::string directory);
+
+    //! Get the precompiled preamble of a file, building it if there is no
+    //! up-to-date one
+    //! \param[in] compilations Compilation database to get the file's
+    //! flags from
+    //! \param[in] fileName Source file
+    //! \return the preamble, invalid if it could not be precompiled
+    Preamble get(const CompilationDatabase& compilations,
+                 const std::string& fileName);
+
+    //! Make a ClangTool use a precompiled preamble. The preamble must
+    //! outlive the tool.
+    static void apply(ClangTool& tool, const Preamble& preamble);
+
+    //! Load a translation unit serialized to an AST file (e.g. by clang
+    //! -emit-ast), which needs neither a preamble nor any parsing
+    //! \param[in] path AST file to load
+    //! \return the unit, or nullptr if the file could not be loaded
+    static std::unique_ptr<ASTUnit> loadASTFile(const std::string& path);
+
+    //! Get the number of files which reused an existing PCH
+    unsigned int getHits() const { return hits; }
+
+    //! Get the number of PCHs built
+    unsigned int getBuilds() const { return builds; }
+
+    //! Get the number of files whose preamble could not be precompiled
+    unsigned int getFailures() const { return failures; }
+
+   private:
+    //! Directory holding precompiled preambles
+    std::string directory;
+    //! Number of files which reused an existing PCH
+    std::atomic<unsigned int> hits;
+    //! Number of PCHs built
+    std::atomic<unsigned int> builds;
+    //! Number of files whose preamble could not be precompiled
+    std::atomic<unsigned int> failures;
+
+    //! Get the path of a file in the cache directory
+    std::string getPath(const std::string& key,
+                        const std::string& extension) const;
+
+    //! Write the header a preamble is precompiled from
+    //! \return whether the header was written
+    static bool writeHeader(const std::string& headerPath,
+                            const std::string& mainFilePath,
+                            llvm::StringRef preambleText);
+
+    //! Check that a PCH exists and that none of the files listed in its
+    //! dependency file are newer than it
+    static bool isUpToDate(const std::string& pchPath,
+                           const std::string& depPath);
+
+    //! Precompile a header, also writing the list of files it depends on
+    //! \param[in] tool Tool set up to compile the header
+    //! \return whether the PCH was built
+    static bool buildPCH(ClangTool& tool, const std::string& pchPath,
+                         const std::string& depPath);
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -5,7 +5,14 @@
 #include <string>
 #include <vector>
 
+#include "BuilderSession.hpp"
+#include "CodeGenerator.hpp"
+#include "DependenceAnalysis.hpp"
+#include "IntensityEstimator.hpp"
+#include "LocalityAnalysis.hpp"
+#include "LoopTiling.hpp"
 #include "StmtContext.hpp"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/Stmt.h"
@@ -21,29 +28,94 @@ namespace spf_ie {
  * \brief Class handling building up the sparse polyhedral model for a function
  *
  * Contains the entry point for function processing. Recursively visits each
- * statement in the source.
+ * statement in the source. A builder holds no state shared with other
+ * builders, so separate builders may be used concurrently.
  */
 class SPFComputationBuilder {
    public:
-    SPFComputationBuilder();
+    //! \param[in] astContext ASTContext of the translation unit containing
+    //! the functions to be processed
+    //! \param[in] recoverableErrors Whether a function which cannot be built
+    //! throws an SPFError, so that the caller may skip it and carry on,
+    //! instead of printing the error and exiting
+    explicit SPFComputationBuilder(const ASTContext& astContext,
+                                   bool recoverableErrors = false);
+
+    SPFComputationBuilder(const SPFComputationBuilder&) = delete;
+    SPFComputationBuilder& operator=(const SPFComputationBuilder&) = delete;
+
     //! Entry point for each function; gather information about its
     //! statements and data accesses into an Computation
     //! \param[in] funcDecl Function declaration to process
     std::unique_ptr<iegenlib::Computation> buildComputationFromFunction(
         FunctionDecl* funcDecl);
 
+    //! Find the dependences between the statements of the function most
+    //! recently built
+    DependenceGraph analyzeDependences();
+
+    //! Classify the array accesses of the function most recently built by
+    //! their stride along the innermost loop enclosing them
+    LocalityReport analyzeLocality();
+
+    //! Estimate the memory traffic and arithmetic of the statements and loop
+    //! nests of the function most recently built (see IntensityEstimator)
+    IntensityReport estimateIntensity();
+
+    //! Generate code for the function most recently built
+    //! \param[in] funcDecl The function, which must be the one most recently
+    //! built
+    //! \param[in] target Language to generate
+    std::string generateCode(FunctionDecl* funcDecl,
+                             CodeGenerator::Target target);
+
+    //! Replace the execution schedules of the Computation most recently
+    //! built with ones optimized by isl (see ScheduleOptimizer)
+    //! \param[in,out] computation The Computation most recently built
+    //! \param[out] reason Why the schedules could not be optimized, if not
+    //! \return false if the Computation was left as it was
+    bool optimizeSchedules(iegenlib::Computation* computation,
+                           std::string& reason);
+
+    //! Fuse adjacent loops with the same bounds in the Computation most
+    //! recently built, where dependences allow (see LoopFusion)
+    //! \param[in,out] computation The Computation most recently built
+    //! \return Number of pairs of loops fused
+    unsigned int fuseLoops(iegenlib::Computation* computation);
+
+    //! Tile the loop nests of the Computation most recently built, where
+    //! dependences allow (see LoopTiling); code generated for the function
+    //! afterwards is tiled to match
+    //! \param[in,out] computation The Computation most recently built
+    //! \param[in] sizes Tile size for each loop level, outermost first, 0
+    //! for levels not to tile
+    //! \return Number of bands of loops tiled
+    unsigned int tileLoops(iegenlib::Computation* computation,
+                           const std::vector<unsigned int>& sizes);
+
    private:
+    //! Session information used throughout building
+    BuilderSession session;
     //! Number of the statement currently being processed
     unsigned int stmtNumber;
     //! The length of the longest schedule tuple
     int largestScheduleDimension;
-    //! The information about the context we are currently in, which is
-    //! copied for completed statements
-    StmtContext currentStmtContext;
+    //! Innermost scope we are currently in, shared by every statement in it
+    std::shared_ptr<const Scope> currentScope;
+    //! Execution schedule at the current position
+    ExecSchedule currentSchedule;
     //! Context information attached to each completed statement
     std::vector<StmtContext> stmtContexts;
     //! Computation being built up
     std::unique_ptr<iegenlib::Computation> computation;
+    //! Bands of loops tiled in the function most recently built
+    std::vector<TiledBand> tiledBands;
+
+    //! Build the Computation for a function, throwing an SPFError if it
+    //! cannot be (see buildComputationFromFunction)
+    //! \param[in] funcDecl Function declaration to process
+    std::unique_ptr<iegenlib::Computation> buildComputation(
+        FunctionDecl* funcDecl);
 
     //! Process the body of a control structure, such as a for loop
     //! \param[in] stmt Body statement (which may be compound) to process
@@ -0,0 +1,65 @@
+/*!
+ * \file SPFExprPrinter.hpp
+ *
+ * \brief Printer from Clang expressions to SPF (IEGenLib) syntax
+ */
+
+#ifndef SPFIE_SPFEXPRPRINTER_HPP
+#define SPFIE_SPFEXPRPRINTER_HPP
+
+#include <string>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/PrettyPrinter.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/*!
+ * \class SPFExprPrinter
+ *
+ * \brief Prints an expression in SPF syntax in a single traversal.
+ *
+ * Array subscripts become uninterpreted function calls (A[i][j] prints as
+ * A(i,j)), casts are dropped and operators are printed with uniform spacing,
+ * with == written as SPF's =. Output is built from the AST alone, so it does
+ * not depend on the original spelling (macros, whitespace) of the source.
+ */
+class SPFExprPrinter : public RecursiveASTVisitor<SPFExprPrinter> {
+   public:
+    //! Get the SPF representation of an expression
+    static std::string print(Expr* expr, const ASTContext& Ctx);
+
+    //! Print an expression in SPF syntax to a stream
+    static void print(Expr* expr, const ASTContext& Ctx, raw_ostream& os);
+
+    //! Dispatch supported expressions to the Traverse* methods below, and
+    //! pretty-print anything else as C
+    bool TraverseStmt(Stmt* stmt);
+
+    bool TraverseParenExpr(ParenExpr* expr);
+    bool TraverseImplicitCastExpr(ImplicitCastExpr* expr);
+    bool TraverseCStyleCastExpr(CStyleCastExpr* expr);
+    bool TraverseIntegerLiteral(IntegerLiteral* expr);
+    bool TraverseDeclRefExpr(DeclRefExpr* expr);
+    bool TraverseArraySubscriptExpr(ArraySubscriptExpr* expr);
+    bool TraverseUnaryOperator(UnaryOperator* expr);
+    bool TraverseBinaryOperator(BinaryOperator* expr);
+
+   private:
+    SPFExprPrinter(const ASTContext& Ctx, raw_ostream& os)
+        : policy(Ctx.getPrintingPolicy()), os(os) {}
+
+    //! Policy for pretty-printing expressions SPF has no syntax for
+    PrintingPolicy policy;
+    //! Stream being printed to
+    raw_ostream& os;
+};
+
+}  // namespace spf_ie
+
+#endif
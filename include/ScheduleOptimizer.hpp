@@ -0,0 +1,100 @@
+/*!
+ * \file ScheduleOptimizer.hpp
+ *
+ * \brief Optimization of the execution schedules of the statements built
+ * from a function, using isl's scheduler
+ */
+
+#ifndef SPFIE_SCHEDULEOPTIMIZER_HPP
+#define SPFIE_SCHEDULEOPTIMIZER_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "BuilderSession.hpp"
+#include "DependenceAnalysis.hpp"
+#include "StmtContext.hpp"
+#include "iegenlib.h"
+
+namespace spf_ie {
+
+/*!
+ * \class ScheduleOptimizer
+ *
+ * \brief Replaces the source-order execution schedules of a Computation with
+ * ones computed by isl's scheduler
+ *
+ * The statements' iteration spaces and accesses (as found by
+ * DependenceAnalysis, including scalars) are given to isl, which derives
+ * every flow, anti and output dependence between statement instances in
+ * their original order. The scheduler then looks for schedules which
+ * respect those dependences, with as many outer dimensions as possible along
+ * which no dependence is carried (parallelism), and with dependent instances
+ * kept close together (locality), fusing and interchanging loops as needed.
+ *
+ * isl can only represent affine sets, so functions whose loop bounds or
+ * conditions go through index arrays are left alone. Only scalars the
+ * function never writes become isl parameters, which are constant
+ * throughout; bounds and conditions on other scalars also leave the function
+ * alone. Subscripts which go through index arrays or such scalars are taken
+ * to touch any element of the array.
+ */
+class ScheduleOptimizer {
+   public:
+    //! \param[in] stmtContexts Statements of the function, in order
+    //! \param[in] session Session of the builder the statements came from
+    ScheduleOptimizer(const std::vector<StmtContext>& stmtContexts,
+                      BuilderSession& session);
+
+    //! Compute new schedules and write them into a Computation built from
+    //! the statements
+    //! \return false, leaving the Computation as it was, if the function
+    //! cannot be scheduled (see getReason())
+    bool optimize(iegenlib::Computation* computation);
+
+    //! Get the new schedule of each statement, in IEGenLib syntax, like
+    //! "{[i,j]->[t0,t1]: t0 = j && t1 = i}"
+    const std::vector<std::string>& getSchedules() const { return schedules; }
+
+    //! Get why the function could not be scheduled
+    const std::string& getReason() const { return reason; }
+
+   private:
+    const std::vector<StmtContext>& stmtContexts;
+    BuilderSession& session;
+    //! New schedule of each statement
+    std::vector<std::string> schedules;
+    //! Why the function could not be scheduled, if it could not
+    std::string reason;
+
+    //! Build the isl strings describing the statements
+    //! \param[out] params Symbolic constants mentioned
+    //! \return false if some iteration space is not affine
+    bool buildIslInput(std::string& domains, std::string& originalSchedules,
+                       std::string& reads, std::string& writes,
+                       std::set<std::string>& params);
+
+    //! Run isl's scheduler on the statements, filling in schedules
+    bool computeSchedules(const std::string& domains,
+                          const std::string& originalSchedules,
+                          const std::string& reads, const std::string& writes);
+
+    //! Get the isl form of an expression, with symbols as parameters
+    //! \param[in] written Scalars the function writes, which cannot be
+    //! parameters
+    //! \param[in,out] params Parameters mentioned so far
+    //! \return false if the expression calls an uninterpreted function or
+    //! mentions a written scalar
+    static bool toIsl(const AffineExpr& expr,
+                      const std::set<std::string>& written,
+                      std::set<std::string>& params, std::string& result);
+
+    //! Get the name of a statement's tuple in isl, like "S0"
+    static std::string getTupleName(unsigned int stmtIndex);
+};
+
+}  // namespace spf_ie
+
+#endif
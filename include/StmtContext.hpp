@@ -14,19 +14,82 @@
 #include <memory>
 #include <stack>
 #include <string>
-#include <tuple>
 #include <vector>
 
+#include "AffineExpr.hpp"
+#include "BuilderSession.hpp"
 #include "DataAccessHandler.hpp"
 #include "ExecSchedule.hpp"
 #include "clang/AST/Expr.h"
 #include "clang/AST/OperationKinds.h"
 #include "clang/AST/Stmt.h"
+#include "iegenlib.h"
 
 using namespace clang;
 
 namespace spf_ie {
 
+/*!
+ * \struct Scope
+ *
+ * \brief A loop or if statement enclosing some statements.
+ *
+ * Scopes are immutable once built and link to their enclosing scope, so every
+ * statement in a scope shares the same node rather than holding its own copy
+ * of the iterators, constraints and invariants. A null scope is the function
+ * body itself.
+ */
+struct Scope {
+    //! What kind of control structure a scope comes from
+    enum class Kind { Loop, Guard };
+
+    Scope(Kind kind, std::shared_ptr<const Scope> parent, Stmt* origin)
+        : kind(kind), parent(parent), origin(origin) {}
+
+    //! Build the scope of a for loop nested in parent
+    static std::shared_ptr<const Scope> makeLoop(
+        std::shared_ptr<const Scope> parent, ForStmt* forStmt,
+        BuilderSession& session);
+
+    //! Build the scope of an if statement nested in parent
+    //! \param[in] invert Whether to invert the if condition (for use in
+    //! else clauses)
+    static std::shared_ptr<const Scope> makeGuard(
+        std::shared_ptr<const Scope> parent, IfStmt* ifStmt, bool invert,
+        BuilderSession& session);
+
+    //! Iterators of all loops from the outermost scope down to this one
+    static std::vector<std::string> getIterators(const Scope* scope);
+
+    //! Constraints of all scopes from the outermost down to this one
+    static std::vector<const Constraint*> getConstraints(const Scope* scope);
+
+    //! Whether a data space is held invariant by this scope or any enclosing
+    //! one
+    static bool isInvariant(const Scope* scope, const std::string& dataSpace);
+
+    const Kind kind;
+    //! Enclosing scope, null at function level
+    const std::shared_ptr<const Scope> parent;
+    //! The for or if statement this scope comes from
+    Stmt* const origin;
+
+    //! Variable iterated over (loops only)
+    std::string iterator;
+    //! Constraints introduced by this scope -- for loops, the lower bound
+    //! from the initializer followed by the condition
+    std::vector<Constraint> constraints;
+    //! Data spaces which must be held invariant inside this scope
+    std::vector<std::string> invariants;
+
+   private:
+    //! Convenience function to build a constraint from the given parameters
+    static Constraint makeConstraint(Expr* lower, Expr* upper,
+                                     BinaryOperatorKind oper,
+                                     const std::vector<std::string>& iterators,
+                                     BuilderSession& session);
+};
+
 /*!
  * \struct StmtContext
  *
@@ -34,75 +97,54 @@ namespace spf_ie {
  * space and execution schedule.
  */
 struct StmtContext {
-    StmtContext();
+    //! Create a context for a statement
+    //! \param[in] session Session of the builder this context belongs to
+    //! \param[in] scope Innermost scope enclosing the statement
+    //! \param[in] schedule Execution schedule of the statement
+    StmtContext(BuilderSession* session, std::shared_ptr<const Scope> scope,
+                const ExecSchedule& schedule);
 
-    //! Copy the information from an existing StmtContext.
-    //! Preserves only information that builds up in nested contexts,
-    //! excluding information that is only applicable per-statement.
-    //! \param[in] other Existing StmtContext to copy
-    StmtContext(StmtContext* other);
+    //! Session of the builder this context belongs to
+    BuilderSession* session;
 
     //! Actual AST Stmt
     Stmt* stmt;
 
-    //! Variables being iterated over
-    std::vector<std::string> iterators;
-    //! Constraints on iteration -- inequalities and equalities
-    std::vector<std::shared_ptr<
-        std::tuple<std::string, std::string, BinaryOperatorKind>>>
-        constraints;
+    //! Innermost scope enclosing the statement
+    std::shared_ptr<const Scope> scope;
     //! Execution schedule
     ExecSchedule schedule;
     //! Data accesses (both reads and writes)
     DataAccessHandler dataAccesses;
 
-    //! Data spaces which are held invariant in the current context, grouped
-    //! by the loop that they are invariant in
-    std::vector<std::vector<std::string>> invariants;
+    //! Variables being iterated over, outermost first
+    std::vector<std::string> getIterators() const;
 
-    //! Get a string representing the iteration space
-    std::string getIterSpaceString();
-
-    //! Get a string representing the execution schedule
-    std::string getExecScheduleString();
-
-    //! Get a string representing the given data access
-    std::string getDataAccessString(ArrayAccess*);
+    //! Constraints on iteration -- inequalities and equalities
+    std::vector<const Constraint*> getConstraints() const;
 
-    // enter* and exit* methods add iterators and constraints when entering a
-    // new scope, remove when leaving the scope
+    //! Get a string representing the iteration space
+    std::string getIterSpaceString() const;
 
-    //! Add context information from a for loop
-    void enterFor(ForStmt* forStmt);
+    //! Build the iteration space directly from the constraints, without
+    //! going through IEGenLib's parser (caller adopts the result)
+    iegenlib::Set* buildIterSpace() const;
 
-    //! Remove context information from a for loop
-    void exitFor();
+    //! Get a string representing the execution schedule
+    std::string getExecScheduleString() const;
 
-    //! Add context information from an if statement
-    //! \param[in] ifStmt If statement to use
-    //! \param[in] invert Whether to invert the if condition (for use in
-    //! else clauses)
-    void enterIf(IfStmt* ifStmt, bool invert = false);
+    //! Build the execution schedule directly, without going through
+    //! IEGenLib's parser (caller adopts the result)
+    iegenlib::Relation* buildExecSchedule() const;
 
-    //! Remove context information from an if statement
-    void exitIf();
+    //! Get a string representing the given data access
+    std::string getDataAccessString(ArrayAccess*) const;
 
    private:
-    //! Convenience function to add a new constraint from the given parameters
-    void makeAndInsertConstraint(Expr* lower, Expr* upper,
-                                 BinaryOperatorKind oper);
-
-    //! Convenience function to add a new constraint from the given parameters
-    void makeAndInsertConstraint(std::string lower, Expr* upper,
-                                 BinaryOperatorKind oper);
-
-    //! Get the source code of an expression, with array accesses changed to
-    //! function calls (for example, "i < A[i]" becomes "i < A(i)")
-    static std::string exprToStringWithSafeArrays(Expr* expr);
-
     //! Get the tuple of iterators as a string, for use in other to-string
     //! methods. Output like "[i,j,k]"
-    std::string getItersTupleString();
+    static std::string getItersTupleString(
+        const std::vector<std::string>& iterators);
 };
 
 }  // namespace spf_ie
@@ -2,11 +2,15 @@
 #define SPFIE_UTILS_HPP
 
 #include <map>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/OperationKinds.h"
 #include "clang/AST/Stmt.h"
+#include "clang/Basic/SourceLocation.h"
 
 //! Base name (will be followed by a unique string) for use in variable
 //! substitutions
@@ -16,6 +20,30 @@ using namespace clang;
 
 namespace spf_ie {
 
+/*!
+ * \class SPFError
+ *
+ * \brief An error in building a Computation from a function; the builder
+ * either exits with it or passes it on, depending on whether its errors are
+ * recoverable
+ */
+class SPFError : public std::runtime_error {
+   public:
+    SPFError(const std::string& message, SourceLocation location,
+             const std::string& context = "")
+        : std::runtime_error(message), location(location), context(context) {}
+
+    //! Location in the source code the error concerns, which may be invalid
+    SourceLocation getLocation() const { return location; }
+
+    //! Source code of the statement the error concerns, if any
+    const std::string& getContext() const { return context; }
+
+   private:
+    SourceLocation location;
+    std::string context;
+};
+
 /*!
  * \class Utils
  *
@@ -23,27 +51,23 @@ namespace spf_ie {
  */
 class Utils {
    public:
-    //! Print an error to standard error and exit with error status
-    static void printErrorAndExit(std::string message);
+    //! Throw an error as an SPFError
+    static void throwError(std::string message);
 
-    //! Print an error to standard error, including the context of a
-    //! statement in the source code, and exit with error status
-    static void printErrorAndExit(std::string message, clang::Stmt* stmt);
+    //! Throw an error as an SPFError, including the location and source code
+    //! of the statement it concerns
+    static void throwError(std::string message, clang::Stmt* stmt,
+                           const ASTContext& Ctx);
+
+    //! Print an error to standard error, including the context of the
+    //! statement it concerns if any, and exit with error status
+    static void printErrorAndExit(const SPFError& error, const ASTContext& Ctx);
 
     //! Print a line (horizontal separator) to standard output
     static void printSmallLine();
 
     //! Get the source code of a statement as a string
-    static std::string stmtToString(clang::Stmt* stmt);
-
-    //! Get a copy of the given string with all instances of the substring to
-    //! find replaced as specified
-    //! \param[in] input String to perform substitutions on (will not be
-    //! modified)
-    //! \param[in] toFind String to find (and replace) within input
-    //! \param[in] replaceWith String to use as replacement
-    static std::string replaceInString(std::string input, std::string toFind,
-                                       std::string replaceWith);
+    static std::string stmtToString(clang::Stmt* stmt, const ASTContext& Ctx);
 
     //! Retrieve "all" array accesses, from left to right, contained in an
     //! expression.
@@ -53,20 +77,22 @@ class Utils {
     static void getExprArrayAccesses(
         Expr* expr, std::vector<ArraySubscriptExpr*>& currentList);
 
-    //! Get a unique variable name to use in substitutions
-    static std::string getVarReplacementName();
-
     //! Get a string representation of a binary operator
     static std::string binaryOperatorKindToString(BinaryOperatorKind bo);
 
+    //! Lock to hold while creating, printing, or destroying IEGenLib
+    //! objects, since IEGenLib's parser and environment are process-global
+    static std::mutex iegenlibMutex;
+
+    //! Lock to hold while querying a SourceManager, like for the source text
+    //! or location of a statement, since it fills caches of its own as it
+    //! goes and functions may be built on several threads
+    static std::mutex sourceManagerMutex;
+
    private:
     //! String representations of valid operators for use in constraints
     static const std::map<BinaryOperatorKind, std::string> operatorStrings;
 
-    //! Number to be used (and incremented) when creating replacement variable
-    //! names
-    static unsigned int replacementVarNumber;
-
     Utils() = delete;
 };
 
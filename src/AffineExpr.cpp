@@ -0,0 +1,316 @@
+#include "AffineExpr.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Utils.hpp"
+#include "clang/AST/Expr.h"
+#include "clang/AST/OperationKinds.h"
+#include "iegenlib.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/* AffineTerm */
+
+bool AffineTerm::hasSameAtom(const AffineTerm& other) const {
+    if (kind != other.kind || name != other.name) {
+        return false;
+    }
+    if (kind == Kind::UFCall) {
+        if (args.size() != other.args.size()) {
+            return false;
+        }
+        for (unsigned int i = 0; i < args.size(); ++i) {
+            if (args[i]->toString() != other.args[i]->toString()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* AffineExpr */
+
+AffineExpr AffineExpr::makeIterator(std::string name, unsigned int index) {
+    AffineExpr expr;
+    AffineTerm term(AffineTerm::Kind::Iterator, 1, name);
+    term.iteratorIndex = index;
+    expr.terms.push_back(term);
+    return expr;
+}
+
+AffineExpr AffineExpr::makeSymbol(std::string name) {
+    AffineExpr expr;
+    expr.terms.push_back(AffineTerm(AffineTerm::Kind::Symbol, 1, name));
+    return expr;
+}
+
+AffineExpr AffineExpr::makeUFCall(std::string name,
+                                  const std::vector<AffineExpr>& args) {
+    AffineExpr expr;
+    AffineTerm term(AffineTerm::Kind::UFCall, 1, name);
+    for (const auto& arg : args) {
+        term.args.push_back(std::make_shared<const AffineExpr>(arg));
+    }
+    expr.terms.push_back(term);
+    return expr;
+}
+
+AffineExpr AffineExpr::fromExpr(Expr* expr,
+                                const std::vector<std::string>& iterators,
+                                BuilderSession& session) {
+    AffineExpr result;
+    Expr* nonAffine;
+    if (!tryFromExpr(expr, iterators, session, result, &nonAffine)) {
+        Utils::throwError("Non-affine expression unsupported by SPF",
+                          nonAffine, session.getASTContext());
+    }
+    return result;
+}
+
+bool AffineExpr::tryFromExpr(Expr* expr,
+                             const std::vector<std::string>& iterators,
+                             BuilderSession& session, AffineExpr& result,
+                             Expr** nonAffine) {
+    const ASTContext& Ctx = session.getASTContext();
+    Expr* usableExpr = expr->IgnoreParenCasts();
+
+    // anything that folds to an integer is a constant
+    Expr::EvalResult evalResult;
+    if (!usableExpr->isValueDependent() &&
+        usableExpr->EvaluateAsInt(evalResult, Ctx)) {
+        result = AffineExpr(evalResult.Val.getInt().getExtValue());
+        return true;
+    }
+
+    if (DeclRefExpr* asDeclRef = dyn_cast<DeclRefExpr>(usableExpr)) {
+        std::string name = asDeclRef->getDecl()->getNameAsString();
+        auto it = std::find(iterators.begin(), iterators.end(), name);
+        if (it != iterators.end()) {
+            result = makeIterator(name, it - iterators.begin());
+        } else {
+            result = makeSymbol(name);
+        }
+        return true;
+    } else if (isa<ArraySubscriptExpr>(usableExpr)) {
+        // collect indexes of a (possibly multidimensional) access, outermost
+        // dimension first
+        std::vector<AffineExpr> args;
+        Expr* base = usableExpr;
+        while (ArraySubscriptExpr* asArrayAccess =
+                   dyn_cast<ArraySubscriptExpr>(base)) {
+            AffineExpr arg;
+            if (!tryFromExpr(asArrayAccess->getIdx(), iterators, session, arg,
+                             nonAffine)) {
+                return false;
+            }
+            args.insert(args.begin(), arg);
+            base = asArrayAccess->getBase()->IgnoreParenImpCasts();
+        }
+        result = makeUFCall(session.getSPFString(base), args);
+        return true;
+    } else if (BinaryOperator* asBinOper =
+                   dyn_cast<BinaryOperator>(usableExpr)) {
+        BinaryOperatorKind oper = asBinOper->getOpcode();
+        if (oper == BO_Add || oper == BO_Sub || oper == BO_Mul) {
+            AffineExpr lhs;
+            AffineExpr rhs;
+            if (!tryFromExpr(asBinOper->getLHS(), iterators, session, lhs,
+                             nonAffine) ||
+                !tryFromExpr(asBinOper->getRHS(), iterators, session, rhs,
+                             nonAffine)) {
+                return false;
+            }
+            if (oper == BO_Add) {
+                result = lhs + rhs;
+                return true;
+            } else if (oper == BO_Sub) {
+                result = lhs - rhs;
+                return true;
+            } else if (lhs.isConstant()) {
+                result = rhs.scale(lhs.getConstant());
+                return true;
+            } else if (rhs.isConstant()) {
+                result = lhs.scale(rhs.getConstant());
+                return true;
+            }
+        }
+    } else if (UnaryOperator* asUnOper =
+                   dyn_cast<UnaryOperator>(usableExpr)) {
+        if (asUnOper->getOpcode() == UO_Minus ||
+            asUnOper->getOpcode() == UO_Plus) {
+            AffineExpr sub;
+            if (!tryFromExpr(asUnOper->getSubExpr(), iterators, session, sub,
+                             nonAffine)) {
+                return false;
+            }
+            result = asUnOper->getOpcode() == UO_Minus ? sub.scale(-1) : sub;
+            return true;
+        }
+    }
+
+    if (nonAffine) {
+        *nonAffine = expr;
+    }
+    return false;
+}
+
+AffineExpr AffineExpr::operator+(const AffineExpr& other) const {
+    AffineExpr sum = *this;
+    for (const auto& term : other.terms) {
+        sum.addTerm(term);
+    }
+    sum.constant += other.constant;
+    return sum;
+}
+
+AffineExpr AffineExpr::operator-(const AffineExpr& other) const {
+    return *this + other.scale(-1);
+}
+
+AffineExpr AffineExpr::scale(int factor) const {
+    AffineExpr scaled(constant * factor);
+    if (factor != 0) {
+        for (const auto& term : terms) {
+            scaled.terms.push_back(term);
+            scaled.terms.back().coefficient *= factor;
+        }
+    }
+    return scaled;
+}
+
+std::string AffineExpr::toString() const { return toString(nullptr); }
+
+std::string AffineExpr::toString(
+    const std::vector<std::string>& iterators) const {
+    return toString(&iterators);
+}
+
+std::string AffineExpr::toString(
+    const std::vector<std::string>* iterators) const {
+    std::ostringstream os;
+    bool first = true;
+    for (const auto& term : terms) {
+        int coefficient = term.coefficient;
+        if (first) {
+            if (coefficient < 0) {
+                os << "-";
+            }
+        } else {
+            os << (coefficient < 0 ? " - " : " + ");
+        }
+        first = false;
+        if (std::abs(coefficient) != 1) {
+            os << std::abs(coefficient) << "*";
+        }
+        if (iterators && term.kind == AffineTerm::Kind::Iterator) {
+            os << iterators->at(term.iteratorIndex);
+        } else {
+            os << term.name;
+        }
+        if (term.kind == AffineTerm::Kind::UFCall) {
+            os << "(";
+            for (unsigned int i = 0; i < term.args.size(); ++i) {
+                if (i != 0) {
+                    os << ",";
+                }
+                os << term.args[i]->toString(iterators);
+            }
+            os << ")";
+        }
+    }
+    if (first) {
+        os << constant;
+    } else if (constant != 0) {
+        os << (constant < 0 ? " - " : " + ") << std::abs(constant);
+    }
+    return os.str();
+}
+
+iegenlib::Exp* AffineExpr::toIEGenLibExp() const {
+    iegenlib::Exp* exp = new iegenlib::Exp();
+    for (const auto& term : terms) {
+        switch (term.kind) {
+            case AffineTerm::Kind::Iterator:
+                exp->addTerm(new iegenlib::TupleVarTerm(term.coefficient,
+                                                        term.iteratorIndex));
+                break;
+            case AffineTerm::Kind::Symbol:
+                exp->addTerm(
+                    new iegenlib::VarTerm(term.coefficient, term.name));
+                break;
+            case AffineTerm::Kind::UFCall: {
+                iegenlib::UFCallTerm* call = new iegenlib::UFCallTerm(
+                    term.coefficient, term.name, term.args.size());
+                for (unsigned int i = 0; i < term.args.size(); ++i) {
+                    call->setParamExp(i, term.args[i]->toIEGenLibExp());
+                }
+                exp->addTerm(call);
+                break;
+            }
+        }
+    }
+    if (constant != 0) {
+        exp->addTerm(new iegenlib::Term(constant));
+    }
+    return exp;
+}
+
+void AffineExpr::addTerm(const AffineTerm& term) {
+    for (auto it = terms.begin(); it != terms.end(); ++it) {
+        if (it->hasSameAtom(term)) {
+            it->coefficient += term.coefficient;
+            if (it->coefficient == 0) {
+                terms.erase(it);
+            }
+            return;
+        }
+    }
+    terms.push_back(term);
+}
+
+/* Constraint */
+
+std::string Constraint::toString() const {
+    return lhs.toString() + " " + Utils::binaryOperatorKindToString(oper) +
+           " " + rhs.toString();
+}
+
+std::string Constraint::toString(
+    const std::vector<std::string>& iterators) const {
+    return lhs.toString(iterators) + " " +
+           Utils::binaryOperatorKindToString(oper) + " " +
+           rhs.toString(iterators);
+}
+
+void Constraint::addToConjunction(iegenlib::Conjunction* conjunction) const {
+    // IEGenLib inequalities are of the form exp >= 0
+    const AffineExpr one(1);
+    switch (oper) {
+        case BO_LT:
+            conjunction->addInequality((rhs - lhs - one).toIEGenLibExp());
+            break;
+        case BO_LE:
+            conjunction->addInequality((rhs - lhs).toIEGenLibExp());
+            break;
+        case BO_GT:
+            conjunction->addInequality((lhs - rhs - one).toIEGenLibExp());
+            break;
+        case BO_GE:
+            conjunction->addInequality((lhs - rhs).toIEGenLibExp());
+            break;
+        case BO_EQ:
+            conjunction->addEquality((lhs - rhs).toIEGenLibExp());
+            break;
+        default:
+            Utils::throwError("Invalid operator type encountered.");
+    }
+}
+
+}  // namespace spf_ie
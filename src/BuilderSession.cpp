@@ -0,0 +1,58 @@
+#include "BuilderSession.hpp"
+
+#include <string>
+#include <utility>
+
+#include "Instrumentation.hpp"
+#include "SPFExprPrinter.hpp"
+#include "Utils.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/* BuilderSession */
+
+BuilderSession::BuilderSession(const ASTContext& astContext,
+                               bool recoverableErrors)
+    : astContext(astContext),
+      recoverableErrors(recoverableErrors),
+      replacementVarNumber(0) {}
+
+std::string BuilderSession::getVarReplacementName() {
+    Instrumentation::count(Instrumentation::Counter::ReplacementVars);
+    return REPLACEMENT_VAR_BASE_NAME + std::to_string(replacementVarNumber++);
+}
+
+const std::string& BuilderSession::getSourceText(Stmt* stmt) {
+    auto it = sourceTexts.find(stmt);
+    if (it == sourceTexts.end()) {
+        it = sourceTexts.emplace(stmt, Utils::stmtToString(stmt, astContext))
+                 .first;
+    }
+    return it->second;
+}
+
+const std::string& BuilderSession::getSPFString(Expr* expr) {
+    auto it = spfStrings.find(expr);
+    if (it == spfStrings.end()) {
+        it = spfStrings.emplace(expr, SPFExprPrinter::print(expr, astContext))
+                 .first;
+    }
+    return it->second;
+}
+
+void BuilderSession::setSPFString(Expr* expr, std::string str) {
+    spfStrings[expr] = std::move(str);
+}
+
+void BuilderSession::startFunction() {
+    replacementVarNumber = 0;
+    sourceTexts.clear();
+    spfStrings.clear();
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,767 @@
+#include "CodeGenerator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "DataAccessHandler.hpp"
+#include "DependenceAnalysis.hpp"
+#include "StmtContext.hpp"
+#include "Utils.hpp"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "clang/AST/Type.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/StringRef.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+//! Get a constraint with an iterator replaced by another variable
+static Constraint renameIterator(const Constraint& constraint,
+                                 const std::string& iterator,
+                                 const std::string& replacement) {
+    auto rename = [&](const AffineExpr& expr) {
+        AffineExpr renamed = expr;
+        for (const auto& term : expr.getTerms()) {
+            if (term.kind == AffineTerm::Kind::Iterator &&
+                term.name == iterator) {
+                renamed = renamed -
+                          AffineExpr::makeIterator(iterator, term.iteratorIndex)
+                              .scale(term.coefficient) +
+                          AffineExpr::makeIterator(replacement,
+                                                   term.iteratorIndex)
+                              .scale(term.coefficient);
+            }
+        }
+        return renamed;
+    };
+    return Constraint(rename(constraint.lhs), rename(constraint.rhs),
+                      constraint.oper);
+}
+
+/* CodeGenerator */
+
+CodeGenerator::CodeGenerator(const std::vector<StmtContext>& stmtContexts,
+                             const DependenceGraph& dependences,
+                             BuilderSession& session,
+                             const std::vector<TiledBand>& tiledBands)
+    : stmtContexts(stmtContexts),
+      dependences(dependences),
+      session(session),
+      tiledBands(tiledBands),
+      target(Target::COpenMP),
+      parallelLoop(nullptr) {}
+
+std::string CodeGenerator::generate(FunctionDecl* funcDecl, Target target) {
+    this->target = target;
+    parallelLoop = nullptr;
+    const ASTContext& Ctx = session.getASTContext();
+    std::ostringstream os;
+
+    // signature, as written
+    llvm::StringRef signature;
+    {
+        std::lock_guard<std::mutex> lock(Utils::sourceManagerMutex);
+        signature = Lexer::getSourceText(
+            CharSourceRange::getCharRange(funcDecl->getBeginLoc(),
+                                          funcDecl->getBody()->getBeginLoc()),
+            Ctx.getSourceManager(), Ctx.getLangOpts());
+    }
+    os << signature.rtrim().str() << " {\n";
+
+    std::vector<unsigned int> stmts;
+    for (unsigned int i = 0; i < stmtContexts.size(); ++i) {
+        stmts.push_back(i);
+    }
+    writeStmts(stmts, 0, 1, StmtMode::Source, true, os);
+    os << "}\n";
+    return os.str();
+}
+
+std::string CodeGenerator::toC(const AffineExpr& expr) {
+    std::ostringstream os;
+    bool first = true;
+    for (const auto& term : expr.getTerms()) {
+        int coefficient = term.coefficient;
+        if (first) {
+            if (coefficient < 0) {
+                os << "-";
+            }
+        } else {
+            os << (coefficient < 0 ? " - " : " + ");
+        }
+        first = false;
+        if (std::abs(coefficient) != 1) {
+            os << std::abs(coefficient) << "*";
+        }
+        os << term.name;
+        for (const auto& arg : term.args) {
+            os << "[" << toC(*arg) << "]";
+        }
+    }
+    int constant = expr.getConstant();
+    if (first) {
+        os << constant;
+    } else if (constant != 0) {
+        os << (constant < 0 ? " - " : " + ") << std::abs(constant);
+    }
+    return os.str();
+}
+
+std::string CodeGenerator::toC(const Constraint& constraint) {
+    return toC(constraint.lhs) + " " +
+           BinaryOperator::getOpcodeStr(constraint.oper).str() + " " +
+           toC(constraint.rhs);
+}
+
+void CodeGenerator::writeStmts(const std::vector<unsigned int>& stmts,
+                               unsigned int numOpen, unsigned int depth,
+                               StmtMode mode, bool isParallel,
+                               std::ostream& os) {
+    // statements are in schedule order, so those sharing a scope are
+    // adjacent; open and close scopes as the statements move between them
+    std::vector<const Scope*> openScopes;
+    unsigned int i = 0;
+    while (i < stmts.size()) {
+        std::vector<const Scope*> chain =
+            getScopeChain(stmtContexts[stmts[i]].scope.get());
+        chain.erase(chain.begin(), chain.begin() + numOpen);
+        unsigned int numCommon = 0;
+        while (numCommon < openScopes.size() && numCommon < chain.size() &&
+               openScopes[numCommon] == chain[numCommon]) {
+            numCommon++;
+        }
+        while (openScopes.size() > numCommon) {
+            os << indent(depth + openScopes.size() - 1) << "}\n";
+            if (openScopes.back() == parallelLoop) {
+                parallelLoop = nullptr;
+            }
+            openScopes.pop_back();
+        }
+
+        bool isWritten = false;
+        for (unsigned int j = numCommon; j < chain.size() && !isWritten;
+             ++j) {
+            const TiledBand* band =
+                mode == StmtMode::Source ? getTiledBand(chain[j]) : nullptr;
+            if (band || (isParallel && !parallelLoop &&
+                         getLevelSetArrays(chain[j], levelSetArrays))) {
+                // the loop is written whole, along with everything in it
+                std::vector<unsigned int> inner;
+                std::vector<unsigned int> all = getStmtsIn(chain[j]);
+                for (; i < stmts.size() && std::find(all.begin(), all.end(),
+                                                     stmts[i]) != all.end();
+                     ++i) {
+                    inner.push_back(stmts[i]);
+                }
+                if (band) {
+                    writeTiledBand(*band, inner, numOpen + j,
+                                   depth + openScopes.size(), isParallel, os);
+                } else {
+                    writeLevelSets(chain[j], inner, numOpen + j,
+                                   depth + openScopes.size(), os);
+                    levelSetArrays.clear();
+                }
+                isWritten = true;
+            } else {
+                openScope(chain[j], depth + openScopes.size(), isParallel,
+                          os);
+                openScopes.push_back(chain[j]);
+            }
+        }
+        if (!isWritten) {
+            writeStmt(stmts[i], depth + openScopes.size(), mode, os);
+            ++i;
+        }
+    }
+    while (!openScopes.empty()) {
+        os << indent(depth + openScopes.size() - 1) << "}\n";
+        if (openScopes.back() == parallelLoop) {
+            parallelLoop = nullptr;
+        }
+        openScopes.pop_back();
+    }
+}
+
+void CodeGenerator::writeStmt(unsigned int stmtIndex, unsigned int depth,
+                              StmtMode mode, std::ostream& os) {
+    const StmtContext& stmtContext = stmtContexts[stmtIndex];
+    if (mode == StmtMode::Source) {
+        llvm::StringRef stmtText =
+            llvm::StringRef(session.getSourceText(stmtContext.stmt)).rtrim();
+        stmtText.consume_back(";");
+        os << indent(depth) << stmtText.rtrim().str() << ";\n";
+        return;
+    }
+
+    // locate each access to a replayed array; reads and writes are kept
+    // apart and in a fixed order, so repeated accesses are checked once
+    std::vector<std::pair<std::string, std::string>> reads;
+    std::vector<std::pair<std::string, std::string>> writes;
+    for (const auto& it : stmtContext.dataAccesses.arrayAccesses) {
+        const ArrayAccess& access = it.second;
+        std::string name = session.getSPFString(access.base);
+        auto array = std::find_if(levelSetArrays.begin(), levelSetArrays.end(),
+                                  [&name](const LevelSetArray& candidate) {
+                                      return candidate.name == name;
+                                  });
+        if (array == levelSetArrays.end()) {
+            continue;
+        }
+        // row-major offset of the element
+        std::string offset = session.getSourceText(access.indexes[0]);
+        for (unsigned int dim = 1; dim < access.indexes.size(); ++dim) {
+            offset = "(" + offset + ") * (" + array->extents[dim] + ") + (" +
+                     session.getSourceText(access.indexes[dim]) + ")";
+        }
+        (access.isRead ? reads : writes).emplace_back(name, offset);
+    }
+    for (auto* accesses : {&reads, &writes}) {
+        std::sort(accesses->begin(), accesses->end());
+        accesses->erase(std::unique(accesses->begin(), accesses->end()),
+                        accesses->end());
+    }
+    // writing an element orders the iteration after its readers as well as
+    // its writers, so a read of the same element adds nothing
+    reads.erase(std::remove_if(reads.begin(), reads.end(),
+                               [&writes](const std::pair<std::string,
+                                                         std::string>& read) {
+                                   return std::binary_search(
+                                       writes.begin(), writes.end(), read);
+                               }),
+                reads.end());
+
+    // tables hold one more than the latest level to read or write each
+    // element, so that 0 means untouched
+    if (mode == StmtMode::CheckAccesses) {
+        for (const auto& access : reads) {
+            std::string written =
+                "ls_" + access.first + "_written[" + access.second + "]";
+            os << indent(depth) << "ls_l = " << written << " > ls_l ? "
+               << written << " : ls_l;\n";
+        }
+        for (const auto& access : writes) {
+            for (const char* table : {"_written[", "_read["}) {
+                std::string entry =
+                    "ls_" + access.first + table + access.second + "]";
+                os << indent(depth) << "ls_l = " << entry << " > ls_l ? "
+                   << entry << " : ls_l;\n";
+            }
+        }
+    } else {
+        for (const auto& access : reads) {
+            std::string read =
+                "ls_" + access.first + "_read[" + access.second + "]";
+            os << indent(depth) << read << " = " << read << " > ls_l ? "
+               << read << " : ls_l + 1;\n";
+        }
+        for (const auto& access : writes) {
+            os << indent(depth) << "ls_" << access.first << "_written["
+               << access.second << "] = ls_l + 1;\n";
+        }
+    }
+}
+
+void CodeGenerator::openScope(const Scope* scope, unsigned int depth,
+                              bool isParallel, std::ostream& os) {
+    if (scope->kind == Scope::Kind::Guard) {
+        os << indent(depth) << "if (" << toC(scope->constraints[0])
+           << ") {\n";
+        return;
+    }
+
+    if (isParallel) {
+        // OpenMP makes the iterator of a parallel loop private itself
+        writeParallelPragma(scope, depth, true, os);
+    }
+    writeLoopHeader(scope, depth, os);
+}
+
+void CodeGenerator::writeParallelPragma(const Scope* loop, unsigned int depth,
+                                        bool isIteratorPrivate,
+                                        std::ostream& os) {
+    ForStmt* forStmt = cast<ForStmt>(loop->origin);
+    if (parallelLoop || !dependences.isParallelizable(forStmt)) {
+        return;
+    }
+    os << indent(depth) << "#pragma omp parallel for";
+    std::vector<std::string> privates;
+    if (!isIteratorPrivate) {
+        privates.push_back(loop->iterator);
+    }
+    for (const auto& iterator : getSharedInnerIterators(loop)) {
+        privates.push_back(iterator);
+    }
+    if (!privates.empty()) {
+        os << " private(";
+        for (unsigned int i = 0; i < privates.size(); ++i) {
+            os << (i == 0 ? "" : ", ") << privates[i];
+        }
+        os << ")";
+    }
+    for (const Reduction* reduction : dependences.getReductions(forStmt)) {
+        os << " " << toReductionClause(*reduction);
+    }
+    os << "\n";
+    parallelLoop = loop;
+}
+
+void CodeGenerator::writeLoopHeader(const Scope* loop, unsigned int depth,
+                                    std::ostream& os) {
+    // a loop's constraints are its lower bound, "init <= iterator", followed
+    // by its condition
+    ForStmt* forStmt = cast<ForStmt>(loop->origin);
+    os << indent(depth) << "for (";
+    if (isa<DeclStmt>(forStmt->getInit())) {
+        os << getIteratorType(forStmt) << " ";
+    }
+    os << loop->iterator << " = " << toC(loop->constraints[0].lhs) << "; "
+       << toC(loop->constraints[1]) << "; " << loop->iterator << "++) {\n";
+}
+
+bool CodeGenerator::getLevelSetArrays(
+    const Scope* loop, std::vector<LevelSetArray>& arrays) const {
+    if (target != Target::COpenMPLevelSets ||
+        loop->kind != Scope::Kind::Loop) {
+        return false;
+    }
+    for (const Scope* outer = loop->parent.get(); outer;
+         outer = outer->parent.get()) {
+        if (outer->kind == Scope::Kind::Loop) {
+            return false;
+        }
+    }
+    ForStmt* forStmt = cast<ForStmt>(loop->origin);
+    if (dependences.isParallelizable(forStmt)) {
+        return false;
+    }
+
+    // only the data spaces carrying dependences need replaying
+    std::unordered_set<std::string> carried;
+    for (const auto& dependence : dependences.getDependences()) {
+        if (dependence.loop == forStmt) {
+            carried.insert(dependence.dataSpace);
+        }
+    }
+    std::vector<unsigned int> stmts = getStmtsIn(loop);
+    std::unordered_set<std::string> written;
+    for (unsigned int stmtIndex : stmts) {
+        for (const auto& it :
+             stmtContexts[stmtIndex].dataAccesses.arrayAccesses) {
+            if (!it.second.isRead) {
+                written.insert(session.getSPFString(it.second.base));
+            }
+        }
+    }
+
+    // the inspector evaluates the guards and loop bounds around each
+    // statement before the loop runs, so they may only read arrays the loop
+    // does not write either
+    for (unsigned int stmtIndex : stmts) {
+        std::vector<std::string> iterators =
+            stmtContexts[stmtIndex].getIterators();
+        for (const Scope* scope = stmtContexts[stmtIndex].scope.get();
+             scope != loop->parent.get(); scope = scope->parent.get()) {
+            for (Expr* expr : getScopeExprs(scope)) {
+                if (!isInspectable(expr, iterators, written, session)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    arrays.clear();
+    for (unsigned int stmtIndex : stmts) {
+        std::vector<std::string> iterators =
+            stmtContexts[stmtIndex].getIterators();
+        for (const auto& it :
+             stmtContexts[stmtIndex].dataAccesses.arrayAccesses) {
+            const ArrayAccess& access = it.second;
+            std::string name = session.getSPFString(access.base);
+            if (!carried.count(name)) {
+                continue;
+            }
+            auto array = std::find_if(arrays.begin(), arrays.end(),
+                                      [&name](const LevelSetArray& candidate) {
+                                          return candidate.name == name;
+                                      });
+            if (array == arrays.end()) {
+                // the tables are sized from the array's declared extents
+                LevelSetArray newArray;
+                newArray.name = name;
+                if (!DataAccessHandler::getArrayExtents(access.base, session,
+                                                        newArray.extents) ||
+                    std::find(newArray.extents.begin(), newArray.extents.end(),
+                              "") != newArray.extents.end()) {
+                    return false;
+                }
+                arrays.push_back(newArray);
+                array = arrays.end() - 1;
+            }
+            if (access.indexes.size() != array->extents.size()) {
+                return false;
+            }
+            for (Expr* index : access.indexes) {
+                if (!isInspectable(index, iterators, written, session)) {
+                    return false;
+                }
+            }
+        }
+    }
+    // scalars carrying dependences are not replayed, and would order every
+    // iteration after the last anyway
+    return arrays.size() == carried.size();
+}
+
+void CodeGenerator::writeLevelSets(const Scope* loop,
+                                   const std::vector<unsigned int>& stmts,
+                                   unsigned int numOpen, unsigned int depth,
+                                   std::ostream& os) {
+    ForStmt* forStmt = cast<ForStmt>(loop->origin);
+    std::string iteratorType = getIteratorType(forStmt);
+    std::string in = indent(depth + 1);
+    std::string in2 = indent(depth + 2);
+
+    // a block of its own keeps the inspector's variables apart from any
+    // other loop's
+    os << indent(depth) << "{\n";
+    os << in << "/* inspector: each iteration over " << loop->iterator
+       << " goes one level after those it depends on */\n";
+    os << in << "int ls_count = 0;\n";
+    writeLoopHeader(loop, depth + 1, os);
+    os << in2 << "ls_count++;\n" << in << "}\n";
+    os << in << "int* ls_level = (int*)malloc((ls_count + 1) * sizeof(int));\n";
+    for (const auto& array : levelSetArrays) {
+        std::string size = "(size_t)(" + array.extents[0] + ")";
+        for (unsigned int dim = 1; dim < array.extents.size(); ++dim) {
+            size += " * (" + array.extents[dim] + ")";
+        }
+        for (const char* table : {"_read", "_written"}) {
+            os << in << "int* ls_" << array.name << table
+               << " = (int*)calloc(" << size << ", sizeof(int));\n";
+        }
+    }
+    os << in << "int ls_num_levels = 0;\n";
+    os << in << "int ls_t = 0;\n";
+    writeLoopHeader(loop, depth + 1, os);
+    os << in2 << "int ls_l = 0;\n";
+    // only statements touching the replayed arrays need replaying
+    std::vector<unsigned int> replayed;
+    for (unsigned int stmtIndex : stmts) {
+        for (const auto& it :
+             stmtContexts[stmtIndex].dataAccesses.arrayAccesses) {
+            std::string name = session.getSPFString(it.second.base);
+            if (std::any_of(levelSetArrays.begin(), levelSetArrays.end(),
+                            [&name](const LevelSetArray& array) {
+                                return array.name == name;
+                            })) {
+                replayed.push_back(stmtIndex);
+                break;
+            }
+        }
+    }
+    writeStmts(replayed, numOpen + 1, depth + 2, StmtMode::CheckAccesses,
+               false, os);
+    writeStmts(replayed, numOpen + 1, depth + 2, StmtMode::RecordAccesses,
+               false, os);
+    os << in2 << "ls_level[ls_t++] = ls_l;\n";
+    os << in2 << "if (ls_l >= ls_num_levels) {\n"
+       << indent(depth + 3) << "ls_num_levels = ls_l + 1;\n"
+       << in2 << "}\n";
+    os << in << "}\n";
+    for (const auto& array : levelSetArrays) {
+        os << in << "free(ls_" << array.name << "_read);\n";
+        os << in << "free(ls_" << array.name << "_written);\n";
+    }
+
+    // bucket the iterations by level, keeping their order within each
+    os << in << "int* ls_start = (int*)calloc(ls_num_levels + 1, "
+       << "sizeof(int));\n";
+    os << in << "for (ls_t = 0; ls_t < ls_count; ls_t++) {\n"
+       << in2 << "ls_start[ls_level[ls_t] + 1]++;\n" << in << "}\n";
+    os << in << "for (int ls_l = 0; ls_l < ls_num_levels; ls_l++) {\n"
+       << in2 << "ls_start[ls_l + 1] += ls_start[ls_l];\n" << in << "}\n";
+    os << in << "int* ls_next = (int*)malloc((ls_num_levels + 1) * "
+       << "sizeof(int));\n";
+    os << in << "for (int ls_l = 0; ls_l < ls_num_levels; ls_l++) {\n"
+       << in2 << "ls_next[ls_l] = ls_start[ls_l];\n" << in << "}\n";
+    os << in << iteratorType << "* ls_order = (" << iteratorType
+       << "*)malloc((ls_count + 1) * sizeof(" << iteratorType << "));\n";
+    os << in << "ls_t = 0;\n";
+    writeLoopHeader(loop, depth + 1, os);
+    os << in2 << "ls_order[ls_next[ls_level[ls_t++]]++] = " << loop->iterator
+       << ";\n";
+    os << in << "}\n";
+    os << in << "free(ls_next);\n" << in << "free(ls_level);\n";
+
+    // executor
+    os << in << "/* executor: levels in order, the iterations of each in "
+       << "parallel */\n";
+    os << in << "for (int ls_l = 0; ls_l < ls_num_levels; ls_l++) {\n";
+    std::vector<std::string> privates;
+    bool isDeclared = isa<DeclStmt>(forStmt->getInit());
+    if (!isDeclared) {
+        privates.push_back(loop->iterator);
+    }
+    for (const auto& iterator : getSharedInnerIterators(loop)) {
+        privates.push_back(iterator);
+    }
+    os << in2 << "#pragma omp parallel for";
+    if (!privates.empty()) {
+        os << " private(";
+        for (unsigned int i = 0; i < privates.size(); ++i) {
+            os << (i == 0 ? "" : ", ") << privates[i];
+        }
+        os << ")";
+    }
+    os << "\n";
+    os << in2 << "for (int ls_k = ls_start[ls_l]; ls_k < ls_start[ls_l + 1]; "
+       << "ls_k++) {\n";
+    os << indent(depth + 3) << (isDeclared ? iteratorType + " " : "")
+       << loop->iterator << " = ls_order[ls_k];\n";
+    const Scope* previousParallelLoop = parallelLoop;
+    parallelLoop = loop;
+    writeStmts(stmts, numOpen + 1, depth + 3, StmtMode::Source, false, os);
+    parallelLoop = previousParallelLoop;
+    os << in2 << "}\n" << in << "}\n";
+    os << in << "free(ls_start);\n" << in << "free(ls_order);\n";
+    os << indent(depth) << "}\n";
+}
+
+const TiledBand* CodeGenerator::getTiledBand(const Scope* loop) const {
+    for (const auto& band : tiledBands) {
+        if (band.loops.front() == loop) {
+            return &band;
+        }
+    }
+    return nullptr;
+}
+
+void CodeGenerator::writeTiledBand(const TiledBand& band,
+                                   const std::vector<unsigned int>& stmts,
+                                   unsigned int numOpen, unsigned int depth,
+                                   bool isParallel, std::ostream& os) {
+    unsigned int numLoops = band.loops.size();
+    // number of the band's loops enclosing each statement
+    std::vector<unsigned int> depthsIn;
+    for (unsigned int stmtIndex : stmts) {
+        std::vector<const Scope*> chain =
+            getScopeChain(stmtContexts[stmtIndex].scope.get());
+        depthsIn.push_back(std::count_if(
+            chain.begin(), chain.end(), [&band](const Scope* scope) {
+                return std::find(band.loops.begin(), band.loops.end(),
+                                 scope) != band.loops.end();
+            }));
+    }
+
+    // loops over the tiles, each starting where its loop does
+    for (unsigned int i = 0; i < numLoops; ++i) {
+        const Scope* loop = band.loops[i];
+        ForStmt* forStmt = cast<ForStmt>(loop->origin);
+        std::string tile = band.getTileIterator(i);
+        std::string lower = toC(loop->constraints[0].lhs);
+        if (i == 0 && isParallel) {
+            writeParallelPragma(loop, depth, isa<DeclStmt>(forStmt->getInit()),
+                                os);
+        }
+        os << indent(depth + i) << "for (" << getIteratorType(forStmt) << " "
+           << tile << " = " << lower << "; "
+           << toC(renameIterator(loop->constraints[1], loop->iterator, tile));
+        // statements ahead of the loop run in its first tile, which must be
+        // visited even when the loop has no iterations
+        if (std::any_of(depthsIn.begin(), depthsIn.end(),
+                        [i](unsigned int depthIn) { return depthIn <= i; })) {
+            os << " || " << tile << " == " << lower;
+        }
+        os << "; " << tile << " += " << band.sizes[i] << ") {\n";
+    }
+
+    // loops over the iterations of a tile, stopping at the tile's end or
+    // the loop's, whichever comes first
+    unsigned int pointDepth = depth + numLoops;
+    for (unsigned int i = 0; i < numLoops; ++i) {
+        const Scope* loop = band.loops[i];
+        ForStmt* forStmt = cast<ForStmt>(loop->origin);
+        std::string tile = band.getTileIterator(i);
+        os << indent(pointDepth + i) << "for (";
+        if (isa<DeclStmt>(forStmt->getInit())) {
+            os << getIteratorType(forStmt) << " ";
+        }
+        os << loop->iterator << " = " << tile << "; " << loop->iterator
+           << " < " << tile << " + " << band.sizes[i] << " && "
+           << toC(loop->constraints[1]) << "; " << loop->iterator
+           << "++) {\n";
+
+        std::vector<unsigned int> body;
+        for (unsigned int j = 0; j < stmts.size(); ++j) {
+            if (depthsIn[j] == i + 1) {
+                body.push_back(stmts[j]);
+            }
+        }
+        if (body.empty()) {
+            continue;
+        }
+        if (i + 1 == numLoops) {
+            writeStmts(body, numOpen + numLoops, pointDepth + numLoops,
+                       StmtMode::Source, isParallel, os);
+            continue;
+        }
+        // statements ahead of the next loop run in the first tile of each
+        // loop after this one
+        os << indent(pointDepth + i + 1) << "if (";
+        for (unsigned int j = i + 1; j < numLoops; ++j) {
+            os << (j == i + 1 ? "" : " && ") << band.getTileIterator(j)
+               << " == " << toC(band.loops[j]->constraints[0].lhs);
+        }
+        os << ") {\n";
+        writeStmts(body, numOpen + i + 1, pointDepth + i + 2, StmtMode::Source,
+                   isParallel, os);
+        os << indent(pointDepth + i + 1) << "}\n";
+    }
+
+    for (unsigned int i = 2 * numLoops; i-- > 0;) {
+        os << indent(depth + i) << "}\n";
+    }
+    if (parallelLoop == band.loops.front()) {
+        parallelLoop = nullptr;
+    }
+}
+
+std::vector<unsigned int> CodeGenerator::getStmtsIn(const Scope* scope) const {
+    std::vector<unsigned int> stmts;
+    for (unsigned int i = 0; i < stmtContexts.size(); ++i) {
+        for (const Scope* enclosing = stmtContexts[i].scope.get(); enclosing;
+             enclosing = enclosing->parent.get()) {
+            if (enclosing == scope) {
+                stmts.push_back(i);
+                break;
+            }
+        }
+    }
+    return stmts;
+}
+
+bool CodeGenerator::isInspectable(
+    Expr* expr, const std::vector<std::string>& iterators,
+    const std::unordered_set<std::string>& written, BuilderSession& session) {
+    expr = expr->IgnoreParenImpCasts();
+    if (isa<IntegerLiteral>(expr)) {
+        return true;
+    }
+    if (DeclRefExpr* asDeclRef = dyn_cast<DeclRefExpr>(expr)) {
+        ValueDecl* decl = asDeclRef->getDecl();
+        return isa<ParmVarDecl>(decl) || isa<EnumConstantDecl>(decl) ||
+               std::find(iterators.begin(), iterators.end(),
+                         decl->getNameAsString()) != iterators.end();
+    }
+    if (ArraySubscriptExpr* asArrayAccess =
+            dyn_cast<ArraySubscriptExpr>(expr)) {
+        Expr* base = asArrayAccess->getBase();
+        return !written.count(session.getSPFString(base)) &&
+               isInspectable(base, iterators, written, session) &&
+               isInspectable(asArrayAccess->getIdx(), iterators, written,
+                             session);
+    }
+    if (BinaryOperator* asBinOper = dyn_cast<BinaryOperator>(expr)) {
+        return !asBinOper->isAssignmentOp() &&
+               isInspectable(asBinOper->getLHS(), iterators, written,
+                             session) &&
+               isInspectable(asBinOper->getRHS(), iterators, written, session);
+    }
+    if (UnaryOperator* asUnOper = dyn_cast<UnaryOperator>(expr)) {
+        return !asUnOper->isIncrementDecrementOp() &&
+               isInspectable(asUnOper->getSubExpr(), iterators, written,
+                             session);
+    }
+    return false;
+}
+
+std::vector<Expr*> CodeGenerator::getScopeExprs(const Scope* scope) {
+    if (scope->kind == Scope::Kind::Guard) {
+        return {cast<IfStmt>(scope->origin)->getCond()};
+    }
+    ForStmt* forStmt = cast<ForStmt>(scope->origin);
+    std::vector<Expr*> exprs;
+    if (BinaryOperator* init = dyn_cast<BinaryOperator>(forStmt->getInit())) {
+        exprs.push_back(init->getRHS());
+    } else if (DeclStmt* init = dyn_cast<DeclStmt>(forStmt->getInit())) {
+        exprs.push_back(cast<VarDecl>(init->getSingleDecl())->getInit());
+    }
+    exprs.push_back(forStmt->getCond());
+    return exprs;
+}
+
+std::string CodeGenerator::toReductionClause(const Reduction& reduction) {
+    // partial results of -= are combined by adding them, as with +=
+    std::string oper =
+        reduction.oper == BO_SubAssign
+            ? "+"
+            : BinaryOperator::getOpcodeStr(reduction.oper).drop_back().str();
+    // array elements are reduced as single-element array sections
+    std::ostringstream os;
+    os << "reduction(" << oper << ":" << reduction.dataSpace;
+    for (const auto& subscript : reduction.subscripts) {
+        os << "[" << toC(subscript) << ":1]";
+    }
+    os << ")";
+    return os.str();
+}
+
+std::vector<std::string> CodeGenerator::getSharedInnerIterators(
+    const Scope* loop) const {
+    std::vector<std::string> iterators;
+    for (const auto& stmtContext : stmtContexts) {
+        std::vector<const Scope*> chain =
+            getScopeChain(stmtContext.scope.get());
+        auto it = std::find(chain.begin(), chain.end(), loop);
+        if (it == chain.end()) {
+            continue;
+        }
+        for (++it; it != chain.end(); ++it) {
+            const Scope* inner = *it;
+            if (inner->kind == Scope::Kind::Loop &&
+                !isa<DeclStmt>(cast<ForStmt>(inner->origin)->getInit()) &&
+                std::find(iterators.begin(), iterators.end(),
+                          inner->iterator) == iterators.end()) {
+                iterators.push_back(inner->iterator);
+            }
+        }
+    }
+    return iterators;
+}
+
+std::vector<const Scope*> CodeGenerator::getScopeChain(const Scope* scope) {
+    std::vector<const Scope*> chain;
+    for (; scope; scope = scope->parent.get()) {
+        chain.push_back(scope);
+    }
+    std::reverse(chain.begin(), chain.end());
+    return chain;
+}
+
+std::string CodeGenerator::getIteratorType(ForStmt* forStmt) {
+    if (DeclStmt* init = dyn_cast<DeclStmt>(forStmt->getInit())) {
+        return cast<VarDecl>(init->getSingleDecl())->getType().getAsString();
+    }
+    return cast<BinaryOperator>(forStmt->getInit())
+        ->getLHS()
+        ->getType()
+        .getAsString();
+}
+
+std::string CodeGenerator::indent(unsigned int depth) {
+    return std::string(4 * depth, ' ');
+}
+
+}  // namespace spf_ie
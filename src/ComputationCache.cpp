@@ -0,0 +1,106 @@
+#include "ComputationCache.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "ComputationSerializer.hpp"
+#include "Utils.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/Lexer.h"
+#include "iegenlib.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/* ComputationCache */
+
+ComputationCache::ComputationCache(std::string directory)
+    : directory(directory), hits(0), misses(0) {
+    llvm::sys::fs::create_directories(directory);
+}
+
+std::string ComputationCache::computeKey(FunctionDecl* funcDecl,
+                                         const ASTContext& Ctx,
+                                         llvm::StringRef flags) {
+    llvm::StringRef source;
+    {
+        std::lock_guard<std::mutex> lock(Utils::sourceManagerMutex);
+        source = Lexer::getSourceText(
+            CharSourceRange::getTokenRange(funcDecl->getSourceRange()),
+            Ctx.getSourceManager(), Ctx.getLangOpts());
+    }
+
+    // separate components with NUL so that their boundaries are unambiguous
+    llvm::MD5 hash;
+    hash.update(SPFIE_BUILDER_VERSION);
+    hash.update(llvm::StringRef("\0", 1));
+    hash.update(flags);
+    hash.update(llvm::StringRef("\0", 1));
+    hash.update(source);
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    return std::string(result.digest().str());
+}
+
+std::unique_ptr<iegenlib::Computation> ComputationCache::lookup(
+    const std::string& key) {
+    auto buffer = llvm::MemoryBuffer::getFile(getEntryPath(key));
+    if (buffer) {
+        llvm::StringRef data = (*buffer)->getBuffer();
+        std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+        std::unique_ptr<iegenlib::Computation> computation =
+            ComputationSerializer::read(data);
+        if (computation) {
+            hits++;
+            return computation;
+        }
+    }
+    misses++;
+    return nullptr;
+}
+
+void ComputationCache::store(const std::string& key,
+                             iegenlib::Computation* computation) {
+    std::string record;
+    {
+        llvm::raw_string_ostream os(record);
+        std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+        ComputationSerializer::write(computation, os);
+    }
+
+    // write to a temporary file and rename it into place, so that readers
+    // never see a partial entry
+    std::string entryPath = getEntryPath(key);
+    int fd;
+    llvm::SmallString<128> tempPath;
+    if (llvm::sys::fs::createUniqueFile(entryPath + ".tmp-%%%%%%%%", fd,
+                                        tempPath)) {
+        return;
+    }
+    {
+        llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+        os << record;
+    }
+    if (llvm::sys::fs::rename(tempPath, entryPath)) {
+        llvm::sys::fs::remove(tempPath);
+    }
+}
+
+std::string ComputationCache::getEntryPath(const std::string& key) const {
+    llvm::SmallString<128> path(directory);
+    llvm::sys::path::append(path, key + ".spfc");
+    return std::string(path.str());
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,140 @@
+#include "ComputationEmitter.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "ComputationSerializer.hpp"
+#include "Utils.hpp"
+#include "iegenlib.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace spf_ie {
+
+/* ComputationEmitter */
+
+std::unique_ptr<ComputationEmitter> ComputationEmitter::create(
+    Format format, llvm::StringRef path, std::string& error) {
+    std::error_code EC;
+    auto os = std::make_unique<llvm::raw_fd_ostream>(
+        path, EC,
+        format == Format::Binary ? llvm::sys::fs::OF_None
+                                 : llvm::sys::fs::OF_Text);
+    if (EC) {
+        error = EC.message();
+        return nullptr;
+    }
+    if (format == Format::Binary) {
+        *os << EMIT_FILE_MAGIC;
+        ComputationSerializer::writeInt(*os, SPFIE_EMIT_FORMAT_VERSION);
+    }
+    return std::unique_ptr<ComputationEmitter>(
+        new ComputationEmitter(format, std::move(os)));
+}
+
+std::string ComputationEmitter::render(llvm::StringRef fileName,
+                                       llvm::StringRef functionName,
+                                       iegenlib::Computation* computation) {
+    std::string entry;
+    llvm::raw_string_ostream entryStream(entry);
+    std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+    if (format == Format::JSONLines) {
+        writeJSONLine(entryStream, fileName, functionName, computation);
+    } else {
+        writeBinaryEntry(entryStream, fileName, functionName, computation);
+    }
+    entryStream.flush();
+    return entry;
+}
+
+void ComputationEmitter::write(llvm::StringRef entry) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    *os << entry;
+}
+
+bool ComputationEmitter::ok() {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    os->flush();
+    return !os->has_error();
+}
+
+void ComputationEmitter::writeJSON(llvm::json::OStream& J,
+                                   llvm::StringRef fileName,
+                                   llvm::StringRef functionName,
+                                   iegenlib::Computation* computation) {
+    auto dataSpaceSet = computation->getDataSpaces();
+    std::vector<std::string> dataSpaces(dataSpaceSet.begin(),
+                                        dataSpaceSet.end());
+    std::sort(dataSpaces.begin(), dataSpaces.end());
+
+    J.object([&] {
+        J.attribute("file", fileName);
+        J.attribute("function", functionName);
+        J.attributeArray("dataSpaces", [&] {
+            for (const auto& dataSpace : dataSpaces) {
+                J.value(dataSpace);
+            }
+        });
+        J.attributeArray("stmts", [&] {
+            for (int i = 0; i < computation->getNumStmts(); ++i) {
+                iegenlib::Stmt* stmt = computation->getStmt(i);
+                J.object([&] {
+                    J.attribute("source", stmt->getStmtSourceCode());
+                    J.attribute(
+                        "iterationSpace",
+                        stmt->getIterationSpace()->prettyPrintString());
+                    J.attribute(
+                        "executionSchedule",
+                        stmt->getExecutionSchedule()->prettyPrintString());
+                    auto writeAccesses = [&](llvm::StringRef name,
+                                             const auto& accesses) {
+                        J.attributeArray(name, [&] {
+                            for (const auto& access : accesses) {
+                                J.object([&] {
+                                    J.attribute("dataSpace", access.first);
+                                    J.attribute(
+                                        "relation",
+                                        access.second->prettyPrintString());
+                                });
+                            }
+                        });
+                    };
+                    writeAccesses("reads", stmt->getDataReads());
+                    writeAccesses("writes", stmt->getDataWrites());
+                });
+            }
+        });
+    });
+}
+
+void ComputationEmitter::writeJSONLine(llvm::raw_ostream& os,
+                                       llvm::StringRef fileName,
+                                       llvm::StringRef functionName,
+                                       iegenlib::Computation* computation) {
+    {
+        llvm::json::OStream J(os);
+        writeJSON(J, fileName, functionName, computation);
+    }
+    os << "\n";
+}
+
+void ComputationEmitter::writeBinaryEntry(llvm::raw_ostream& os,
+                                          llvm::StringRef fileName,
+                                          llvm::StringRef functionName,
+                                          iegenlib::Computation* computation) {
+    llvm::SmallString<1024> record;
+    llvm::raw_svector_ostream recordStream(record);
+    ComputationSerializer::write(computation, recordStream);
+    ComputationSerializer::writeString(os, fileName);
+    ComputationSerializer::writeString(os, functionName);
+    ComputationSerializer::writeString(os, record);
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,144 @@
+#include "ComputationSerializer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "iegenlib.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/raw_ostream.h"
+
+//! Marker at the start of each serialized Computation
+#define RECORD_MAGIC "SPFC"
+
+namespace spf_ie {
+
+/* ComputationSerializer */
+
+void ComputationSerializer::write(iegenlib::Computation* computation,
+                                  llvm::raw_ostream& os) {
+    os << RECORD_MAGIC;
+    writeInt(os, SPFIE_SERIALIZED_FORMAT_VERSION);
+
+    // data spaces, sorted so that records are reproducible
+    auto dataSpaceSet = computation->getDataSpaces();
+    std::vector<std::string> dataSpaces(dataSpaceSet.begin(),
+                                        dataSpaceSet.end());
+    std::sort(dataSpaces.begin(), dataSpaces.end());
+    writeInt(os, dataSpaces.size());
+    for (const auto& dataSpace : dataSpaces) {
+        writeString(os, dataSpace);
+    }
+
+    // statements
+    writeInt(os, computation->getNumStmts());
+    for (int i = 0; i < computation->getNumStmts(); ++i) {
+        iegenlib::Stmt* stmt = computation->getStmt(i);
+        writeString(os, stmt->getStmtSourceCode());
+        writeString(os, stmt->getIterationSpace()->prettyPrintString());
+        writeString(os, stmt->getExecutionSchedule()->prettyPrintString());
+        for (const auto& accesses : {stmt->getDataReads(),
+                                     stmt->getDataWrites()}) {
+            writeInt(os, accesses.size());
+            for (const auto& access : accesses) {
+                writeString(os, access.first);
+                writeString(os, access.second->prettyPrintString());
+            }
+        }
+    }
+}
+
+std::unique_ptr<iegenlib::Computation> ComputationSerializer::read(
+    llvm::StringRef& data) {
+    uint32_t version;
+    if (!data.consume_front(RECORD_MAGIC) || !readInt(data, version) ||
+        version != SPFIE_SERIALIZED_FORMAT_VERSION) {
+        return nullptr;
+    }
+    auto computation = std::make_unique<iegenlib::Computation>();
+
+    uint32_t numDataSpaces;
+    if (!readInt(data, numDataSpaces)) {
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < numDataSpaces; ++i) {
+        std::string dataSpace;
+        if (!readString(data, dataSpace)) {
+            return nullptr;
+        }
+        computation->addDataSpace(dataSpace);
+    }
+
+    uint32_t numStmts;
+    if (!readInt(data, numStmts)) {
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < numStmts; ++i) {
+        std::string sourceCode;
+        std::string iterationSpace;
+        std::string executionSchedule;
+        if (!readString(data, sourceCode) ||
+            !readString(data, iterationSpace) ||
+            !readString(data, executionSchedule)) {
+            return nullptr;
+        }
+        std::vector<std::pair<std::string, std::string>> dataReads;
+        std::vector<std::pair<std::string, std::string>> dataWrites;
+        for (auto* accesses : {&dataReads, &dataWrites}) {
+            uint32_t numAccesses;
+            if (!readInt(data, numAccesses)) {
+                return nullptr;
+            }
+            for (uint32_t j = 0; j < numAccesses; ++j) {
+                std::string dataSpace;
+                std::string relation;
+                if (!readString(data, dataSpace) ||
+                    !readString(data, relation)) {
+                    return nullptr;
+                }
+                accesses->push_back(std::make_pair(dataSpace, relation));
+            }
+        }
+        computation->addStmt(iegenlib::Stmt(sourceCode, iterationSpace,
+                                            executionSchedule, dataReads,
+                                            dataWrites));
+    }
+    return computation;
+}
+
+void ComputationSerializer::writeString(llvm::raw_ostream& os,
+                                        llvm::StringRef str) {
+    writeInt(os, str.size());
+    os << str;
+}
+
+void ComputationSerializer::writeInt(llvm::raw_ostream& os, uint32_t value) {
+    llvm::support::endian::write<uint32_t>(os, value, llvm::support::little);
+}
+
+bool ComputationSerializer::readString(llvm::StringRef& data,
+                                       std::string& str) {
+    uint32_t length;
+    if (!readInt(data, length) || data.size() < length) {
+        return false;
+    }
+    str = data.take_front(length).str();
+    data = data.drop_front(length);
+    return true;
+}
+
+bool ComputationSerializer::readInt(llvm::StringRef& data, uint32_t& value) {
+    if (data.size() < sizeof(uint32_t)) {
+        return false;
+    }
+    value = llvm::support::endian::read32le(data.data());
+    data = data.drop_front(sizeof(uint32_t));
+    return true;
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,322 @@
+#include "ComputationServer.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ComputationEmitter.hpp"
+#include "SPFComputationBuilder.hpp"
+#include "Utils.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "iegenlib.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/* ComputationServer */
+
+ComputationServer::ComputationServer(
+    const tooling::CompilationDatabase& compilations, std::string resourceDir)
+    : compilations(compilations),
+      resourceDir(resourceDir),
+      pchContainerOps(std::make_shared<PCHContainerOperations>()),
+      requestNumber(0) {}
+
+void ComputationServer::serve(std::FILE* in, llvm::raw_ostream& out) {
+    char* line = nullptr;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, in)) != -1) {
+        llvm::StringRef request = llvm::StringRef(line, length).trim();
+        if (request.empty()) {
+            continue;
+        }
+        out << handleRequest(request) << "\n";
+        out.flush();
+    }
+    free(line);
+}
+
+int ComputationServer::serveUnixSocket(const std::string& path) {
+    sockaddr_un address;
+    if (path.size() >= sizeof(address.sun_path)) {
+        llvm::errs() << "Socket path is too long: " << path << "\n";
+        return 1;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int listenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+    // remove a stale socket left by a previous server
+    unlink(path.c_str());
+    if (listenFD < 0 ||
+        bind(listenFD, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        listen(listenFD, SOMAXCONN) != 0) {
+        llvm::errs() << "Could not listen on socket '" << path
+                     << "': " << std::strerror(errno) << "\n";
+        if (listenFD >= 0) {
+            close(listenFD);
+        }
+        return 1;
+    }
+    // a client disconnecting mid-response must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        int clientFD = accept(listenFD, nullptr, nullptr);
+        if (clientFD < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            llvm::errs() << "Could not accept connection: "
+                         << std::strerror(errno) << "\n";
+            break;
+        }
+        std::FILE* in = fdopen(clientFD, "r");
+        if (!in) {
+            close(clientFD);
+            continue;
+        }
+        llvm::raw_fd_ostream out(clientFD, /*shouldClose=*/false);
+        serve(in, out);
+        out.flush();
+        out.clear_error();
+        std::fclose(in);
+    }
+    close(listenFD);
+    unlink(path.c_str());
+    return 1;
+}
+
+std::string ComputationServer::handleRequest(llvm::StringRef request) {
+    requestNumber++;
+    std::string response;
+    llvm::raw_string_ostream os(response);
+    llvm::json::OStream J(os);
+
+    // parse the request
+    llvm::Expected<llvm::json::Value> parsed = llvm::json::parse(request);
+    if (!parsed) {
+        std::string message = llvm::toString(parsed.takeError());
+        J.object([&] {
+            J.attributeArray("errors", [&] {
+                J.object([&] {
+                    J.attribute("message", "Invalid request: " + message);
+                });
+            });
+        });
+        return os.str();
+    }
+    const llvm::json::Object* object = parsed->getAsObject();
+    llvm::json::Value id = nullptr;
+    llvm::Optional<llvm::StringRef> file;
+    llvm::Optional<llvm::StringRef> code;
+    llvm::Optional<llvm::StringRef> functionPattern;
+    if (object) {
+        if (const llvm::json::Value* idValue = object->get("id")) {
+            id = *idValue;
+        }
+        file = object->getString("file");
+        code = object->getString("code");
+        functionPattern = object->getString("function");
+    }
+
+    // build, collecting any errors
+    std::vector<std::pair<std::string, std::string>> errors;
+    std::vector<std::pair<std::string, std::unique_ptr<iegenlib::Computation>>>
+        computations;
+    std::string codeStr = code ? code->str() : "";
+    llvm::Regex functionFilter("^(" +
+                               (functionPattern ? functionPattern->str() : "") +
+                               ")$");
+    std::string regexError;
+    ASTUnit* unit = nullptr;
+    if (!file) {
+        errors.emplace_back("Request must be an object with a \"file\"", "");
+    } else if (functionPattern && !functionFilter.isValid(regexError)) {
+        errors.emplace_back("Invalid function regular expression: " +
+                                regexError,
+                            "");
+    } else {
+        std::string error;
+        unit = getUnit(file->str(), code ? &codeStr : nullptr, error);
+        if (!unit) {
+            errors.emplace_back(error, "");
+        } else if (unit->getDiagnostics().hasErrorOccurred()) {
+            for (auto it = unit->stored_diag_begin();
+                 it != unit->stored_diag_end(); ++it) {
+                if (it->getLevel() >= DiagnosticsEngine::Error) {
+                    errors.emplace_back(
+                        it->getMessage().str(),
+                        it->getLocation().isValid()
+                            ? it->getLocation().printToString(
+                                  unit->getSourceManager())
+                            : "");
+                }
+            }
+            unit = nullptr;
+        }
+    }
+    if (unit) {
+        // a bad function must never take the server down
+        SPFComputationBuilder builder(unit->getASTContext(),
+                                      /*recoverableErrors=*/true);
+        for (auto it = unit->top_level_begin(); it != unit->top_level_end();
+             ++it) {
+            // top-level declarations include those of the headers in the
+            // precompiled preamble
+            FunctionDecl* func = dyn_cast<FunctionDecl>(*it);
+            if (!func || !func->doesThisDeclarationHaveABody() ||
+                !unit->getSourceManager().isInMainFile(
+                    unit->getSourceManager().getExpansionLoc(
+                        func->getLocation()))) {
+                continue;
+            }
+            std::string funcName = func->getQualifiedNameAsString();
+            if (functionPattern && !functionFilter.match(funcName)) {
+                continue;
+            }
+            try {
+                computations.emplace_back(
+                    funcName, builder.buildComputationFromFunction(func));
+            } catch (const SPFError& error) {
+                SourceLocation loc = error.getLocation();
+                errors.emplace_back(
+                    funcName + ": " + error.what(),
+                    loc.isValid()
+                        ? loc.printToString(unit->getSourceManager())
+                        : "");
+            }
+        }
+    }
+
+    // respond
+    std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+    J.object([&] {
+        J.attribute("id", id);
+        J.attribute("file", file ? *file : "");
+        J.attributeArray("computations", [&] {
+            for (const auto& it : computations) {
+                ComputationEmitter::writeJSON(J, *file, it.first,
+                                              it.second.get());
+            }
+        });
+        J.attributeArray("errors", [&] {
+            for (const auto& it : errors) {
+                J.object([&] {
+                    J.attribute("message", it.first);
+                    if (!it.second.empty()) {
+                        J.attribute("location", it.second);
+                    }
+                });
+            }
+        });
+    });
+    computations.clear();
+    return os.str();
+}
+
+ASTUnit* ComputationServer::getUnit(const std::string& file,
+                                    const std::string* code,
+                                    std::string& error) {
+    std::vector<ASTUnit::RemappedFile> remappedFiles;
+    if (code) {
+        // ownership of the buffer passes to the unit
+        remappedFiles.emplace_back(
+            file, llvm::MemoryBuffer::getMemBufferCopy(*code, file).release());
+    }
+    std::vector<std::string> args = getCompileArgs(file);
+
+    auto cached = units.find(file);
+    if (cached != units.end() && cached->second.args == args) {
+        // reparse the main file, reusing the precompiled preamble
+        cached->second.lastUsed = requestNumber;
+        if (cached->second.unit->Reparse(pchContainerOps, remappedFiles)) {
+            units.erase(cached);
+            error = "Could not reparse '" + file + "'";
+            return nullptr;
+        }
+        return cached->second.unit.get();
+    }
+
+    std::vector<const char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(arg.c_str());
+    }
+    IntrusiveRefCntPtr<DiagnosticsEngine> diags =
+        CompilerInstance::createDiagnostics(new DiagnosticOptions(),
+                                            new IgnoringDiagConsumer());
+    std::unique_ptr<ASTUnit> unit(ASTUnit::LoadFromCommandLine(
+        argv.data(), argv.data() + argv.size(), pchContainerOps, diags,
+        resourceDir, /*OnlyLocalDecls=*/false, CaptureDiagsKind::All,
+        remappedFiles, /*RemappedFilesKeepOriginalName=*/true,
+        /*PrecompilePreambleAfterNParses=*/1));
+    if (!unit) {
+        error = "Could not parse '" + file + "'";
+        return nullptr;
+    }
+    ASTUnit* unitPtr = unit.get();
+    units[file] = {args, std::move(unit), requestNumber};
+    evictUnits();
+    return unitPtr;
+}
+
+std::vector<std::string> ComputationServer::getCompileArgs(
+    const std::string& file) {
+    std::vector<tooling::CompileCommand> commands =
+        compilations.getCompileCommands(file);
+    std::vector<std::string> args;
+    if (!commands.empty()) {
+        args = commands.front().CommandLine;
+        // relative paths in the command, including the file itself, are
+        // relative to the directory it was run in; let the file manager
+        // resolve them there instead of changing our own directory
+        if (!commands.front().Directory.empty()) {
+            args.insert(args.begin() + 1,
+                        {"-working-directory", commands.front().Directory});
+        }
+    } else {
+        args = {"clang", file};
+    }
+    args = tooling::getClangSyntaxOnlyAdjuster()(args, file);
+    return tooling::getClangStripOutputAdjuster()(args, file);
+}
+
+void ComputationServer::evictUnits() {
+    while (units.size() > MAX_CACHED_UNITS) {
+        auto oldest = units.begin();
+        for (auto it = units.begin(); it != units.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed) {
+                oldest = it;
+            }
+        }
+        units.erase(oldest);
+    }
+}
+
+}  // namespace spf_ie
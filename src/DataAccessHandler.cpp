@@ -6,9 +6,12 @@
 #include <utility>
 #include <vector>
 
-#include "Driver.hpp"
+#include "Instrumentation.hpp"
 #include "Utils.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
 #include "clang/AST/Expr.h"
+#include "clang/AST/Type.h"
 
 using namespace clang;
 
@@ -16,38 +19,45 @@ namespace spf_ie {
 
 /* DataAccessHandler */
 
-void DataAccessHandler::processAsReads(Expr* expr) {
+void DataAccessHandler::processAsReads(Expr* expr, BuilderSession& session) {
     std::vector<ArraySubscriptExpr*> reads;
     Utils::getExprArrayAccesses(expr, reads);
     for (const auto& read : reads) {
-        addDataAccess(read, true);
+        addDataAccess(read, true, session);
     }
 }
 
-void DataAccessHandler::processAsWrite(ArraySubscriptExpr* expr) {
-    addDataAccess(expr, false);
+void DataAccessHandler::processAsWrite(ArraySubscriptExpr* expr,
+                                       BuilderSession& session) {
+    addDataAccess(expr, false, session);
 }
 
 void DataAccessHandler::addDataAccess(ArraySubscriptExpr* fullExpr,
-                                      bool isRead) {
+                                      bool isRead, BuilderSession& session) {
     std::vector<std::pair<std::string, ArrayAccess>> accesses;
-    buildDataAccess(fullExpr, isRead, accesses);
+    buildDataAccess(fullExpr, isRead, accesses, session);
 
     for (const auto& accessInfo : accesses) {
-        dataSpaces.emplace(Utils::stmtToString(accessInfo.second.base));
+        std::string name = session.getSPFString(accessInfo.second.base);
+        if (!dataSpaces.count(name)) {
+            dataSpaces.emplace(name,
+                               makeDataSpace(accessInfo.second, session));
+        }
         arrayAccesses.push_back(accessInfo);
     }
+    Instrumentation::count(Instrumentation::Counter::Accesses, accesses.size());
 }
 
 void DataAccessHandler::buildDataAccess(
     ArraySubscriptExpr* fullExpr, bool isRead,
-    std::vector<std::pair<std::string, ArrayAccess>>& accessComponents) {
+    std::vector<std::pair<std::string, ArrayAccess>>& accessComponents,
+    BuilderSession& session) {
     // extract information from subscript expression
     std::stack<Expr*> info;
     if (getArrayExprInfo(fullExpr, &info)) {
-        Utils::printErrorAndExit("Array dimension exceeds maximum of " +
-                                     std::to_string(MAX_ARRAY_DIM),
-                                 fullExpr);
+        Utils::throwError("Array dimension exceeds maximum of " +
+                              std::to_string(MAX_ARRAY_DIM),
+                          fullExpr, session.getASTContext());
     }
 
     // construct ArrayAccess object
@@ -59,22 +69,23 @@ void DataAccessHandler::buildDataAccess(
         // sub-accesses are always reads
         if (ArraySubscriptExpr* indexAsArrayAccess =
                 dyn_cast<ArraySubscriptExpr>(info.top())) {
-            buildDataAccess(indexAsArrayAccess, true, accessComponents);
+            buildDataAccess(indexAsArrayAccess, true, accessComponents,
+                            session);
         }
         indexes.push_back(info.top());
         info.pop();
     }
-    ArrayAccess access =
-        ArrayAccess(fullExpr->getID(*Context), base, indexes, isRead);
-    accessComponents.push_back(
-        {makeStringForArrayAccess(&access, accessComponents), access});
+    ArrayAccess access = ArrayAccess(fullExpr->getID(session.getASTContext()),
+                                     base, indexes, isRead);
+    std::string accessString = makeStringForArrayAccess(&access, session);
+    session.setSPFString(fullExpr, accessString);
+    accessComponents.push_back({accessString, access});
 }
 
 std::string DataAccessHandler::makeStringForArrayAccess(
-    ArrayAccess* access,
-    const std::vector<std::pair<std::string, ArrayAccess>>& components) {
+    ArrayAccess* access, BuilderSession& session) {
     std::ostringstream os;
-    os << Utils::stmtToString(access->base);
+    os << session.getSPFString(access->base);
     os << "(";
     bool first = true;
     for (const auto& it : access->indexes) {
@@ -83,36 +94,84 @@ std::string DataAccessHandler::makeStringForArrayAccess(
         } else {
             first = false;
         }
-        std::string indexString;
-        if (ArraySubscriptExpr* asArrayAccess =
-                dyn_cast<ArraySubscriptExpr>(it->IgnoreParenImpCasts())) {
-            // there is another array acccess used as an index for this one;
-            // it should have already been processed (depth-first), so we look
-            // for its string equivalent in thealready-processed accesses
-            bool foundSubaccess = false;
-            for (const auto& it : components) {
-                if (it.second.id == asArrayAccess->getID(*Context)) {
-                    foundSubaccess = true;
-                    indexString = it.first;
-                    break;
-                }
-            }
-            if (!foundSubaccess) {
-                Utils::printErrorAndExit(
-                    "Could not stringify array access because its sub-access "
-                    "had (printed below) not already been processed.\nThis "
-                    "point should be unreachable -- this is a bug.",
-                    asArrayAccess);
-            }
-        } else {
-            indexString = Utils::stmtToString(it);
-        }
-        os << indexString;
+        // an index which is itself an array access has already been
+        // processed (depth-first), so its string is found in the session
+        os << session.getSPFString(it);
     }
     os << ")";
     return os.str();
 }
 
+DataSpace DataAccessHandler::makeDataSpace(const ArrayAccess& access,
+                                          BuilderSession& session) {
+    const ASTContext& Ctx = session.getASTContext();
+    DataSpace dataSpace;
+    // each subscript steps through one level of array or pointer
+    QualType type = access.base->getType();
+    for (unsigned int i = 0; i < access.indexes.size() && !type.isNull();
+         ++i) {
+        if (const ArrayType* arrayType = Ctx.getAsArrayType(type)) {
+            type = arrayType->getElementType();
+        } else {
+            type = type->getPointeeType();
+        }
+    }
+    if (type.isNull()) {
+        return dataSpace;
+    }
+    dataSpace.elementType =
+        type.getUnqualifiedType().getAsString(Ctx.getPrintingPolicy());
+    if (!type->isIncompleteType() && !type->isDependentType() &&
+        type->isConstantSizeType()) {
+        dataSpace.elementSize = Ctx.getTypeSizeInChars(type).getQuantity();
+    }
+    return dataSpace;
+}
+
+ArraySubscriptExpr* DataAccessHandler::getWrittenArrayAccess(Stmt* stmt) {
+    Expr* target = nullptr;
+    if (BinaryOperator* asBinOper = dyn_cast<BinaryOperator>(stmt)) {
+        target = asBinOper->getLHS();
+    } else if (UnaryOperator* asUnOper = dyn_cast<UnaryOperator>(stmt)) {
+        if (asUnOper->isIncrementDecrementOp()) {
+            target = asUnOper->getSubExpr();
+        }
+    }
+    return target ? dyn_cast<ArraySubscriptExpr>(target->IgnoreParens())
+                  : nullptr;
+}
+
+bool DataAccessHandler::getArrayExtents(Expr* base, BuilderSession& session,
+                                        std::vector<std::string>& extents) {
+    DeclRefExpr* baseRef = dyn_cast<DeclRefExpr>(base->IgnoreParenImpCasts());
+    VarDecl* var = baseRef ? dyn_cast<VarDecl>(baseRef->getDecl()) : nullptr;
+    if (!var) {
+        return false;
+    }
+    // an array parameter's type decays to a pointer, so take it as written
+    ParmVarDecl* param = dyn_cast<ParmVarDecl>(var);
+    QualType type = param ? param->getOriginalType() : var->getType();
+    const ASTContext& Ctx = session.getASTContext();
+    extents.clear();
+    while (const ArrayType* arrayType = Ctx.getAsArrayType(type)) {
+        if (const ConstantArrayType* asConstant =
+                dyn_cast<ConstantArrayType>(arrayType)) {
+            extents.push_back(
+                std::to_string(asConstant->getSize().getZExtValue()));
+        } else if (const VariableArrayType* asVariable =
+                       dyn_cast<VariableArrayType>(arrayType)) {
+            extents.push_back(
+                asVariable->getSizeExpr()
+                    ? session.getSourceText(asVariable->getSizeExpr())
+                    : "");
+        } else {
+            extents.push_back("");
+        }
+        type = arrayType->getElementType();
+    }
+    return !extents.empty();
+}
+
 int DataAccessHandler::getArrayExprInfo(ArraySubscriptExpr* fullExpr,
                                         std::stack<Expr*>* currentInfo) {
     if (currentInfo->size() >= MAX_ARRAY_DIM) {
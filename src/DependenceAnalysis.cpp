@@ -0,0 +1,791 @@
+#include "DependenceAnalysis.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "DataAccessHandler.hpp"
+#include "StmtContext.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "clang/Basic/Builtins.h"
+#include "llvm/ADT/STLExtras.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+//! Check whether an expression mentions any iterator, including within
+//! uninterpreted function arguments
+static bool hasIterators(const AffineExpr& expr) {
+    for (const auto& term : expr.getTerms()) {
+        if (term.kind == AffineTerm::Kind::Iterator) {
+            return true;
+        }
+        for (const auto& arg : term.args) {
+            if (hasIterators(*arg)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//! Check whether an expression mentions a particular iterator, including
+//! within uninterpreted function arguments
+static bool hasIterator(const AffineExpr& expr, unsigned int iteratorIndex) {
+    for (const auto& term : expr.getTerms()) {
+        if (term.kind == AffineTerm::Kind::Iterator &&
+            term.iteratorIndex == iteratorIndex) {
+            return true;
+        }
+        for (const auto& arg : term.args) {
+            if (hasIterator(*arg, iteratorIndex)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//! Check whether an expression mentions any of a set of symbols, including
+//! within uninterpreted function arguments
+static bool hasSymbol(const AffineExpr& expr,
+                      const std::set<std::string>& symbols) {
+    for (const auto& term : expr.getTerms()) {
+        if (term.kind == AffineTerm::Kind::Symbol &&
+            symbols.count(term.name)) {
+            return true;
+        }
+        for (const auto& arg : term.args) {
+            if (hasSymbol(*arg, symbols)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//! Check whether a (non-iterator) term cancels out against a term of
+//! another expression, having the same value in both the source and sink
+//! iterations
+//! \param[in] varying Scalars which may change between the two iterations
+static bool cancelsOut(const AffineTerm& term, const AffineExpr& other,
+                       const std::set<std::string>& varying) {
+    if (term.kind == AffineTerm::Kind::Symbol && varying.count(term.name)) {
+        return false;
+    }
+    if (term.kind == AffineTerm::Kind::UFCall) {
+        // a call on iterators, like col(k), need not have the same value for
+        // the source and sink iterations
+        for (const auto& arg : term.args) {
+            if (hasIterators(*arg) || hasSymbol(*arg, varying)) {
+                return false;
+            }
+        }
+    }
+    for (const auto& otherTerm : other.getTerms()) {
+        if (otherTerm.hasSameAtom(term) &&
+            otherTerm.coefficient == term.coefficient) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//! Get a tuple of names as a string, like "[i,j]"
+static std::string getTupleString(const std::vector<std::string>& names) {
+    std::ostringstream os;
+    os << "[";
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        if (i != 0) {
+            os << ",";
+        }
+        os << names[i];
+    }
+    os << "]";
+    return os.str();
+}
+
+/* Dependence */
+
+std::string Dependence::toString() const {
+    std::ostringstream os;
+    os << "S" << source << " -> S" << sink << ": " << kindToString(kind)
+       << " on " << dataSpace << ", ";
+    if (level == 0) {
+        os << "loop-independent";
+    } else {
+        os << "carried at level " << level;
+    }
+    if (!direction.empty()) {
+        os << " (";
+        for (unsigned int i = 0; i < direction.size(); ++i) {
+            if (i != 0) {
+                os << ",";
+            }
+            os << direction[i];
+        }
+        os << ")";
+    }
+    if (isReduction) {
+        os << ", reduction";
+    }
+    os << ": " << relation;
+    return os.str();
+}
+
+std::string Dependence::kindToString(Kind kind) {
+    switch (kind) {
+        case Kind::Flow:
+            return "flow";
+        case Kind::Anti:
+            return "anti";
+        case Kind::Output:
+            return "output";
+    }
+    return "";
+}
+
+/* Reduction */
+
+std::string Reduction::toString() const {
+    std::ostringstream os;
+    std::string oper = BinaryOperator::getOpcodeStr(this->oper).str();
+    oper.pop_back();
+    os << "S" << stmt << ": " << oper << " reduction into " << dataSpace;
+    if (!subscripts.empty()) {
+        os << "(";
+        for (unsigned int i = 0; i < subscripts.size(); ++i) {
+            os << (i == 0 ? "" : ",") << subscripts[i].toString();
+        }
+        os << ")";
+    }
+    os << " over level " << level;
+    return os.str();
+}
+
+/* DependenceGraph */
+
+void DependenceGraph::addDependence(const Dependence& dependence) {
+    for (auto& existing : dependences) {
+        if (existing.kind == dependence.kind &&
+            existing.source == dependence.source &&
+            existing.sink == dependence.sink &&
+            existing.dataSpace == dependence.dataSpace &&
+            existing.level == dependence.level) {
+            for (unsigned int i = 0; i < existing.direction.size(); ++i) {
+                if (existing.direction[i] != dependence.direction[i]) {
+                    existing.direction[i] = '*';
+                }
+            }
+            if (existing.relation != dependence.relation) {
+                existing.relation += " union " + dependence.relation;
+            }
+            return;
+        }
+    }
+    dependences.push_back(dependence);
+}
+
+std::vector<const Reduction*> DependenceGraph::getReductions(
+    const ForStmt* loop) const {
+    std::vector<const Reduction*> loopReductions;
+    for (const auto& reduction : reductions) {
+        if (reduction.loop == loop) {
+            loopReductions.push_back(&reduction);
+        }
+    }
+    return loopReductions;
+}
+
+bool DependenceGraph::isCarried(const ForStmt* loop) const {
+    return llvm::any_of(dependences, [loop](const Dependence& dependence) {
+        return dependence.loop == loop;
+    });
+}
+
+bool DependenceGraph::isParallelizable(const ForStmt* loop) const {
+    return llvm::none_of(dependences, [loop](const Dependence& dependence) {
+        return dependence.loop == loop && !dependence.isReduction;
+    });
+}
+
+std::string DependenceGraph::toString() const {
+    std::ostringstream os;
+    for (const auto& dependence : dependences) {
+        os << dependence.toString() << "\n";
+    }
+    for (const auto& reduction : reductions) {
+        os << reduction.toString() << "\n";
+    }
+    return os.str();
+}
+
+/* DependenceAnalysis */
+
+DependenceAnalysis::DependenceAnalysis(
+    const std::vector<StmtContext>& stmtContexts, BuilderSession& session)
+    : stmtContexts(stmtContexts), session(session) {
+    for (const auto& stmtContext : stmtContexts) {
+        iterators.push_back(stmtContext.getIterators());
+        sinkIterators.push_back(iterators.back());
+        for (auto& name : sinkIterators.back()) {
+            name += DEPENDENCE_SINK_SUFFIX;
+        }
+        loops.emplace_back();
+        for (const Scope* scope = stmtContext.scope.get(); scope;
+             scope = scope->parent.get()) {
+            if (scope->kind == Scope::Kind::Loop) {
+                loops.back().push_back(cast<ForStmt>(scope->origin));
+            }
+        }
+        std::reverse(loops.back().begin(), loops.back().end());
+    }
+}
+
+DependenceGraph DependenceAnalysis::analyze() {
+    unsigned int numStmts = stmtContexts.size();
+    accesses.clear();
+    accesses.resize(numStmts);
+    declDepths.clear();
+    for (unsigned int i = 0; i < numStmts; ++i) {
+        collectAccesses(i);
+    }
+
+    DependenceGraph graph(numStmts);
+    for (unsigned int i = 0; i < numStmts; ++i) {
+        findReductions(i, graph);
+    }
+    for (unsigned int source = 0; source < numStmts; ++source) {
+        for (unsigned int sink = 0; sink < numStmts; ++sink) {
+            unsigned int numCommonLoops = getNumCommonLoops(source, sink);
+            std::set<std::string> varying = getVaryingScalars(source, sink);
+            for (const auto& sourceAccess : accesses[source]) {
+                for (const auto& sinkAccess : accesses[sink]) {
+                    if (!mayConflict(sourceAccess, sinkAccess)) {
+                        continue;
+                    }
+                    std::vector<unsigned int> directions(numCommonLoops,
+                                                         DIR_ALL);
+                    if (!testSubscripts(sourceAccess, sinkAccess,
+                                        numCommonLoops, varying,
+                                        directions)) {
+                        continue;
+                    }
+
+                    Dependence dependence;
+                    dependence.kind =
+                        sourceAccess.isRead
+                            ? Dependence::Kind::Anti
+                            : (sinkAccess.isRead ? Dependence::Kind::Flow
+                                                 : Dependence::Kind::Output);
+                    dependence.source = source;
+                    dependence.sink = sink;
+                    dependence.dataSpace = sourceAccess.dataSpace;
+                    unsigned int privateDepth = std::max(
+                        sourceAccess.privateDepth, sinkAccess.privateDepth);
+
+                    // a dependence is carried at a level if the source can
+                    // run in an earlier iteration of that loop, and the same
+                    // iteration of every loop outside it
+                    bool allEqual = true;
+                    for (unsigned int level = 1; level <= numCommonLoops;
+                         ++level) {
+                        if (level > privateDepth &&
+                            (directions[level - 1] & DIR_LT)) {
+                            dependence.level = level;
+                            dependence.loop = loops[source][level - 1];
+                            dependence.direction = std::string(level - 1, '=');
+                            dependence.direction += '<';
+                            for (unsigned int i = level; i < numCommonLoops;
+                                 ++i) {
+                                unsigned int dir = directions[i];
+                                dependence.direction +=
+                                    dir == DIR_LT   ? '<'
+                                    : dir == DIR_EQ ? '='
+                                    : dir == DIR_GT ? '>'
+                                                    : '*';
+                            }
+                            dependence.relation = buildRelation(
+                                source, sink, sourceAccess, sinkAccess,
+                                numCommonLoops, level);
+                            dependence.isReduction =
+                                source == sink &&
+                                llvm::any_of(
+                                    graph.getReductions(dependence.loop),
+                                    [&](const Reduction* reduction) {
+                                        return reduction->stmt == source &&
+                                               reduction->dataSpace ==
+                                                   dependence.dataSpace;
+                                    });
+                            graph.addDependence(dependence);
+                        }
+                        if (!(directions[level - 1] & DIR_EQ)) {
+                            allEqual = false;
+                            break;
+                        }
+                    }
+                    // otherwise it can only be between instances in the same
+                    // iteration of every common loop, which run in textual
+                    // order
+                    if (allEqual && source < sink) {
+                        dependence.level = 0;
+                        dependence.loop = nullptr;
+                        dependence.isReduction = false;
+                        dependence.direction = std::string(numCommonLoops, '=');
+                        dependence.relation =
+                            buildRelation(source, sink, sourceAccess,
+                                          sinkAccess, numCommonLoops, 0);
+                        graph.addDependence(dependence);
+                    }
+                }
+            }
+        }
+    }
+    return graph;
+}
+
+void DependenceAnalysis::collectAccesses(unsigned int stmtIndex) {
+    const StmtContext& stmtContext = stmtContexts[stmtIndex];
+
+    // arrays, as recorded by the builder
+    for (const auto& it : stmtContext.dataAccesses.arrayAccesses) {
+        const ArrayAccess& arrayAccess = it.second;
+        Access access;
+        access.dataSpace = session.getSPFString(arrayAccess.base);
+        access.isRead = arrayAccess.isRead;
+        for (const auto& index : arrayAccess.indexes) {
+            AffineExpr subscript;
+            access.isAffine.push_back(AffineExpr::tryFromExpr(
+                index, iterators[stmtIndex], session, subscript));
+            access.subscripts.push_back(subscript);
+        }
+        accesses[stmtIndex].push_back(access);
+    }
+
+    // scalars, which the builder does not record
+    Stmt* stmt = stmtContext.stmt;
+    if (DeclStmt* asDeclStmt = dyn_cast<DeclStmt>(stmt)) {
+        for (auto decl : asDeclStmt->decls()) {
+            VarDecl* varDecl = dyn_cast<VarDecl>(decl);
+            if (!varDecl) {
+                continue;
+            }
+            declDepths[varDecl] = loops[stmtIndex].size();
+            if (varDecl->hasInit()) {
+                collectScalarAccesses(varDecl->getInit(), false, stmtIndex);
+                if (varDecl->getType()->isScalarType() &&
+                    !varDecl->getType()->isPointerType()) {
+                    Access access;
+                    access.dataSpace = varDecl->getNameAsString();
+                    access.scalar = varDecl;
+                    access.isRead = false;
+                    access.privateDepth = loops[stmtIndex].size();
+                    accesses[stmtIndex].push_back(access);
+                }
+            }
+        }
+    } else if (Expr* asExpr = dyn_cast<Expr>(stmt)) {
+        collectScalarAccesses(asExpr, false, stmtIndex);
+    }
+}
+
+void DependenceAnalysis::findReductions(unsigned int stmtIndex,
+                                        DependenceGraph& graph) const {
+    BinaryOperator* asBinOper =
+        dyn_cast<BinaryOperator>(stmtContexts[stmtIndex].stmt);
+    if (!asBinOper) {
+        return;
+    }
+    BinaryOperatorKind oper = asBinOper->getOpcode();
+    if (oper != BO_AddAssign && oper != BO_SubAssign && oper != BO_MulAssign &&
+        oper != BO_AndAssign && oper != BO_OrAssign && oper != BO_XorAssign) {
+        return;
+    }
+
+    // the accumulator is the statement's one write, and must be read only
+    // by the compound assignment itself
+    const std::vector<Access>& stmtAccesses = accesses[stmtIndex];
+    auto write = llvm::find_if(
+        stmtAccesses, [](const Access& access) { return !access.isRead; });
+    if (write == stmtAccesses.end() ||
+        llvm::count(write->isAffine, false) != 0 ||
+        llvm::any_of(stmtAccesses,
+                     [](const Access& access) { return access.isUnknown; })) {
+        return;
+    }
+    auto isSameDataSpace = [&write](const Access& access) {
+        return access.isUnknown || (access.scalar == write->scalar &&
+                                    access.dataSpace == write->dataSpace);
+    };
+    unsigned int numReads = 0;
+    for (const auto& access : stmtAccesses) {
+        if (access.isRead && isSameDataSpace(access)) {
+            for (unsigned int i = 0; i < access.subscripts.size(); ++i) {
+                if (!access.isAffine[i] ||
+                    access.subscripts[i].toString() !=
+                        write->subscripts[i].toString()) {
+                    return;
+                }
+            }
+            numReads++;
+        }
+    }
+    if (numReads != 1) {
+        return;
+    }
+
+    // a scalar declared inside a loop is already private to its iterations
+    for (unsigned int level = write->privateDepth + 1;
+         level <= loops[stmtIndex].size(); ++level) {
+        // the same location must be updated throughout the loop, including
+        // in the loops nested in it
+        bool isInvariant = true;
+        for (const auto& subscript : write->subscripts) {
+            for (unsigned int i = level - 1; i < loops[stmtIndex].size();
+                 ++i) {
+                isInvariant = isInvariant && !hasIterator(subscript, i);
+            }
+        }
+        if (!isInvariant) {
+            continue;
+        }
+        // and nothing else in the loop may touch it
+        bool isExclusive = true;
+        for (unsigned int other = 0; other < stmtContexts.size(); ++other) {
+            if (other != stmtIndex &&
+                getNumCommonLoops(stmtIndex, other) >= level &&
+                llvm::any_of(accesses[other], isSameDataSpace)) {
+                isExclusive = false;
+                break;
+            }
+        }
+        if (!isExclusive) {
+            continue;
+        }
+        Reduction reduction;
+        reduction.stmt = stmtIndex;
+        reduction.loop = loops[stmtIndex][level - 1];
+        reduction.level = level;
+        reduction.oper = oper;
+        reduction.dataSpace = write->dataSpace;
+        reduction.subscripts = write->subscripts;
+        graph.addReduction(reduction);
+    }
+}
+
+void DependenceAnalysis::collectScalarAccesses(Expr* expr, bool isWrite,
+                                               unsigned int stmtIndex) {
+    Expr* usableExpr = expr->IgnoreParenImpCasts();
+    // the only writes located are to scalar variables and to the array
+    // element the builder records as the statement's write
+    DeclRefExpr* asDeclRef = dyn_cast<DeclRefExpr>(usableExpr);
+    VarDecl* varDecl =
+        asDeclRef ? dyn_cast<VarDecl>(asDeclRef->getDecl()) : nullptr;
+    bool isScalar = varDecl && varDecl->getType()->isScalarType() &&
+                    !varDecl->getType()->isPointerType();
+    if (isWrite && !isScalar &&
+        usableExpr != DataAccessHandler::getWrittenArrayAccess(
+                          stmtContexts[stmtIndex].stmt)) {
+        addUnknownAccess(usableExpr, false, stmtIndex);
+    }
+
+    if (asDeclRef) {
+        const std::vector<std::string>& stmtIterators = iterators[stmtIndex];
+        if (isScalar &&
+            std::find(stmtIterators.begin(), stmtIterators.end(),
+                      varDecl->getNameAsString()) == stmtIterators.end()) {
+            Access access;
+            access.dataSpace = varDecl->getNameAsString();
+            access.scalar = varDecl;
+            access.isRead = !isWrite;
+            auto depth = declDepths.find(varDecl);
+            if (depth != declDepths.end()) {
+                access.privateDepth = depth->second;
+            }
+            accesses[stmtIndex].push_back(access);
+        }
+    } else if (BinaryOperator* asBinOper =
+                   dyn_cast<BinaryOperator>(usableExpr)) {
+        if (asBinOper->isAssignmentOp()) {
+            collectScalarAccesses(asBinOper->getRHS(), false, stmtIndex);
+            if (asBinOper->isCompoundAssignmentOp()) {
+                collectScalarAccesses(asBinOper->getLHS(), false, stmtIndex);
+            }
+            collectScalarAccesses(asBinOper->getLHS(), true, stmtIndex);
+        } else {
+            collectScalarAccesses(asBinOper->getLHS(), false, stmtIndex);
+            collectScalarAccesses(asBinOper->getRHS(), false, stmtIndex);
+        }
+    } else if (UnaryOperator* asUnOper = dyn_cast<UnaryOperator>(usableExpr)) {
+        if (asUnOper->getOpcode() == UO_Deref && !isWrite) {
+            addUnknownAccess(asUnOper, true, stmtIndex);
+        }
+        collectScalarAccesses(asUnOper->getSubExpr(), false, stmtIndex);
+        if (asUnOper->isIncrementDecrementOp()) {
+            collectScalarAccesses(asUnOper->getSubExpr(), true, stmtIndex);
+        }
+    } else if (ArraySubscriptExpr* asArrayAccess =
+                   dyn_cast<ArraySubscriptExpr>(usableExpr)) {
+        // the array itself is recorded by the builder; its indexes are reads
+        collectScalarAccesses(asArrayAccess->getBase(), false, stmtIndex);
+        collectScalarAccesses(asArrayAccess->getIdx(), false, stmtIndex);
+    } else {
+        if (isa<MemberExpr>(usableExpr) && !isWrite) {
+            addUnknownAccess(usableExpr, true, stmtIndex);
+        } else if (CallExpr* asCall = dyn_cast<CallExpr>(usableExpr)) {
+            if (hasSideEffects(asCall)) {
+                addUnknownAccess(asCall, false, stmtIndex);
+            }
+        }
+        for (auto child : usableExpr->children()) {
+            if (Expr* childExpr = dyn_cast_or_null<Expr>(child)) {
+                collectScalarAccesses(childExpr, false, stmtIndex);
+            }
+        }
+    }
+}
+
+void DependenceAnalysis::addUnknownAccess(Expr* expr, bool isRead,
+                                          unsigned int stmtIndex) {
+    Access access;
+    access.dataSpace = session.getSourceText(expr);
+    access.isRead = isRead;
+    access.isUnknown = true;
+    accesses[stmtIndex].push_back(access);
+}
+
+bool DependenceAnalysis::hasSideEffects(const CallExpr* call) const {
+    const FunctionDecl* callee = call->getDirectCallee();
+    if (!callee) {
+        return true;
+    }
+    if (callee->hasAttr<ConstAttr>() || callee->hasAttr<PureAttr>()) {
+        return false;
+    }
+    unsigned int builtinID = callee->getBuiltinID();
+    return builtinID == 0 ||
+           !session.getASTContext().BuiltinInfo.isConst(builtinID);
+}
+
+bool DependenceAnalysis::mayConflict(const Access& first,
+                                     const Access& second) {
+    if (first.isRead && second.isRead) {
+        return false;
+    }
+    return first.isUnknown || second.isUnknown ||
+           (first.scalar == second.scalar &&
+            first.dataSpace == second.dataSpace);
+}
+
+bool DependenceAnalysis::preventsFusion(unsigned int first,
+                                        unsigned int second,
+                                        unsigned int level) const {
+    std::set<std::string> varying = getVaryingScalars(first, second);
+    for (const auto& firstAccess : accesses[first]) {
+        for (const auto& secondAccess : accesses[second]) {
+            if (!mayConflict(firstAccess, secondAccess)) {
+                continue;
+            }
+            std::vector<unsigned int> directions(level, DIR_ALL);
+            if (!testSubscripts(firstAccess, secondAccess, level, varying,
+                                directions)) {
+                continue;
+            }
+            // the first statement's instance must be able to run in the
+            // same iteration of every loop outside, and a later one of the
+            // loops being fused
+            bool isSameOuterIteration =
+                std::all_of(directions.begin(), directions.end() - 1,
+                            [](unsigned int dir) { return dir & DIR_EQ; });
+            if (isSameOuterIteration && (directions.back() & DIR_GT)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool DependenceAnalysis::testSubscripts(
+    const Access& source, const Access& sink, unsigned int numCommonLoops,
+    const std::set<std::string>& varying,
+    std::vector<unsigned int>& directions) const {
+    unsigned int numDims =
+        std::min(source.subscripts.size(), sink.subscripts.size());
+    for (unsigned int dim = 0; dim < numDims; ++dim) {
+        if (!source.isAffine[dim] || !sink.isAffine[dim]) {
+            continue;
+        }
+        const AffineExpr& sourceExpr = source.subscripts[dim];
+        const AffineExpr& sinkExpr = sink.subscripts[dim];
+
+        // iterator coefficients on each side; everything else must cancel
+        // out for the subscript to be decidable
+        std::map<unsigned int, int> sourceCoefs;
+        std::map<unsigned int, int> sinkCoefs;
+        bool isDecidable = true;
+        for (const auto& term : sourceExpr.getTerms()) {
+            if (term.kind == AffineTerm::Kind::Iterator) {
+                sourceCoefs[term.iteratorIndex] = term.coefficient;
+            } else if (!cancelsOut(term, sinkExpr, varying)) {
+                isDecidable = false;
+            }
+        }
+        for (const auto& term : sinkExpr.getTerms()) {
+            if (term.kind == AffineTerm::Kind::Iterator) {
+                sinkCoefs[term.iteratorIndex] = term.coefficient;
+            } else if (!cancelsOut(term, sourceExpr, varying)) {
+                isDecidable = false;
+            }
+        }
+        if (!isDecidable) {
+            continue;
+        }
+        // the subscripts are equal when
+        // sum(sinkCoef * sinkIter) - sum(sourceCoef * sourceIter) = diff
+        int diff = sourceExpr.getConstant() - sinkExpr.getConstant();
+
+        // ZIV: no iterators at all
+        if (sourceCoefs.empty() && sinkCoefs.empty()) {
+            if (diff != 0) {
+                return false;
+            }
+            continue;
+        }
+
+        // GCD: an integer solution needs the gcd of the coefficients to
+        // divide the difference
+        int gcd = 0;
+        for (const auto& coefs : {sourceCoefs, sinkCoefs}) {
+            for (const auto& it : coefs) {
+                int a = std::abs(gcd);
+                int b = std::abs(it.second);
+                while (b != 0) {
+                    int t = a % b;
+                    a = b;
+                    b = t;
+                }
+                gcd = a;
+            }
+        }
+        if (gcd != 0 && diff % gcd != 0) {
+            return false;
+        }
+
+        // strong SIV: the same common iterator with the same coefficient on
+        // both sides, giving a fixed distance in that loop
+        if (sourceCoefs.size() == 1 && sinkCoefs.size() == 1) {
+            auto sourceTerm = *sourceCoefs.begin();
+            auto sinkTerm = *sinkCoefs.begin();
+            unsigned int loop = sourceTerm.first;
+            if (loop == sinkTerm.first && loop < numCommonLoops &&
+                sourceTerm.second == sinkTerm.second) {
+                int distance = diff / sourceTerm.second;
+                directions[loop] &= distance > 0    ? DIR_LT
+                                    : distance == 0 ? DIR_EQ
+                                                    : DIR_GT;
+                if (directions[loop] == 0) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+std::string DependenceAnalysis::buildRelation(unsigned int source,
+                                              unsigned int sink,
+                                              const Access& sourceAccess,
+                                              const Access& sinkAccess,
+                                              unsigned int numCommonLoops,
+                                              unsigned int level) const {
+    const std::vector<std::string>& sourceIters = iterators[source];
+    const std::vector<std::string>& sinkIters = sinkIterators[sink];
+    std::vector<std::string> constraints;
+    // both iterations exist
+    for (const auto& constraint : stmtContexts[source].getConstraints()) {
+        constraints.push_back(constraint->toString(sourceIters));
+    }
+    for (const auto& constraint : stmtContexts[sink].getConstraints()) {
+        constraints.push_back(constraint->toString(sinkIters));
+    }
+    // they touch the same element
+    unsigned int numDims = std::min(sourceAccess.subscripts.size(),
+                                    sinkAccess.subscripts.size());
+    for (unsigned int dim = 0; dim < numDims; ++dim) {
+        if (sourceAccess.isAffine[dim] && sinkAccess.isAffine[dim]) {
+            constraints.push_back(
+                sourceAccess.subscripts[dim].toString(sourceIters) + " = " +
+                sinkAccess.subscripts[dim].toString(sinkIters));
+        }
+    }
+    // the source runs first
+    unsigned int numEqual = level == 0 ? numCommonLoops : level - 1;
+    for (unsigned int i = 0; i < numEqual; ++i) {
+        constraints.push_back(sourceIters[i] + " = " + sinkIters[i]);
+    }
+    if (level != 0) {
+        constraints.push_back(sourceIters[level - 1] + " < " +
+                              sinkIters[level - 1]);
+    }
+
+    std::ostringstream os;
+    os << "{" << getTupleString(sourceIters) << "->"
+       << getTupleString(sinkIters);
+    for (unsigned int i = 0; i < constraints.size(); ++i) {
+        // the ordering often repeats a subscript equality
+        if (std::find(constraints.begin(), constraints.begin() + i,
+                      constraints[i]) != constraints.begin() + i) {
+            continue;
+        }
+        os << (i == 0 ? ": " : " && ") << constraints[i];
+    }
+    os << "}";
+    return os.str();
+}
+
+std::set<std::string> DependenceAnalysis::getVaryingScalars(
+    unsigned int first, unsigned int second) const {
+    // between instances of statements in a common loop, only the
+    // statements in the outermost such loop run; otherwise, any statement
+    // may
+    const ForStmt* outermost = getNumCommonLoops(first, second) == 0
+                                   ? nullptr
+                                   : loops[first][0];
+    std::set<std::string> varying;
+    for (unsigned int stmtIndex = 0; stmtIndex < accesses.size();
+         ++stmtIndex) {
+        if (outermost && (loops[stmtIndex].empty() ||
+                          loops[stmtIndex][0] != outermost)) {
+            continue;
+        }
+        for (const auto& access : accesses[stmtIndex]) {
+            if (access.scalar && !access.isRead) {
+                varying.insert(access.scalar->getNameAsString());
+            }
+        }
+    }
+    return varying;
+}
+
+unsigned int DependenceAnalysis::getNumCommonLoops(unsigned int first,
+                                                   unsigned int second) const {
+    unsigned int numCommon = 0;
+    while (numCommon < loops[first].size() &&
+           numCommon < loops[second].size() &&
+           loops[first][numCommon] == loops[second][numCommon]) {
+        numCommon++;
+    }
+    return numCommon;
+}
+
+}  // namespace spf_ie
@@ -9,22 +9,49 @@
  * \author Anna Rift
  */
 
-#include "Driver.hpp"
-
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "CodeGenerator.hpp"
+#include "ComputationCache.hpp"
+#include "ComputationEmitter.hpp"
+#include "ComputationServer.hpp"
+#include "Instrumentation.hpp"
+#include "PreambleCache.hpp"
 #include "SPFComputationBuilder.hpp"
 #include "Utils.hpp"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
 #include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/FrontendOptions.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Serialization/PCHContainerOperations.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/VirtualFileSystem.h"
 
 using namespace clang;
 using namespace clang::tooling;
@@ -32,60 +59,678 @@ using namespace clang::tooling;
 static llvm::cl::opt<bool> PrintOutputToConsole(
     "print-info", llvm::cl::desc("Output info to console"));
 
+static llvm::cl::opt<unsigned> NumJobs(
+    "j",
+    llvm::cl::desc("Number of source files to process in parallel (0 uses "
+                   "all available cores)"),
+    llvm::cl::value_desc("N"), llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned> NumFunctionJobs(
+    "function-jobs",
+    llvm::cl::desc("Number of functions within a source file to process in "
+                   "parallel (0 uses all available cores)"),
+    llvm::cl::value_desc("N"), llvm::cl::init(1));
+
+static llvm::cl::opt<std::string> CacheDir(
+    "cache-dir",
+    llvm::cl::desc("Directory for a persistent cache of built Computations, "
+                   "reused across runs"),
+    llvm::cl::value_desc("directory"));
+
+static llvm::cl::opt<std::string> PreambleCacheDir(
+    "preamble-cache",
+    llvm::cl::desc("Directory for precompiled headers built from the "
+                   "#includes at the top of each source file, reused across "
+                   "files and runs"),
+    llvm::cl::value_desc("directory"));
+
+static llvm::cl::opt<std::string> FunctionFilter(
+    "function",
+    llvm::cl::desc("Only process functions whose qualified name fully "
+                   "matches this regular expression"),
+    llvm::cl::value_desc("regex"));
+
+static llvm::cl::opt<spf_ie::ComputationEmitter::Format> EmitFormat(
+    "emit",
+    llvm::cl::desc("Stream each built Computation to the --output file"),
+    llvm::cl::values(
+        clEnumValN(spf_ie::ComputationEmitter::Format::JSONLines, "jsonl",
+                   "One JSON object per function"),
+        clEnumValN(spf_ie::ComputationEmitter::Format::Binary, "bin",
+                   "Length-prefixed binary records")));
+
+static llvm::cl::opt<std::string> OutputPath(
+    "output", llvm::cl::desc("File to write --emit output to"),
+    llvm::cl::value_desc("path"));
+
+static llvm::cl::opt<bool> TimeReport(
+    "time-report",
+    llvm::cl::desc("Print time spent in each processing phase, and counts of "
+                   "statements, accesses, constraints and replacement "
+                   "variables"));
+
+static llvm::cl::opt<std::string> TraceFile(
+    "trace",
+    llvm::cl::desc("Write a Chrome trace-event file with a span for each "
+                   "translation unit, function and phase"),
+    llvm::cl::value_desc("file"));
+
+static llvm::cl::opt<bool> KeepGoing(
+    "keep-going",
+    llvm::cl::desc("Skip functions which cannot be built instead of stopping, "
+                   "and summarize the failures at the end"));
+
+static llvm::cl::opt<bool> Server(
+    "server",
+    llvm::cl::desc("Keep running, answering JSON requests (one per line) to "
+                   "build the Computations of a file, from standard input "
+                   "or --socket"));
+
+static llvm::cl::opt<std::string> SocketPath(
+    "socket",
+    llvm::cl::desc("Unix domain socket for --server to listen on, instead of "
+                   "standard input and output"),
+    llvm::cl::value_desc("path"));
+
+static llvm::cl::opt<bool> PrintDependences(
+    "dependences",
+    llvm::cl::desc("Print the data dependences between the statements of "
+                   "each function, and the loop level carrying each"));
+
+static llvm::cl::opt<bool> PrintLocality(
+    "locality",
+    llvm::cl::desc("Print, for each loop, the stride of every array access "
+                   "in its body along its iterator: stride-0, unit-stride, "
+                   "constant-stride or gather"));
+
+static llvm::cl::opt<bool> PrintIntensity(
+    "intensity",
+    llvm::cl::desc("Print the bytes read and written and the arithmetic "
+                   "operations of each statement and loop nest, with their "
+                   "arithmetic intensity"));
+
+static llvm::cl::opt<double> MachineBalance(
+    "machine-balance",
+    llvm::cl::desc("Operations per byte the target machine can sustain; with "
+                   "--intensity, marks each statement and loop nest memory- "
+                   "or compute-bound"),
+    llvm::cl::value_desc("ops/byte"), llvm::cl::init(0));
+
+static llvm::cl::opt<bool> OptimizeSchedules(
+    "optimize-schedules",
+    llvm::cl::desc("Replace the source-order execution schedules of each "
+                   "Computation with ones computed by isl's scheduler, for "
+                   "outer parallelism and locality"));
+
+static llvm::cl::opt<bool> FuseLoops(
+    "fuse-loops",
+    llvm::cl::desc("Fuse adjacent loops with the same bounds, where "
+                   "dependences allow, by rewriting execution schedules"));
+
+static llvm::cl::list<unsigned int> TileSizes(
+    "tile-sizes",
+    llvm::cl::desc("Tile loop nests, with the given tile size for each loop "
+                   "level, outermost first (0 leaves a level untiled)"),
+    llvm::cl::value_desc("sizes"), llvm::cl::CommaSeparated);
+
+static llvm::cl::opt<spf_ie::CodeGenerator::Target> CodegenTarget(
+    "codegen",
+    llvm::cl::desc("Print code generated from the Computation of each "
+                   "function to standard output"),
+    llvm::cl::values(
+        clEnumValN(spf_ie::CodeGenerator::Target::COpenMP, "c-openmp",
+                   "C, with loops that carry no dependence marked OpenMP "
+                   "parallel"),
+        clEnumValN(spf_ie::CodeGenerator::Target::COpenMPLevelSets,
+                   "c-openmp-level-sets",
+                   "As c-openmp, also running outermost loops that carry "
+                   "dependences level by level, with levels found at "
+                   "runtime")));
+
+static llvm::cl::opt<bool> MainFileOnly(
+    "main-file-only",
+    llvm::cl::desc("Only process functions defined in the main file, not in "
+                   "included headers"));
+
 namespace spf_ie {
 
-const ASTContext *Context;
+//! Whether code is to be generated for each function
+static bool isGeneratingCode() { return CodegenTarget.getNumOccurrences() > 0; }
+
+//! Whether only some functions are selected for processing, so that the
+//! bodies of the rest need not be parsed
+static bool isFilteringFunctions() {
+    return MainFileOnly || !FunctionFilter.empty();
+}
+
+/*!
+ * \struct FunctionFailure
+ *
+ * \brief A function which could not be built (with --keep-going)
+ */
+struct FunctionFailure {
+    //! Qualified name of the function
+    std::string functionName;
+    //! Why it could not be built
+    std::string message;
+    //! Where in the source the problem is, if known
+    std::string location;
+};
+
+/*!
+ * \struct FunctionResult
+ *
+ * \brief Everything produced by processing one function
+ */
+struct FunctionResult {
+    explicit FunctionResult(std::string functionName)
+        : functionName(functionName) {}
+
+    //! Qualified name of the function
+    std::string functionName;
+    //! Computation built, only kept if it will be printed
+    std::unique_ptr<iegenlib::Computation> computation;
+    //! Dependence graph, printed (with --dependences)
+    std::string dependences;
+    //! Locality report, printed (with --locality)
+    std::string locality;
+    //! Arithmetic intensity table, printed (with --intensity)
+    std::string intensity;
+    //! Generated code, printed (with --codegen)
+    std::string code;
+    //! Entry for the output file, written once the file is reported (with
+    //! --output)
+    std::string emitted;
+    //! Why the schedules could not be optimized (with --optimize-schedules)
+    std::string scheduleFailure;
+    //! Number of pairs of loops fused (with --fuse-loops)
+    unsigned int numFusedLoops = 0;
+    //! Number of bands of loops tiled (with --tile-sizes)
+    unsigned int numTiledBands = 0;
+    //! Why the loops were not tiled (with --tile-sizes)
+    std::string tilingSkipped;
+};
+
+/*!
+ * \struct FileResult
+ *
+ * \brief Everything produced by processing one source file, held until it
+ * can be reported in input order
+ */
+struct FileResult {
+    explicit FileResult(std::string fileName) : fileName(fileName) {}
+
+    //! Source file processed
+    std::string fileName;
+    //! Flags the file is compiled with
+    std::string compileFlags;
+    //! Functions built, in declaration order
+    std::vector<FunctionResult> functions;
+    //! Functions which could not be built, in declaration order
+    std::vector<FunctionFailure> failures;
+    //! Result of running the Clang tool on the file
+    int status = 0;
+    //! Wall-clock time spent processing the file, in seconds
+    double wallTime = 0;
+};
+
+/*!
+ * \struct ToolServices
+ *
+ * \brief Facilities shared by the processing of every source file, any of
+ * which may be absent
+ */
+struct ToolServices {
+    //! Cache of built Computations
+    ComputationCache *cache = nullptr;
+    //! Destination for streamed Computations
+    ComputationEmitter *emitter = nullptr;
+    //! Cache of precompiled preambles
+    PreambleCache *preambles = nullptr;
+};
 
 class SPFConsumer : public ASTConsumer {
    public:
-    explicit SPFConsumer(llvm::StringRef fileName) : fileName(fileName.str()) {}
+    SPFConsumer(FileResult &result, const ToolServices &services,
+                const SourceManager &SM)
+        : result(result),
+          services(services),
+          SM(SM),
+          functionFilter("^(" + FunctionFilter + ")$"),
+          parseStart(std::chrono::steady_clock::now()) {}
+
+    //! Skip parsing the bodies of functions we will not process. Only
+    //! consulted when SkipFunctionBodies is set in the frontend options.
+    bool shouldSkipFunctionBody(Decl *D) override {
+        FunctionDecl *func = D->getAsFunction();
+        return !func || !isSelected(func);
+    }
+
     virtual void HandleTranslationUnit(ASTContext &Ctx) {
-        // initializing globally-accessible ASTContext
-        Context = &Ctx;
-        llvm::errs() << "\nProcessing: " << fileName << "\n";
-        if (PrintOutputToConsole) {
-            llvm::errs()
-                << "=================================================\n\n";
+        if (Instrumentation::isEnabled()) {
+            Instrumentation::recordPhase(Instrumentation::Phase::Parse,
+                                         result.fileName, parseStart,
+                                         std::chrono::steady_clock::now());
         }
-        SPFComputationBuilder builder;
-        // process each function (with a body) in the file
-        bool builtAComputation = false;
-        for (auto it : Context->getTranslationUnitDecl()->decls()) {
+        // gather each function (with a body) in the file
+        std::vector<FunctionDecl *> functions;
+        for (auto it : Ctx.getTranslationUnitDecl()->decls()) {
             FunctionDecl *func = dyn_cast<FunctionDecl>(it);
-            if (func && func->doesThisDeclarationHaveABody()) {
-                if (PrintOutputToConsole) {
-                    llvm::outs()
-                        << "FUNCTION: " << func->getQualifiedNameAsString()
-                        << "\n";
-                    Utils::printSmallLine();
-                    llvm::outs() << "\n";
-                }
-                std::unique_ptr<iegenlib::Computation> computation =
-                    builder.buildComputationFromFunction(func);
-                builtAComputation = true;
-                if (PrintOutputToConsole) {
-                    computation->printInfo();
-                }
+            if (func && func->doesThisDeclarationHaveABody() &&
+                isSelected(func)) {
+                functions.push_back(func);
+                result.functions.emplace_back(
+                    func->getQualifiedNameAsString());
             }
         }
-        if (!builtAComputation) {
-            llvm::errs() << "No valid functions found for processing!\n";
-            exit(1);
+        // process them, filling in results by declaration order
+        errors.resize(functions.size());
+        if (NumFunctionJobs == 1) {
+            SPFComputationBuilder builder(Ctx, KeepGoing);
+            for (unsigned int i = 0; i < functions.size(); ++i) {
+                processFunction(builder, i, functions[i], Ctx);
+            }
+        } else {
+            // the AST is only read from here on, so functions can be built
+            // concurrently, each with its own builder; the source manager
+            // is not, and is queried under Utils::sourceManagerMutex
+            llvm::parallelForEachN(0, functions.size(), [&](size_t i) {
+                SPFComputationBuilder builder(Ctx, KeepGoing);
+                processFunction(builder, i, functions[i], Ctx);
+            });
         }
+        reportErrors(Ctx.getDiagnostics());
     }
 
    private:
-    std::string fileName;
+    FileResult &result;
+    const ToolServices &services;
+    const SourceManager &SM;
+    //! Anchored form of the --function regular expression
+    llvm::Regex functionFilter;
+    //! When parsing of the file started (the consumer is created just before)
+    std::chrono::steady_clock::time_point parseStart;
+    //! Error raised while building each function, if any, by position in
+    //! result.functions
+    std::vector<std::unique_ptr<SPFError>> errors;
+
+    //! Check whether a function is selected for processing by the
+    //! --function and --main-file-only options
+    bool isSelected(FunctionDecl *func) {
+        if (MainFileOnly &&
+            !SM.isInMainFile(SM.getExpansionLoc(func->getLocation()))) {
+            return false;
+        }
+        return FunctionFilter.empty() ||
+               functionFilter.match(func->getQualifiedNameAsString());
+    }
+
+    //! Build the Computation for a function and stream it out. It is only
+    //! kept in the result if it will be printed to the console.
+    //! \param[in] index Position of the function in result.functions
+    void processFunction(SPFComputationBuilder &builder, unsigned int index,
+                         FunctionDecl *func, ASTContext &Ctx) {
+        FunctionResult &funcResult = result.functions[index];
+        const std::string &funcName = funcResult.functionName;
+        PhaseTimer timer(Instrumentation::Phase::Function, funcName);
+        std::unique_ptr<iegenlib::Computation> computation;
+        try {
+            computation = buildComputation(builder, func, Ctx);
+            bool isOptimized = false;
+            if (OptimizeSchedules) {
+                PhaseTimer timer(Instrumentation::Phase::Schedule, funcName);
+                isOptimized = builder.optimizeSchedules(
+                    computation.get(), funcResult.scheduleFailure);
+            }
+            // isl's schedules already fuse loops wherever that pays off
+            if (FuseLoops && !isOptimized) {
+                PhaseTimer timer(Instrumentation::Phase::Schedule, funcName);
+                funcResult.numFusedLoops =
+                    builder.fuseLoops(computation.get());
+            }
+            // tiling works from the loops as written
+            if (!TileSizes.empty() && isOptimized) {
+                funcResult.tilingSkipped =
+                    "its schedules were replaced by --optimize-schedules";
+            } else if (!TileSizes.empty() && funcResult.numFusedLoops != 0) {
+                funcResult.tilingSkipped =
+                    "its loops were fused by --fuse-loops";
+            } else if (!TileSizes.empty()) {
+                PhaseTimer timer(Instrumentation::Phase::Schedule, funcName);
+                funcResult.numTiledBands = builder.tileLoops(
+                    computation.get(), std::vector<unsigned int>(
+                                           TileSizes.begin(), TileSizes.end()));
+            }
+            if (PrintDependences) {
+                PhaseTimer timer(Instrumentation::Phase::Dependences,
+                                 funcName);
+                funcResult.dependences =
+                    builder.analyzeDependences().toString();
+            }
+            if (PrintLocality) {
+                PhaseTimer timer(Instrumentation::Phase::Locality, funcName);
+                funcResult.locality = builder.analyzeLocality().toString();
+            }
+            if (PrintIntensity) {
+                PhaseTimer timer(Instrumentation::Phase::Intensity, funcName);
+                funcResult.intensity =
+                    builder.estimateIntensity().toString(MachineBalance);
+            }
+            if (isGeneratingCode()) {
+                PhaseTimer timer(Instrumentation::Phase::CodeGen, funcName);
+                funcResult.code = builder.generateCode(func, CodegenTarget);
+            }
+        } catch (const SPFError &error) {
+            // only thrown with --keep-going; reported once all functions
+            // are done, since the DiagnosticsEngine is not thread-safe
+            errors[index] = std::make_unique<SPFError>(error);
+            return;
+        }
+        if (services.emitter) {
+            PhaseTimer emitTimer(Instrumentation::Phase::Emit, funcName);
+            funcResult.emitted = services.emitter->render(
+                result.fileName, funcName, computation.get());
+        }
+        if (PrintOutputToConsole) {
+            funcResult.computation = std::move(computation);
+        } else {
+            std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+            computation.reset();
+        }
+    }
+
+    //! Report the functions which failed to build as diagnostics, record
+    //! them in the result, and drop them from its functions
+    void reportErrors(DiagnosticsEngine &diags) {
+        unsigned int diagID = diags.getCustomDiagID(
+            DiagnosticsEngine::Error, "cannot build Computation from '%0': %1");
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < errors.size(); ++i) {
+            if (errors[i]) {
+                const std::string &funcName = result.functions[i].functionName;
+                SourceLocation loc = errors[i]->getLocation();
+                diags.Report(loc, diagID) << funcName << errors[i]->what();
+                result.failures.push_back(
+                    {funcName, errors[i]->what(),
+                     loc.isValid() ? loc.printToString(SM) : result.fileName});
+            } else {
+                result.functions[kept++] = std::move(result.functions[i]);
+            }
+        }
+        result.functions.erase(result.functions.begin() + kept,
+                               result.functions.end());
+    }
+
+    //! Build the Computation for a function, going through the cache (if
+    //! there is one). Dependence and locality analysis, intensity estimates
+    //! and code generation need the builder's view of the function, as do
+    //! schedule optimization, loop fusion and tiling, so the cache is
+    //! bypassed for them.
+    std::unique_ptr<iegenlib::Computation> buildComputation(
+        SPFComputationBuilder &builder, FunctionDecl *func, ASTContext &Ctx) {
+        ComputationCache *cache = services.cache;
+        if (!cache || PrintDependences || PrintLocality || PrintIntensity ||
+            OptimizeSchedules || FuseLoops || !TileSizes.empty() ||
+            isGeneratingCode()) {
+            return builder.buildComputationFromFunction(func);
+        }
+        std::string key =
+            ComputationCache::computeKey(func, Ctx, result.compileFlags);
+        std::unique_ptr<iegenlib::Computation> computation =
+            cache->lookup(key);
+        if (!computation) {
+            computation = builder.buildComputationFromFunction(func);
+            cache->store(key, computation.get());
+        }
+        return computation;
+    }
 };
 
 class SPFFrontendAction : public ASTFrontendAction {
    public:
+    SPFFrontendAction(FileResult &result, const ToolServices &services)
+        : result(result), services(services) {}
     virtual std::unique_ptr<ASTConsumer> CreateASTConsumer(
         CompilerInstance &Compiler, llvm::StringRef InFile) {
-        return std::unique_ptr<ASTConsumer>(new SPFConsumer(InFile));
+        if (isFilteringFunctions()) {
+            // let the consumer decide which function bodies to parse
+            Compiler.getFrontendOpts().SkipFunctionBodies = true;
+        }
+        return std::unique_ptr<ASTConsumer>(
+            new SPFConsumer(result, services, Compiler.getSourceManager()));
     }
+
+   private:
+    FileResult &result;
+    const ToolServices &services;
 };
 
+/*!
+ * \class SPFFrontendActionFactory
+ *
+ * \brief Creates frontend actions which store their output in a FileResult
+ */
+class SPFFrontendActionFactory : public FrontendActionFactory {
+   public:
+    SPFFrontendActionFactory(FileResult &result, const ToolServices &services)
+        : result(result), services(services) {}
+    std::unique_ptr<FrontendAction> create() override {
+        return std::make_unique<SPFFrontendAction>(result, services);
+    }
+
+   private:
+    FileResult &result;
+    const ToolServices &services;
+};
+
+//! Get the flags a file is compiled with (everything in its compile commands
+//! but the file name itself), for use in cache keys
+std::string getCompileFlags(const CompilationDatabase &compilations,
+                            const std::string &fileName) {
+    std::string flags;
+    for (const auto &command : compilations.getCompileCommands(fileName)) {
+        for (const auto &arg : command.CommandLine) {
+            if (arg != command.Filename) {
+                flags += arg;
+                flags.push_back('\0');
+            }
+        }
+    }
+    return flags;
+}
+
+//! Build the Computations of a translation unit serialized to an AST file
+//! (e.g. by clang -emit-ast), without parsing anything
+//! \return 0 on success, like ClangTool::run
+int processASTFile(FileResult &result, const ToolServices &services) {
+    std::unique_ptr<ASTUnit> unit = PreambleCache::loadASTFile(result.fileName);
+    if (!unit) {
+        return 1;
+    }
+    SPFConsumer consumer(result, services, unit->getSourceManager());
+    consumer.HandleTranslationUnit(unit->getASTContext());
+    return 0;
+}
+
+//! Run the tool on a single source file, with its own CompilerInstance and
+//! builder, so that files can be processed on separate threads
+//! \param[in] compilations Compilation database to get commands from
+//! \param[in,out] result Result to fill in for the file
+//! \param[in] services Facilities shared between files
+void processFile(const CompilationDatabase &compilations, FileResult &result,
+                 const ToolServices &services) {
+    auto start = std::chrono::steady_clock::now();
+    if (services.cache) {
+        result.compileFlags = getCompileFlags(compilations, result.fileName);
+    }
+    {
+        PhaseTimer timer(Instrumentation::Phase::TranslationUnit,
+                         result.fileName);
+        if (llvm::StringRef(result.fileName).endswith(".ast")) {
+            result.status = processASTFile(result, services);
+        } else {
+            // must outlive the tool, which refers to its contents
+            PreambleCache::Preamble preamble;
+            if (services.preambles) {
+                preamble =
+                    services.preambles->get(compilations, result.fileName);
+            }
+            // the tool moves to each command's directory; with a file system
+            // of its own, it does not change the process-wide working
+            // directory that concurrent jobs rely on
+            llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSystem(
+                llvm::vfs::createPhysicalFileSystem().release());
+            ClangTool Tool(compilations, {result.fileName},
+                           std::make_shared<PCHContainerOperations>(),
+                           fileSystem);
+            if (preamble.isValid()) {
+                PreambleCache::apply(Tool, preamble);
+            }
+            SPFFrontendActionFactory factory(result, services);
+            result.status = Tool.run(&factory);
+        }
+    }
+    result.wallTime = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+}
+
+//! Print the code generated for a source file, preceded by the directives
+//! at the top of the file so that its macros and types are available
+void printGeneratedCode(const FileResult &result) {
+    llvm::outs() << "/* Generated by spf-ie from " << result.fileName
+                 << " */\n";
+    if (CodegenTarget == spf_ie::CodeGenerator::Target::COpenMPLevelSets) {
+        // for the inspectors' tables
+        llvm::outs() << "#include <stdlib.h>\n";
+    }
+    auto buffer = llvm::MemoryBuffer::getFile(result.fileName);
+    if (buffer && !llvm::StringRef(result.fileName).endswith(".ast")) {
+        llvm::StringRef contents = (*buffer)->getBuffer();
+        llvm::outs() << contents.take_front(
+                            Lexer::ComputePreamble(contents, LangOptions())
+                                .Size)
+                     << "\n";
+    }
+    for (const auto &it : result.functions) {
+        llvm::outs() << "\n" << it.code;
+    }
+}
+
+//! Print the output gathered for a source file and write its entries to the
+//! output file, then release it
+//! \param[in,out] result Result to report
+//! \param[in] emitter Output file, if any
+//! \return false if no Computation could be built from the file
+bool reportFileResult(FileResult &result, ComputationEmitter *emitter) {
+    llvm::errs() << "\nProcessing: " << result.fileName << "\n";
+    if (result.status == 0 && result.functions.empty() &&
+        result.failures.empty()) {
+        llvm::errs() << "No valid functions found for processing!\n";
+        return false;
+    }
+    // entries are written here, rather than as functions finish, so that
+    // they come out in the same order however the work is divided
+    if (emitter) {
+        for (const auto &it : result.functions) {
+            emitter->write(it.emitted);
+        }
+    }
+    for (const auto &it : result.functions) {
+        if (!it.scheduleFailure.empty()) {
+            llvm::errs() << "Kept source-order schedules for '"
+                         << it.functionName << "': " << it.scheduleFailure
+                         << "\n";
+        }
+        if (it.numFusedLoops != 0) {
+            llvm::errs() << "Fused " << it.numFusedLoops
+                         << (it.numFusedLoops == 1 ? " pair" : " pairs")
+                         << " of loops in '" << it.functionName << "'\n";
+        }
+        if (it.numTiledBands != 0) {
+            llvm::errs() << "Tiled " << it.numTiledBands << " loop "
+                         << (it.numTiledBands == 1 ? "nest" : "nests")
+                         << " in '" << it.functionName << "'\n";
+        }
+        if (!it.tilingSkipped.empty()) {
+            llvm::errs() << "Did not tile '" << it.functionName
+                         << "': " << it.tilingSkipped << "\n";
+        }
+    }
+    if (PrintOutputToConsole) {
+        llvm::errs() << "=================================================\n\n";
+        std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+        for (const auto &it : result.functions) {
+            llvm::outs() << "FUNCTION: " << it.functionName << "\n";
+            Utils::printSmallLine();
+            llvm::outs() << "\n";
+            llvm::outs().flush();
+            it.computation->printInfo();
+        }
+    }
+    if (PrintDependences) {
+        for (const auto &it : result.functions) {
+            llvm::outs() << "DEPENDENCES: " << it.functionName << "\n";
+            Utils::printSmallLine();
+            llvm::outs() << it.dependences << "\n";
+        }
+    }
+    if (PrintLocality) {
+        for (const auto &it : result.functions) {
+            llvm::outs() << "LOCALITY: " << it.functionName << "\n";
+            Utils::printSmallLine();
+            llvm::outs() << it.locality << "\n";
+        }
+    }
+    if (PrintIntensity) {
+        for (const auto &it : result.functions) {
+            llvm::outs() << "INTENSITY: " << it.functionName << "\n";
+            Utils::printSmallLine();
+            llvm::outs() << it.intensity << "\n";
+        }
+    }
+    if (isGeneratingCode()) {
+        printGeneratedCode(result);
+    }
+    {
+        std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+        result.functions.clear();
+    }
+    return result.status == 0;
+}
+
+//! Used to locate the executable, and from it Clang's resource directory
+static void resourcesPathAnchor() {}
+
+//! Serve requests until standard input ends (or forever, on a socket)
+//! \param[in] optionsParser Parsed command line
+//! \param[in] hasFixedFlags Whether compile flags were given after "--"
+//! \param[in] argv0 Path the program was invoked by
+int runServer(CommonOptionsParser &optionsParser, bool hasFixedFlags,
+              const char *argv0) {
+    // with neither flags nor a source path, the parser has no compilation
+    // database to give
+    std::unique_ptr<CompilationDatabase> noFlags;
+    const CompilationDatabase *compilations;
+    if (hasFixedFlags || !optionsParser.getSourcePathList().empty()) {
+        compilations = &optionsParser.getCompilations();
+    } else {
+        noFlags = std::make_unique<FixedCompilationDatabase>(
+            ".", std::vector<std::string>());
+        compilations = noFlags.get();
+    }
+    ComputationServer server(
+        *compilations,
+        CompilerInvocation::GetResourcesPath(
+            argv0, reinterpret_cast<void *>(
+                       reinterpret_cast<intptr_t>(resourcesPathAnchor))));
+    if (!SocketPath.empty()) {
+        return server.serveUnixSocket(SocketPath);
+    }
+    server.serve(stdin, llvm::outs());
+    return 0;
+}
+
 }  // namespace spf_ie
 
 using namespace spf_ie;
@@ -95,9 +740,170 @@ static llvm::cl::OptionCategory SPFToolCategory("spf-ie options");
 //! Instantiate and run the Clang tool
 int main(int argc, const char **argv) {
     PrintOutputToConsole.addCategory(SPFToolCategory);
-    CommonOptionsParser OptionsParser(argc, argv, SPFToolCategory);
-    ClangTool Tool(OptionsParser.getCompilations(),
-                   OptionsParser.getSourcePathList());
+    NumJobs.addCategory(SPFToolCategory);
+    NumFunctionJobs.addCategory(SPFToolCategory);
+    CacheDir.addCategory(SPFToolCategory);
+    PreambleCacheDir.addCategory(SPFToolCategory);
+    FunctionFilter.addCategory(SPFToolCategory);
+    MainFileOnly.addCategory(SPFToolCategory);
+    PrintDependences.addCategory(SPFToolCategory);
+    PrintLocality.addCategory(SPFToolCategory);
+    PrintIntensity.addCategory(SPFToolCategory);
+    MachineBalance.addCategory(SPFToolCategory);
+    OptimizeSchedules.addCategory(SPFToolCategory);
+    FuseLoops.addCategory(SPFToolCategory);
+    TileSizes.addCategory(SPFToolCategory);
+    CodegenTarget.addCategory(SPFToolCategory);
+    KeepGoing.addCategory(SPFToolCategory);
+    EmitFormat.addCategory(SPFToolCategory);
+    OutputPath.addCategory(SPFToolCategory);
+    TimeReport.addCategory(SPFToolCategory);
+    TraceFile.addCategory(SPFToolCategory);
+    Server.addCategory(SPFToolCategory);
+    SocketPath.addCategory(SPFToolCategory);
+    bool hasFixedFlags = std::find_if(argv, argv + argc, [](const char *arg) {
+                             return llvm::StringRef(arg) == "--";
+                         }) != argv + argc;
+    // source files are optional in server mode, where requests name them
+    CommonOptionsParser OptionsParser(argc, argv, SPFToolCategory,
+                                      llvm::cl::ZeroOrMore);
+    if (Server) {
+        return runServer(OptionsParser, hasFixedFlags, argv[0]);
+    }
+    if (OptionsParser.getSourcePathList().empty()) {
+        llvm::errs() << "No source files given\n";
+        return 1;
+    }
+    std::string regexError;
+    if (!llvm::Regex(FunctionFilter).isValid(regexError)) {
+        llvm::errs() << "Invalid --function regular expression: " << regexError
+                     << "\n";
+        return 1;
+    }
+    if ((EmitFormat.getNumOccurrences() > 0) == OutputPath.empty()) {
+        llvm::errs() << "--emit and --output must be given together\n";
+        return 1;
+    }
+    // generated code follows the loops as written, and would silently drop
+    // rewritten schedules
+    if (OptimizeSchedules && isGeneratingCode()) {
+        llvm::errs() << "--optimize-schedules cannot be combined with "
+                        "--codegen\n";
+        return 1;
+    }
+    if (FuseLoops && isGeneratingCode()) {
+        llvm::errs() << "--fuse-loops cannot be combined with --codegen\n";
+        return 1;
+    }
+    if (TimeReport || !TraceFile.empty()) {
+        Instrumentation::enable(!TraceFile.empty());
+    }
+    llvm::parallel::strategy = llvm::hardware_concurrency(NumFunctionJobs);
+    const CompilationDatabase &compilations = OptionsParser.getCompilations();
+
+    std::vector<std::unique_ptr<FileResult>> results;
+    for (const auto &path : OptionsParser.getSourcePathList()) {
+        results.push_back(std::make_unique<FileResult>(path));
+    }
+    ToolServices services;
+    std::unique_ptr<ComputationCache> cache;
+    if (!CacheDir.empty()) {
+        cache = std::make_unique<ComputationCache>(CacheDir);
+        services.cache = cache.get();
+    }
+    std::unique_ptr<PreambleCache> preambles;
+    if (!PreambleCacheDir.empty()) {
+        preambles = std::make_unique<PreambleCache>(PreambleCacheDir);
+        services.preambles = preambles.get();
+    }
+    std::unique_ptr<ComputationEmitter> emitter;
+    if (!OutputPath.empty()) {
+        std::string error;
+        emitter = ComputationEmitter::create(EmitFormat, OutputPath, error);
+        if (!emitter) {
+            llvm::errs() << "Could not open output file '" << OutputPath
+                         << "': " << error << "\n";
+            return 1;
+        }
+        services.emitter = emitter.get();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool success = true;
+    if (NumJobs == 1) {
+        for (auto &result : results) {
+            processFile(compilations, *result, services);
+            success &= reportFileResult(*result, emitter.get());
+        }
+    } else {
+        // shard files across worker threads, but report them in input order
+        // as each becomes available
+        llvm::ThreadPool pool(llvm::heavyweight_hardware_concurrency(NumJobs));
+        std::vector<std::shared_future<void>> done;
+        for (auto &result : results) {
+            FileResult *resultPtr = result.get();
+            done.push_back(pool.async([&compilations, resultPtr, &services]() {
+                processFile(compilations, *resultPtr, services);
+            }));
+        }
+        for (unsigned int i = 0; i < results.size(); ++i) {
+            done[i].wait();
+            success &= reportFileResult(*results[i], emitter.get());
+        }
+    }
+    double totalTime = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+    // summarize per-file wall time
+    llvm::errs() << "\n";
+    for (const auto &result : results) {
+        llvm::errs() << llvm::format("%10.3fs  ", result->wallTime)
+                     << result->fileName << "\n";
+    }
+    llvm::errs() << llvm::format("%10.3fs  ", totalTime) << "total ("
+                 << results.size() << " files)\n";
+    unsigned int numFailures = 0;
+    for (const auto &result : results) {
+        numFailures += result->failures.size();
+    }
+    if (numFailures > 0) {
+        llvm::errs() << "\n"
+                     << numFailures << " function(s) could not be built:\n";
+        for (const auto &result : results) {
+            for (const auto &failure : result->failures) {
+                llvm::errs() << "  " << failure.location << ": "
+                             << failure.functionName << ": " << failure.message
+                             << "\n";
+            }
+        }
+    }
+    if (cache) {
+        llvm::errs() << "Computation cache: " << cache->getHits()
+                     << " hits, " << cache->getMisses() << " misses\n";
+    }
+    if (preambles) {
+        llvm::errs() << "Preamble cache: " << preambles->getHits()
+                     << " reused, " << preambles->getBuilds() << " built, "
+                     << preambles->getFailures() << " not precompiled\n";
+    }
+
+    if (TimeReport) {
+        llvm::errs() << "\n";
+        Instrumentation::printReport(llvm::errs());
+    }
+    if (!TraceFile.empty()) {
+        std::string error;
+        if (!Instrumentation::writeTrace(TraceFile, error)) {
+            llvm::errs() << "Could not write trace file '" << TraceFile
+                         << "': " << error << "\n";
+            success = false;
+        }
+    }
+    if (emitter && !emitter->ok()) {
+        llvm::errs() << "Error writing output file '" << OutputPath << "'\n";
+        success = false;
+    }
 
-    return Tool.run(newFrontendActionFactory<SPFFrontendAction>().get());
+    return success ? 0 : 1;
 }
@@ -1,45 +1,104 @@
 #include "ExecSchedule.hpp"
 
+#include <sstream>
 #include <string>
+#include <vector>
+
+#include "iegenlib.h"
 
 namespace spf_ie {
 
 /* ExecSchedule */
 
-ExecSchedule::ExecSchedule(const ExecSchedule &other) {
-    scheduleTuple = other.scheduleTuple;
+void ExecSchedule::pushValue(ScheduleVal value) {
+    if (value.valueIsVar) {
+        numIterators++;
+    }
+    scheduleTuple.push_back(value);
 }
 
-void ExecSchedule::pushValue(ScheduleVal value) {
-    scheduleTuple.push_back(std::make_shared<ScheduleVal>(value));
+void ExecSchedule::pushIterator() {
+    pushValue(ScheduleVal::makeVar(numIterators));
 }
 
 ScheduleVal ExecSchedule::popValue() {
-    ScheduleVal value = *scheduleTuple.back();
-    scheduleTuple.pop_back();
+    ScheduleVal value = scheduleTuple.pop_back_val();
+    if (value.valueIsVar) {
+        numIterators--;
+    }
     return value;
 }
 
 void ExecSchedule::advanceSchedule() {
-    if (scheduleTuple.empty() || scheduleTuple.back()->valueIsVar) {
-        scheduleTuple.push_back(std::make_shared<ScheduleVal>(0));
+    if (scheduleTuple.empty() || scheduleTuple.back().valueIsVar) {
+        scheduleTuple.push_back(ScheduleVal(0));
     } else {
-        std::shared_ptr<ScheduleVal> top = scheduleTuple.back();
-        scheduleTuple.pop_back();
-        scheduleTuple.push_back(std::make_shared<ScheduleVal>(top->num + 1));
+        scheduleTuple.back().value++;
     }
 }
 
 void ExecSchedule::zeroPadDimension(int dim) {
-    for (int i = getDimension(); i < dim; ++i) {
-        scheduleTuple.push_back(std::make_shared<ScheduleVal>(0));
+    if (dim > getDimension()) {
+        scheduleTuple.resize(dim, ScheduleVal(0));
     }
 }
 
-/* ScheduleVal */
-
-ScheduleVal::ScheduleVal(std::string var) : var(var), valueIsVar(true) {}
+std::string ExecSchedule::toString(
+    const std::vector<std::string> &iterators) const {
+    std::ostringstream os;
+    os << "{[";
+    for (unsigned int i = 0; i < iterators.size(); ++i) {
+        if (i != 0) {
+            os << ",";
+        }
+        os << iterators[i];
+    }
+    os << "]->[";
+    for (unsigned int i = 0; i < scheduleTuple.size(); ++i) {
+        if (i != 0) {
+            os << ",";
+        }
+        if (scheduleTuple[i].valueIsVar) {
+            os << iterators[scheduleTuple[i].value];
+        } else {
+            os << scheduleTuple[i].value;
+        }
+    }
+    os << "]}";
+    return os.str();
+}
 
-ScheduleVal::ScheduleVal(int num) : num(num), valueIsVar(false) {}
+iegenlib::Relation *ExecSchedule::toRelation(
+    const std::vector<std::string> &iterators) const {
+    unsigned int inArity = iterators.size();
+    unsigned int outArity = scheduleTuple.size();
+    iegenlib::TupleDecl tupleDecl(inArity + outArity);
+    for (unsigned int i = 0; i < inArity; ++i) {
+        tupleDecl.setTupleElem(i, iterators[i]);
+    }
+    for (unsigned int i = 0; i < outArity; ++i) {
+        if (scheduleTuple[i].valueIsVar) {
+            tupleDecl.setTupleElem(inArity + i,
+                                   iterators[scheduleTuple[i].value]);
+        } else {
+            tupleDecl.setTupleElem(inArity + i, scheduleTuple[i].value);
+        }
+    }
+    iegenlib::Conjunction *conjunction =
+        new iegenlib::Conjunction(tupleDecl, inArity);
+    // output iterator positions are equal to their input counterparts
+    for (unsigned int i = 0; i < outArity; ++i) {
+        if (scheduleTuple[i].valueIsVar) {
+            iegenlib::Exp *equality = new iegenlib::Exp();
+            equality->addTerm(new iegenlib::TupleVarTerm(inArity + i));
+            equality->addTerm(
+                new iegenlib::TupleVarTerm(-1, scheduleTuple[i].value));
+            conjunction->addEquality(equality);
+        }
+    }
+    iegenlib::Relation *relation = new iegenlib::Relation(inArity, outArity);
+    relation->addConjunction(conjunction);
+    return relation;
+}
 
 }  // namespace spf_ie
@@ -0,0 +1,170 @@
+#include "Instrumentation.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace spf_ie {
+
+/* Instrumentation */
+
+void Instrumentation::enable(bool trace) {
+    origin = std::chrono::steady_clock::now();
+    tracing = trace;
+    enabled = true;
+}
+
+void Instrumentation::recordPhase(Phase phase, llvm::StringRef detail,
+                                  std::chrono::steady_clock::time_point start,
+                                  std::chrono::steady_clock::time_point end) {
+    int index = static_cast<int>(phase);
+    phaseNanos[index].fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count(),
+        std::memory_order_relaxed);
+    phaseCounts[index].fetch_add(1, std::memory_order_relaxed);
+    if (tracing.load(std::memory_order_relaxed) && isTraced(phase)) {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        TraceEvent event = {
+            phase, detail.str(), llvm::get_threadid(),
+            duration_cast<microseconds>(start - origin).count(),
+            duration_cast<microseconds>(end - start).count()};
+        std::lock_guard<std::mutex> lock(traceMutex);
+        traceEvents.push_back(std::move(event));
+    }
+}
+
+void Instrumentation::printReport(llvm::raw_ostream& os) {
+    os << "===---------------------------------------------------------===\n"
+       << "                      spf-ie time report\n"
+       << "===---------------------------------------------------------===\n"
+       << "  Total time  Occurrences  Phase (times are inclusive)\n";
+    for (int i = 0; i < static_cast<int>(Phase::NumPhases); ++i) {
+        os << llvm::format("%11.3fs  %11llu  ", phaseNanos[i].load() / 1e9,
+                           (unsigned long long)phaseCounts[i].load())
+           << getPhaseName(static_cast<Phase>(i)) << "\n";
+    }
+    os << "\n       Count  Counter\n";
+    for (int i = 0; i < static_cast<int>(Counter::NumCounters); ++i) {
+        os << llvm::format("%12llu  ", (unsigned long long)counters[i].load())
+           << getCounterName(static_cast<Counter>(i)) << "\n";
+    }
+}
+
+bool Instrumentation::writeTrace(llvm::StringRef path, std::string& error) {
+    std::error_code EC;
+    llvm::raw_fd_ostream os(path, EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        error = EC.message();
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(traceMutex);
+    llvm::json::OStream J(os);
+    J.object([&] {
+        J.attributeArray("traceEvents", [&] {
+            for (const auto& event : traceEvents) {
+                J.object([&] {
+                    J.attribute("name", getPhaseName(event.phase));
+                    J.attribute("cat", "spf-ie");
+                    J.attribute("ph", "X");
+                    J.attribute("pid", 1);
+                    J.attribute("tid", static_cast<int64_t>(event.threadID));
+                    J.attribute("ts", event.start);
+                    J.attribute("dur", event.duration);
+                    if (!event.detail.empty()) {
+                        J.attributeObject("args", [&] {
+                            J.attribute("detail", event.detail);
+                        });
+                    }
+                });
+            }
+        });
+        J.attribute("displayTimeUnit", "ms");
+    });
+    os << "\n";
+    os.flush();
+    if (os.has_error()) {
+        error = os.error().message();
+        os.clear_error();
+        return false;
+    }
+    return true;
+}
+
+const char* Instrumentation::getPhaseName(Phase phase) {
+    switch (phase) {
+        case Phase::TranslationUnit:
+            return "translation unit";
+        case Phase::Parse:
+            return "parse";
+        case Phase::Function:
+            return "function";
+        case Phase::ProcessBody:
+            return "process body";
+        case Phase::BuildStmts:
+            return "build iegenlib statements";
+        case Phase::AccessStrings:
+            return "build access strings";
+        case Phase::CheckComplete:
+            return "check completeness";
+        case Phase::Dependences:
+            return "dependence analysis";
+        case Phase::Locality:
+            return "locality analysis";
+        case Phase::Intensity:
+            return "intensity estimate";
+        case Phase::Schedule:
+            return "optimize schedules";
+        case Phase::CodeGen:
+            return "generate code";
+        case Phase::Emit:
+            return "emit output";
+        default:
+            return "unknown";
+    }
+}
+
+bool Instrumentation::isTraced(Phase phase) {
+    return phase != Phase::AccessStrings;
+}
+
+const char* Instrumentation::getCounterName(Counter counter) {
+    switch (counter) {
+        case Counter::Statements:
+            return "statements";
+        case Counter::Accesses:
+            return "data accesses";
+        case Counter::Constraints:
+            return "iteration space constraints";
+        case Counter::ReplacementVars:
+            return "replacement variables";
+        default:
+            return "unknown";
+    }
+}
+
+std::atomic<bool> Instrumentation::enabled(false);
+std::atomic<bool> Instrumentation::tracing(false);
+std::chrono::steady_clock::time_point Instrumentation::origin;
+std::atomic<uint64_t>
+    Instrumentation::phaseNanos[static_cast<int>(Phase::NumPhases)];
+std::atomic<uint64_t>
+    Instrumentation::phaseCounts[static_cast<int>(Phase::NumPhases)];
+std::atomic<uint64_t>
+    Instrumentation::counters[static_cast<int>(Counter::NumCounters)];
+std::mutex Instrumentation::traceMutex;
+std::vector<Instrumentation::TraceEvent> Instrumentation::traceEvents;
+
+}  // namespace spf_ie
@@ -0,0 +1,193 @@
+#include "IntensityEstimator.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DataAccessHandler.hpp"
+#include "LocalityAnalysis.hpp"
+#include "StmtContext.hpp"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/* TrafficEstimate */
+
+double TrafficEstimate::getIntensity() const {
+    uint64_t bytes = bytesRead + bytesWritten;
+    return bytes == 0 ? 0 : static_cast<double>(operations) / bytes;
+}
+
+/* IntensityReport */
+
+std::string IntensityReport::toString(double machineBalance) const {
+    std::vector<const TrafficEstimate*> rows;
+    int width = 0;
+    for (const auto* estimates : {&stmts, &nests}) {
+        for (const auto& estimate : *estimates) {
+            rows.push_back(&estimate);
+            width = std::max<int>(width, estimate.label.size());
+        }
+    }
+
+    std::ostringstream os;
+    os << std::left << std::setw(width) << "" << std::right << std::setw(12)
+       << "bytes read" << std::setw(15) << "bytes written" << std::setw(6)
+       << "ops" << std::setw(10) << "ops/byte" << "\n";
+    for (const TrafficEstimate* row : rows) {
+        double intensity = row->getIntensity();
+        os << std::left << std::setw(width) << row->label << std::right
+           << std::setw(12) << row->bytesRead << std::setw(15)
+           << row->bytesWritten << std::setw(6) << row->operations
+           << std::setw(10) << std::fixed << std::setprecision(2)
+           << intensity;
+        if (machineBalance > 0) {
+            os << (intensity < machineBalance ? "  memory-bound"
+                                              : "  compute-bound");
+        }
+        os << "\n";
+    }
+    return os.str();
+}
+
+/* IntensityEstimator */
+
+IntensityEstimator::IntensityEstimator(
+    const std::vector<StmtContext>& stmtContexts, BuilderSession& session)
+    : stmtContexts(stmtContexts), session(session) {}
+
+IntensityReport IntensityEstimator::estimate() {
+    // which accesses of each statement touch the same element throughout
+    // its innermost loop
+    LocalityReport locality = LocalityAnalysis(stmtContexts, session).analyze();
+    std::vector<std::vector<bool>> isInvariant;
+    for (const auto& stmtContext : stmtContexts) {
+        isInvariant.emplace_back(
+            stmtContext.dataAccesses.arrayAccesses.size(), false);
+    }
+    for (const auto& loop : locality.getLoops()) {
+        for (const auto& access : loop.accesses) {
+            isInvariant[access.stmt][access.accessIndex] =
+                access.kind == AccessLocality::Kind::Invariant;
+        }
+    }
+
+    IntensityReport report;
+    std::vector<const Scope*> outermostLoops;
+    std::vector<unsigned int> depths;
+    for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+         ++stmtIndex) {
+        TrafficEstimate estimate =
+            estimateStmt(stmtIndex, isInvariant[stmtIndex], false);
+        if (estimate.bytesRead != 0 || estimate.bytesWritten != 0 ||
+            estimate.operations != 0) {
+            report.addStmt(estimate);
+        }
+        const Scope* outermost = nullptr;
+        unsigned int depth = 0;
+        for (const Scope* scope = stmtContexts[stmtIndex].scope.get(); scope;
+             scope = scope->parent.get()) {
+            if (scope->kind == Scope::Kind::Loop) {
+                outermost = scope;
+                depth++;
+            }
+        }
+        outermostLoops.push_back(outermost);
+        depths.push_back(depth);
+    }
+
+    std::vector<const Scope*> nests;
+    for (const Scope* outermost : outermostLoops) {
+        if (outermost &&
+            std::find(nests.begin(), nests.end(), outermost) == nests.end()) {
+            nests.push_back(outermost);
+        }
+    }
+    for (const Scope* nest : nests) {
+        unsigned int maxDepth = 0;
+        for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+             ++stmtIndex) {
+            if (outermostLoops[stmtIndex] == nest) {
+                maxDepth = std::max(maxDepth, depths[stmtIndex]);
+            }
+        }
+        TrafficEstimate total;
+        total.label = "loop " + nest->iterator;
+        for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+             ++stmtIndex) {
+            if (outermostLoops[stmtIndex] != nest ||
+                depths[stmtIndex] != maxDepth) {
+                continue;
+            }
+            TrafficEstimate estimate =
+                estimateStmt(stmtIndex, isInvariant[stmtIndex], true);
+            total.bytesRead += estimate.bytesRead;
+            total.bytesWritten += estimate.bytesWritten;
+            total.operations += estimate.operations;
+        }
+        report.addNest(total);
+    }
+    return report;
+}
+
+TrafficEstimate IntensityEstimator::estimateStmt(
+    unsigned int stmtIndex, const std::vector<bool>& isInvariant,
+    bool isSteadyState) const {
+    const StmtContext& stmtContext = stmtContexts[stmtIndex];
+    const auto& accesses = stmtContext.dataAccesses.arrayAccesses;
+    TrafficEstimate estimate;
+    estimate.label = "S" + std::to_string(stmtIndex);
+    // an element read (or written) twice by one statement moves once
+    std::set<std::pair<std::string, bool>> seen;
+    for (unsigned int i = 0; i < accesses.size(); ++i) {
+        const ArrayAccess& access = accesses[i].second;
+        if (!seen.emplace(accesses[i].first, access.isRead).second ||
+            (isSteadyState && isInvariant[i])) {
+            continue;
+        }
+        auto dataSpace = stmtContext.dataAccesses.dataSpaces.find(
+            session.getSPFString(access.base));
+        uint64_t size = dataSpace == stmtContext.dataAccesses.dataSpaces.end()
+                            ? 0
+                            : dataSpace->second.elementSize;
+        if (access.isRead) {
+            estimate.bytesRead += size;
+        } else {
+            estimate.bytesWritten += size;
+        }
+    }
+    estimate.operations = countOperations(stmtContext.stmt);
+    return estimate;
+}
+
+unsigned int IntensityEstimator::countOperations(const Stmt* stmt) {
+    // subscripts compute addresses, not values
+    if (!stmt || isa<ArraySubscriptExpr>(stmt)) {
+        return 0;
+    }
+    unsigned int count = 0;
+    if (const BinaryOperator* asBinOper = dyn_cast<BinaryOperator>(stmt)) {
+        BinaryOperatorKind oper = asBinOper->getOpcode();
+        if (asBinOper->isCompoundAssignmentOp()) {
+            oper = BinaryOperator::getOpForCompoundAssignment(oper);
+        }
+        if (BinaryOperator::isMultiplicativeOp(oper) ||
+            BinaryOperator::isAdditiveOp(oper)) {
+            count++;
+        }
+    }
+    for (const Stmt* child : stmt->children()) {
+        count += countOperations(child);
+    }
+    return count;
+}
+
+}  // namespace spf_ie
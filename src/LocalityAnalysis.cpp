@@ -0,0 +1,243 @@
+#include "LocalityAnalysis.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "DataAccessHandler.hpp"
+#include "StmtContext.hpp"
+#include "clang/AST/Stmt.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+//! Check whether an expression mentions an iterator, including within
+//! uninterpreted function arguments
+static bool hasIterator(const AffineExpr& expr, unsigned int iteratorIndex) {
+    for (const auto& term : expr.getTerms()) {
+        if (term.kind == AffineTerm::Kind::Iterator &&
+            term.iteratorIndex == iteratorIndex) {
+            return true;
+        }
+        for (const auto& arg : term.args) {
+            if (hasIterator(*arg, iteratorIndex)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//! Check whether a string consists only of characters matching a predicate
+template <typename Predicate>
+static bool consistsOf(const std::string& str, Predicate predicate) {
+    return !str.empty() && std::all_of(str.begin(), str.end(), predicate);
+}
+
+/* AccessLocality */
+
+std::string AccessLocality::toString() const {
+    std::ostringstream os;
+    os << "S" << stmt << " " << (isRead ? "read" : "write") << " " << access
+       << ": " << kindToString(kind);
+    if (kind == Kind::Strided && !stride.empty()) {
+        os << " " << stride;
+    } else if (kind == Kind::Unit && stride == "-1") {
+        os << ", backwards";
+    }
+    if (isColumnWalk) {
+        os << ", column walk";
+    }
+    return os.str();
+}
+
+std::string AccessLocality::kindToString(Kind kind) {
+    switch (kind) {
+        case Kind::Invariant:
+            return "stride-0";
+        case Kind::Unit:
+            return "unit-stride";
+        case Kind::Strided:
+            return "constant-stride";
+        case Kind::Gather:
+            return "gather";
+    }
+    return "";
+}
+
+/* LocalityReport */
+
+void LocalityReport::addAccess(const AccessLocality& access, ForStmt* loop,
+                               const std::string& iterator,
+                               unsigned int level) {
+    auto it = std::find_if(
+        loops.begin(), loops.end(),
+        [loop](const LoopLocality& existing) { return existing.loop == loop; });
+    if (it == loops.end()) {
+        loops.push_back({loop, iterator, level, {}});
+        it = loops.end() - 1;
+    }
+    it->accesses.push_back(access);
+}
+
+std::string LocalityReport::toString() const {
+    std::ostringstream os;
+    for (const auto& loop : loops) {
+        os << "loop " << loop.iterator << " (level " << loop.level << "):\n";
+        for (const auto& access : loop.accesses) {
+            os << "  " << access.toString() << "\n";
+        }
+    }
+    return os.str();
+}
+
+/* LocalityAnalysis */
+
+LocalityAnalysis::LocalityAnalysis(const std::vector<StmtContext>& stmtContexts,
+                                   BuilderSession& session)
+    : stmtContexts(stmtContexts), session(session) {}
+
+LocalityReport LocalityAnalysis::analyze() {
+    LocalityReport report;
+    for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+         ++stmtIndex) {
+        const StmtContext& stmtContext = stmtContexts[stmtIndex];
+        const Scope* loop = stmtContext.scope.get();
+        while (loop && loop->kind != Scope::Kind::Loop) {
+            loop = loop->parent.get();
+        }
+        if (!loop) {
+            continue;
+        }
+        std::vector<std::string> iterators = stmtContext.getIterators();
+        const auto& accesses = stmtContext.dataAccesses.arrayAccesses;
+        for (unsigned int i = 0; i < accesses.size(); ++i) {
+            AccessLocality locality =
+                classify(accesses[i].second, iterators, iterators.size() - 1);
+            locality.stmt = stmtIndex;
+            locality.accessIndex = i;
+            locality.access = accesses[i].first;
+            report.addAccess(locality, cast<ForStmt>(loop->origin),
+                             loop->iterator, iterators.size());
+        }
+    }
+    return report;
+}
+
+AccessLocality LocalityAnalysis::classify(
+    const ArrayAccess& access, const std::vector<std::string>& iterators,
+    unsigned int iteratorIndex) {
+    AccessLocality locality;
+    locality.isRead = access.isRead;
+    locality.kind = AccessLocality::Kind::Gather;
+
+    std::vector<int> coefficients;
+    for (Expr* index : access.indexes) {
+        AffineExpr subscript;
+        if (!AffineExpr::tryFromExpr(index, iterators, session, subscript)) {
+            return locality;
+        }
+        int coefficient = 0;
+        for (const auto& term : subscript.getTerms()) {
+            if (term.kind == AffineTerm::Kind::Iterator &&
+                term.iteratorIndex == iteratorIndex) {
+                coefficient = term.coefficient;
+            } else if (term.kind == AffineTerm::Kind::UFCall &&
+                       std::any_of(term.args.begin(), term.args.end(),
+                                   [iteratorIndex](const auto& arg) {
+                                       return hasIterator(*arg, iteratorIndex);
+                                   })) {
+                return locality;
+            }
+        }
+        coefficients.push_back(coefficient);
+    }
+
+    if (std::all_of(coefficients.begin(), coefficients.end(),
+                    [](int coefficient) { return coefficient == 0; })) {
+        locality.kind = AccessLocality::Kind::Invariant;
+        locality.stride = "0";
+        return locality;
+    }
+    locality.isColumnWalk =
+        std::any_of(coefficients.begin(), coefficients.end() - 1,
+                    [](int coefficient) { return coefficient != 0; });
+    // arrays declared some other way, like through pointers, leave the
+    // extents unknown
+    std::vector<std::string> extents;
+    if (!DataAccessHandler::getArrayExtents(access.base, session, extents) ||
+        extents.size() != coefficients.size()) {
+        extents.clear();
+    }
+    locality.stride = makeStride(coefficients, extents);
+    locality.kind = !locality.isColumnWalk && std::abs(coefficients.back()) == 1
+                        ? AccessLocality::Kind::Unit
+                        : AccessLocality::Kind::Strided;
+    return locality;
+}
+
+std::string LocalityAnalysis::makeStride(
+    const std::vector<int>& coefficients,
+    const std::vector<std::string>& extents) {
+    // each dimension moves by its coefficient times the product of the
+    // extents after it; numeric extents are folded into the coefficient
+    int64_t constant = 0;
+    std::vector<std::pair<int64_t, std::string>> terms;
+    for (unsigned int dim = 0; dim < coefficients.size(); ++dim) {
+        if (coefficients[dim] == 0) {
+            continue;
+        }
+        int64_t factor = coefficients[dim];
+        std::string product;
+        for (unsigned int inner = dim + 1; inner < coefficients.size();
+             ++inner) {
+            if (inner >= extents.size() || extents[inner].empty()) {
+                return "";
+            }
+            const std::string& extent = extents[inner];
+            if (consistsOf(extent, [](char c) { return isdigit(c); })) {
+                factor *= std::stoll(extent);
+                continue;
+            }
+            product += product.empty() ? "" : "*";
+            product += consistsOf(extent,
+                                  [](char c) { return isalnum(c) || c == '_'; })
+                           ? extent
+                           : "(" + extent + ")";
+        }
+        if (product.empty()) {
+            constant += factor;
+        } else if (factor != 0) {
+            terms.emplace_back(factor, product);
+        }
+    }
+
+    std::ostringstream os;
+    for (unsigned int i = 0; i < terms.size(); ++i) {
+        int64_t factor = terms[i].first;
+        if (i == 0) {
+            os << (factor < 0 ? "-" : "");
+        } else {
+            os << (factor < 0 ? " - " : " + ");
+        }
+        if (std::abs(factor) != 1) {
+            os << std::abs(factor) << "*";
+        }
+        os << terms[i].second;
+    }
+    if (terms.empty()) {
+        os << constant;
+    } else if (constant != 0) {
+        os << (constant < 0 ? " - " : " + ") << std::abs(constant);
+    }
+    return os.str();
+}
+
+}  // namespace spf_ie
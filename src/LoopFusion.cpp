@@ -0,0 +1,177 @@
+#include "LoopFusion.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DependenceAnalysis.hpp"
+#include "ExecSchedule.hpp"
+#include "StmtContext.hpp"
+#include "Utils.hpp"
+#include "iegenlib.h"
+
+namespace spf_ie {
+
+/* LoopFusion */
+
+LoopFusion::LoopFusion(const std::vector<StmtContext>& stmtContexts,
+                       BuilderSession& session)
+    : stmtContexts(stmtContexts), session(session) {}
+
+unsigned int LoopFusion::fuse(iegenlib::Computation* computation) {
+    schedules.clear();
+    loops.clear();
+    for (const auto& stmtContext : stmtContexts) {
+        schedules.push_back(stmtContext.schedule);
+        loops.emplace_back();
+        for (const Scope* scope = stmtContext.scope.get(); scope;
+             scope = scope->parent.get()) {
+            if (scope->kind == Scope::Kind::Loop) {
+                loops.back().push_back(scope);
+            }
+        }
+        std::reverse(loops.back().begin(), loops.back().end());
+    }
+    DependenceAnalysis analysis(stmtContexts, session);
+    analysis.analyze();
+
+    // every fusion moves statements, so start over after each one; outer
+    // loops come first, so the loops nested in them can be fused next
+    unsigned int numFused = 0;
+    bool hasFused = true;
+    while (hasFused) {
+        hasFused = false;
+        for (unsigned int depth = 0; !hasFused; ++depth) {
+            bool hasLoops = false;
+            for (unsigned int stmtIndex = 0;
+                 stmtIndex < stmtContexts.size() && !hasFused; ++stmtIndex) {
+                if (depth < loops[stmtIndex].size()) {
+                    hasLoops = true;
+                    hasFused = tryFuse(stmtIndex, depth, analysis);
+                }
+            }
+            if (!hasLoops) {
+                break;
+            }
+        }
+        if (hasFused) {
+            numFused++;
+        }
+    }
+
+    if (numFused != 0) {
+        std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+        for (unsigned int i = 0; i < schedules.size(); ++i) {
+            computation->getStmt(i)->setExecutionSchedule(
+                schedules[i].toRelation(stmtContexts[i].getIterators()));
+        }
+    }
+    return numFused;
+}
+
+bool LoopFusion::tryFuse(unsigned int stmtIndex, unsigned int depth,
+                         const DependenceAnalysis& analysis) {
+    // a loop at this depth holds position 2 * depth of its statements'
+    // schedules, followed by its iterator
+    unsigned int position = 2 * depth;
+    int loopPosition = schedules[stmtIndex].scheduleTuple[position].value;
+    std::vector<unsigned int> firstStmts;
+    std::vector<unsigned int> secondStmts;
+    for (unsigned int i = 0; i < schedules.size(); ++i) {
+        if (schedules[i].getDimension() <= position + 1 ||
+            !haveSamePrefix(i, stmtIndex, position)) {
+            continue;
+        }
+        int otherPosition = schedules[i].scheduleTuple[position].value;
+        if (otherPosition == loopPosition) {
+            firstStmts.push_back(i);
+        } else if (otherPosition == loopPosition + 1) {
+            // the next thing in the body must be a loop, not a statement
+            if (!schedules[i].scheduleTuple[position + 1].valueIsVar) {
+                return false;
+            }
+            secondStmts.push_back(i);
+        }
+    }
+    if (secondStmts.empty()) {
+        return false;
+    }
+
+    // the loops must cover the same iterations, under the same guards
+    const Scope* firstLoop = loops[firstStmts.front()][depth];
+    const Scope* secondLoop = loops[secondStmts.front()][depth];
+    if (!haveSameBounds(firstLoop, secondLoop, depth)) {
+        return false;
+    }
+    const Scope* firstParent = firstLoop->parent.get();
+    const Scope* secondParent = secondLoop->parent.get();
+    if (((firstParent && firstParent->kind == Scope::Kind::Guard) ||
+         (secondParent && secondParent->kind == Scope::Kind::Guard)) &&
+        firstParent != secondParent) {
+        return false;
+    }
+
+    for (unsigned int first : firstStmts) {
+        for (unsigned int second : secondStmts) {
+            if (analysis.preventsFusion(first, second, depth + 1)) {
+                return false;
+            }
+        }
+    }
+
+    // move the second loop's body after the first's, then close the gap it
+    // leaves behind
+    int bodyLength = 0;
+    for (unsigned int first : firstStmts) {
+        bodyLength = std::max(
+            bodyLength,
+            schedules[first].scheduleTuple[position + 2].value + 1);
+    }
+    for (unsigned int second : secondStmts) {
+        schedules[second].scheduleTuple[position].value = loopPosition;
+        schedules[second].scheduleTuple[position + 2].value += bodyLength;
+    }
+    for (unsigned int i = 0; i < schedules.size(); ++i) {
+        if (schedules[i].getDimension() > position &&
+            haveSamePrefix(i, stmtIndex, position) &&
+            schedules[i].scheduleTuple[position].value > loopPosition + 1) {
+            schedules[i].scheduleTuple[position].value--;
+        }
+    }
+    return true;
+}
+
+bool LoopFusion::haveSamePrefix(unsigned int first, unsigned int second,
+                                unsigned int length) const {
+    for (unsigned int i = 0; i < length; ++i) {
+        const ScheduleVal& firstVal = schedules[first].scheduleTuple[i];
+        const ScheduleVal& secondVal = schedules[second].scheduleTuple[i];
+        if (firstVal.valueIsVar != secondVal.valueIsVar ||
+            firstVal.value != secondVal.value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LoopFusion::haveSameBounds(const Scope* first, const Scope* second,
+                                unsigned int depth) {
+    if (first->constraints.size() != second->constraints.size()) {
+        return false;
+    }
+    // iterators are compared by position, since the loops' own may differ
+    std::vector<std::string> names;
+    for (unsigned int i = 0; i <= depth; ++i) {
+        names.push_back("t" + std::to_string(i));
+    }
+    for (unsigned int i = 0; i < first->constraints.size(); ++i) {
+        if (first->constraints[i].toString(names) !=
+            second->constraints[i].toString(names)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace spf_ie
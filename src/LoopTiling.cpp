@@ -0,0 +1,294 @@
+#include "LoopTiling.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "DependenceAnalysis.hpp"
+#include "StmtContext.hpp"
+#include "Utils.hpp"
+#include "iegenlib.h"
+
+namespace spf_ie {
+
+//! Check whether an expression mentions an iterator in a range of
+//! positions, including within uninterpreted function arguments
+static bool hasIteratorIn(const AffineExpr& expr, unsigned int first,
+                          unsigned int last) {
+    for (const auto& term : expr.getTerms()) {
+        if (term.kind == AffineTerm::Kind::Iterator &&
+            term.iteratorIndex >= first && term.iteratorIndex < last) {
+            return true;
+        }
+        for (const auto& arg : term.args) {
+            if (hasIteratorIn(*arg, first, last)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//! Get the scopes enclosing a statement, outermost first
+static std::vector<const Scope*> getScopeChain(const Scope* scope) {
+    std::vector<const Scope*> chain;
+    for (; scope; scope = scope->parent.get()) {
+        chain.push_back(scope);
+    }
+    std::reverse(chain.begin(), chain.end());
+    return chain;
+}
+
+/* TiledBand */
+
+std::string TiledBand::getTileIterator(unsigned int index) const {
+    return "tile_" + loops[index]->iterator;
+}
+
+/* LoopTiling */
+
+LoopTiling::LoopTiling(const std::vector<StmtContext>& stmtContexts,
+                       const DependenceGraph& dependences)
+    : stmtContexts(stmtContexts), dependences(dependences) {}
+
+unsigned int LoopTiling::tile(iegenlib::Computation* computation,
+                              const std::vector<unsigned int>& sizes) {
+    bands.clear();
+    schedules.clear();
+
+    // loops in source order, so outer loops are banded before inner ones
+    std::vector<std::pair<const Scope*, unsigned int>> loops;
+    for (const auto& stmtContext : stmtContexts) {
+        unsigned int level = 0;
+        for (const Scope* scope : getScopeChain(stmtContext.scope.get())) {
+            if (scope->kind != Scope::Kind::Loop) {
+                continue;
+            }
+            level++;
+            if (std::find(loops.begin(), loops.end(),
+                          std::make_pair(scope, level)) == loops.end()) {
+                loops.emplace_back(scope, level);
+            }
+        }
+    }
+    for (const auto& it : loops) {
+        const Scope* loop = it.first;
+        unsigned int level = it.second;
+        if (level > sizes.size() || sizes[level - 1] == 0) {
+            continue;
+        }
+        // a loop in a band, or nested in one, is not banded again
+        bool isBanded = false;
+        for (const Scope* scope = loop; scope && !isBanded;
+             scope = scope->parent.get()) {
+            for (const auto& band : bands) {
+                if (std::find(band.loops.begin(), band.loops.end(), scope) !=
+                    band.loops.end()) {
+                    isBanded = true;
+                }
+            }
+        }
+        if (isBanded) {
+            continue;
+        }
+        TiledBand band = findBand(loop, level, sizes);
+        while (band.loops.size() >= 2 && !isLegal(band)) {
+            band.loops.pop_back();
+            band.sizes.pop_back();
+        }
+        // tiling a lone loop would run its iterations in the same order
+        if (band.loops.size() >= 2) {
+            bands.push_back(band);
+        }
+    }
+    if (bands.empty()) {
+        return 0;
+    }
+
+    unsigned int dimension = 0;
+    for (const auto& stmtContext : stmtContexts) {
+        dimension = std::max<unsigned int>(
+            dimension, stmtContext.schedule.getDimension());
+    }
+    unsigned int numTileDims = 0;
+    for (const auto& band : bands) {
+        numTileDims = std::max<unsigned int>(numTileDims, band.loops.size());
+    }
+    for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+         ++stmtIndex) {
+        const TiledBand* stmtBand = nullptr;
+        for (const auto& band : bands) {
+            if (getDepthIn(stmtIndex, band) != 0) {
+                stmtBand = &band;
+            }
+        }
+        schedules.push_back(
+            buildSchedule(stmtIndex, stmtBand, dimension + numTileDims));
+    }
+
+    std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+    for (unsigned int i = 0; i < schedules.size(); ++i) {
+        computation->getStmt(i)->setExecutionSchedule(
+            new iegenlib::Relation(schedules[i]));
+    }
+    return bands.size();
+}
+
+TiledBand LoopTiling::findBand(const Scope* loop, unsigned int level,
+                               const std::vector<unsigned int>& sizes) const {
+    TiledBand band;
+    band.level = level;
+    band.loops.push_back(loop);
+    band.sizes.push_back(sizes[level - 1]);
+    while (level - 1 + band.loops.size() < sizes.size() &&
+           sizes[level - 1 + band.loops.size()] != 0) {
+        // the body must hold a single loop, directly, after any statements
+        const Scope* current = band.loops.back();
+        const Scope* inner = nullptr;
+        unsigned int firstInner = stmtContexts.size();
+        unsigned int lastInBody = 0;
+        bool hasBodyStmts = false;
+        bool isUnique = true;
+        for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+             ++stmtIndex) {
+            std::vector<const Scope*> chain =
+                getScopeChain(stmtContexts[stmtIndex].scope.get());
+            auto it = std::find(chain.begin(), chain.end(), current);
+            if (it == chain.end()) {
+                continue;
+            }
+            auto next = std::find_if(it + 1, chain.end(), [](const Scope* s) {
+                return s->kind == Scope::Kind::Loop;
+            });
+            if (next == chain.end()) {
+                hasBodyStmts = true;
+                lastInBody = stmtIndex;
+            } else if (!inner || inner == *next) {
+                inner = *next;
+                firstInner = std::min(firstInner, stmtIndex);
+            } else {
+                isUnique = false;
+            }
+        }
+        if (!inner || !isUnique || inner->parent.get() != current ||
+            (hasBodyStmts && lastInBody > firstInner)) {
+            break;
+        }
+        // and its bounds must not depend on the band's iterators
+        unsigned int firstIterator = level - 1;
+        unsigned int lastIterator = firstIterator + band.loops.size();
+        if (std::any_of(inner->constraints.begin(), inner->constraints.end(),
+                        [&](const Constraint& constraint) {
+                            return hasIteratorIn(constraint.lhs, firstIterator,
+                                                 lastIterator) ||
+                                   hasIteratorIn(constraint.rhs, firstIterator,
+                                                 lastIterator);
+                        })) {
+            break;
+        }
+        band.loops.push_back(inner);
+        band.sizes.push_back(sizes[level - 1 + band.loops.size() - 1]);
+    }
+    return band;
+}
+
+bool LoopTiling::isLegal(const TiledBand& band) const {
+    unsigned int first = band.level - 1;
+    unsigned int last = first + band.loops.size();
+    for (const auto& dependence : dependences.getDependences()) {
+        unsigned int sourceDepth = getDepthIn(dependence.source, band);
+        unsigned int sinkDepth = getDepthIn(dependence.sink, band);
+        if (sourceDepth == 0 || sinkDepth == 0 ||
+            (dependence.level != 0 && dependence.level <= first)) {
+            continue;
+        }
+        // nothing may go backwards at any level of the band once the loops
+        // are interchanged
+        for (unsigned int i = first;
+             i < last && i < dependence.direction.size(); ++i) {
+            if (dependence.direction[i] == '>' ||
+                dependence.direction[i] == '*') {
+                return false;
+            }
+        }
+        // a statement ahead of an inner loop runs in its first tile, before
+        // the later tiles of earlier iterations
+        if (dependence.level != 0 && sourceDepth > sinkDepth) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string LoopTiling::buildSchedule(unsigned int stmtIndex,
+                                      const TiledBand* band,
+                                      unsigned int dimension) const {
+    const StmtContext& stmtContext = stmtContexts[stmtIndex];
+    std::vector<std::string> iterators = stmtContext.getIterators();
+    std::vector<std::string> tuple;
+    for (const auto& val : stmtContext.schedule.scheduleTuple) {
+        tuple.push_back(val.valueIsVar ? iterators[val.value]
+                                       : std::to_string(val.value));
+    }
+
+    // tile dimensions go just ahead of the band's outermost iterator
+    std::vector<std::string> constraints;
+    if (band) {
+        unsigned int depthIn = getDepthIn(stmtIndex, *band);
+        std::vector<std::string> tiles;
+        for (unsigned int i = 0; i < band->loops.size(); ++i) {
+            if (i >= depthIn) {
+                tiles.push_back("0");
+                continue;
+            }
+            unsigned int iteratorIndex = band->level - 1 + i;
+            std::string tile = band->getTileIterator(i);
+            std::string size = std::to_string(band->sizes[i]);
+            // offset of the iteration from the start of the loop
+            std::string offset =
+                (AffineExpr::makeIterator(iterators[iteratorIndex],
+                                          iteratorIndex) -
+                 band->loops[i]->constraints[0].lhs)
+                    .toString(iterators);
+            constraints.push_back(size + "*" + tile + " <= " + offset);
+            constraints.push_back(offset + " < " + size + "*" + tile + " + " +
+                                  size);
+            tiles.push_back(tile);
+        }
+        tuple.insert(tuple.begin() + 2 * (band->level - 1) + 1,
+                     tiles.begin(), tiles.end());
+    }
+    tuple.resize(std::max<std::size_t>(tuple.size(), dimension), "0");
+
+    std::string schedule = "{[";
+    for (unsigned int i = 0; i < iterators.size(); ++i) {
+        schedule += (i == 0 ? "" : ",") + iterators[i];
+    }
+    schedule += "]->[";
+    for (unsigned int i = 0; i < tuple.size(); ++i) {
+        schedule += (i == 0 ? "" : ",") + tuple[i];
+    }
+    schedule += "]";
+    for (unsigned int i = 0; i < constraints.size(); ++i) {
+        schedule += (i == 0 ? ": " : " && ") + constraints[i];
+    }
+    return schedule + "}";
+}
+
+unsigned int LoopTiling::getDepthIn(unsigned int stmtIndex,
+                                    const TiledBand& band) const {
+    unsigned int depth = 0;
+    for (const Scope* scope = stmtContexts[stmtIndex].scope.get(); scope;
+         scope = scope->parent.get()) {
+        if (std::find(band.loops.begin(), band.loops.end(), scope) !=
+            band.loops.end()) {
+            depth++;
+        }
+    }
+    return depth;
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,315 @@
+#include "PreambleCache.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/FileSystemOptions.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/DependencyOutputOptions.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+using namespace clang::tooling;
+
+namespace spf_ie {
+
+/*!
+ * \class PreamblePCHAction
+ *
+ * \brief Precompiles a header to a given path, writing a Makefile-style list
+ * of everything it includes alongside
+ */
+class PreamblePCHAction : public GeneratePCHAction {
+   public:
+    PreamblePCHAction(std::string pchPath, std::string depPath)
+        : pchPath(pchPath), depPath(depPath) {}
+
+    bool BeginInvocation(CompilerInstance& CI) override {
+        CI.getFrontendOpts().OutputFile = pchPath;
+        DependencyOutputOptions& depOpts = CI.getDependencyOutputOpts();
+        depOpts.OutputFile = depPath;
+        depOpts.Targets = {pchPath};
+        // a changed system header invalidates the PCH just the same
+        depOpts.IncludeSystemHeaders = true;
+        return GeneratePCHAction::BeginInvocation(CI);
+    }
+
+   private:
+    std::string pchPath;
+    std::string depPath;
+};
+
+/*!
+ * \class PreamblePCHActionFactory
+ *
+ * \brief Creates PreamblePCHActions
+ */
+class PreamblePCHActionFactory : public FrontendActionFactory {
+   public:
+    PreamblePCHActionFactory(std::string pchPath, std::string depPath)
+        : pchPath(pchPath), depPath(depPath) {}
+    std::unique_ptr<FrontendAction> create() override {
+        return std::make_unique<PreamblePCHAction>(pchPath, depPath);
+    }
+
+   private:
+    std::string pchPath;
+    std::string depPath;
+};
+
+//! Read the prerequisites out of a Makefile-style dependency file, as
+//! written by Clang
+static std::vector<std::string> readDependencies(llvm::StringRef contents) {
+    std::vector<std::string> dependencies;
+    size_t colon = contents.find(": ");
+    if (colon == llvm::StringRef::npos) {
+        return dependencies;
+    }
+    std::string current;
+    for (size_t i = colon + 2; i < contents.size(); ++i) {
+        char c = contents[i];
+        char next = i + 1 < contents.size() ? contents[i + 1] : '\0';
+        if (c == '\\' && (next == ' ' || next == '#' || next == '\\')) {
+            // escaped character within a path
+            current.push_back(next);
+            ++i;
+        } else if (c == '$' && next == '$') {
+            current.push_back('$');
+            ++i;
+        } else if (c == '\\' && (next == '\n' || next == '\r')) {
+            // line continuation
+            continue;
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (!current.empty()) {
+                dependencies.push_back(current);
+                current.clear();
+            }
+        } else {
+            current.push_back(c);
+        }
+    }
+    if (!current.empty()) {
+        dependencies.push_back(current);
+    }
+    return dependencies;
+}
+
+/* PreambleCache */
+
+PreambleCache::PreambleCache(std::string directory)
+    : directory(directory), hits(0), builds(0), failures(0) {
+    llvm::sys::fs::create_directories(directory);
+}
+
+PreambleCache::Preamble PreambleCache::get(
+    const CompilationDatabase& compilations, const std::string& fileName) {
+    Preamble preamble;
+    std::vector<CompileCommand> commands =
+        compilations.getCompileCommands(fileName);
+    auto buffer = llvm::MemoryBuffer::getFile(fileName);
+    if (commands.empty() || !buffer) {
+        return preamble;
+    }
+    llvm::StringRef contents = (*buffer)->getBuffer();
+    PreambleBounds bounds = Lexer::ComputePreamble(contents, LangOptions());
+    if (bounds.Size == 0) {
+        return preamble;
+    }
+    llvm::StringRef preambleText = contents.take_front(bounds.Size);
+
+    llvm::SmallString<128> absolutePath(fileName);
+    llvm::sys::fs::make_absolute(absolutePath);
+    preamble.mainFilePath = std::string(absolutePath.str());
+    preamble.mainFileDir =
+        std::string(llvm::sys::path::parent_path(absolutePath));
+
+    // flags of the (first) command, minus the compiler and the file itself
+    const CompileCommand& command = commands.front();
+    std::vector<std::string> flags;
+    for (unsigned int i = 1; i < command.CommandLine.size(); ++i) {
+        if (command.CommandLine[i] != command.Filename) {
+            flags.push_back(command.CommandLine[i]);
+        }
+    }
+    // the header lives in the cache, so the file's own directory has to be
+    // searched explicitly for its quoted includes
+    flags.push_back("-iquote");
+    flags.push_back(preamble.mainFileDir);
+    bool isC = llvm::sys::path::extension(fileName) == ".c";
+
+    // separate components with NUL so that their boundaries are unambiguous
+    llvm::MD5 hash;
+    hash.update(getClangFullVersion());
+    hash.update(llvm::StringRef("\0", 1));
+    hash.update(command.Directory);
+    hash.update(llvm::StringRef("\0", 1));
+    hash.update(isC ? "c" : "c++");
+    hash.update(llvm::StringRef("\0", 1));
+    for (const auto& flag : flags) {
+        hash.update(flag);
+        hash.update(llvm::StringRef("\0", 1));
+    }
+    hash.update(preambleText);
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    std::string key(result.digest().str());
+
+    std::string pchPath = getPath(key, ".pch");
+    std::string depPath = getPath(key, ".d");
+    if (isUpToDate(pchPath, depPath)) {
+        hits++;
+    } else {
+        // the header is fully determined by the key, and rewriting it would
+        // invalidate PCHs other processes may be reading
+        std::string headerPath = getPath(key, isC ? ".h" : ".hpp");
+        if (!llvm::sys::fs::exists(headerPath) &&
+            !writeHeader(headerPath, preamble.mainFilePath, preambleText)) {
+            failures++;
+            return preamble;
+        }
+        flags.push_back("-x");
+        flags.push_back(isC ? "c-header" : "c++-header");
+        FixedCompilationDatabase headerCompilations(command.Directory, flags);
+        // a file system of its own keeps the tool from changing the
+        // process-wide working directory, which other files' jobs rely on
+        llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSystem(
+            llvm::vfs::createPhysicalFileSystem().release());
+        ClangTool tool(headerCompilations, {headerPath},
+                       std::make_shared<PCHContainerOperations>(), fileSystem);
+        if (!buildPCH(tool, pchPath, depPath)) {
+            failures++;
+            return preamble;
+        }
+        builds++;
+    }
+
+    preamble.pchPath = pchPath;
+    preamble.mainFileContents = contents.str();
+    for (unsigned int i = 0; i < bounds.Size; ++i) {
+        char& c = preamble.mainFileContents[i];
+        if (c != '\n' && c != '\r') {
+            c = ' ';
+        }
+    }
+    return preamble;
+}
+
+void PreambleCache::apply(ClangTool& tool, const Preamble& preamble) {
+    tool.mapVirtualFile(preamble.mainFilePath, preamble.mainFileContents);
+    tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(
+        {"-include-pch", preamble.pchPath, "-iquote", preamble.mainFileDir},
+        ArgumentInsertPosition::BEGIN));
+}
+
+std::unique_ptr<ASTUnit> PreambleCache::loadASTFile(const std::string& path) {
+    IntrusiveRefCntPtr<DiagnosticsEngine> diags =
+        CompilerInstance::createDiagnostics(new DiagnosticOptions());
+    auto pchContainerOps = std::make_shared<PCHContainerOperations>();
+    return ASTUnit::LoadFromASTFile(path, pchContainerOps->getRawReader(),
+                                    ASTUnit::LoadEverything, diags,
+                                    FileSystemOptions());
+}
+
+std::string PreambleCache::getPath(const std::string& key,
+                                   const std::string& extension) const {
+    llvm::SmallString<128> path(directory);
+    llvm::sys::path::append(path, key + extension);
+    return std::string(path.str());
+}
+
+bool PreambleCache::writeHeader(const std::string& headerPath,
+                                const std::string& mainFilePath,
+                                llvm::StringRef preambleText) {
+    // write to a temporary file and rename it into place, so that no one
+    // compiles a partial header
+    int fd;
+    llvm::SmallString<128> tempPath;
+    if (llvm::sys::fs::createUniqueFile(headerPath + ".tmp-%%%%%%%%", fd,
+                                        tempPath)) {
+        return false;
+    }
+    {
+        llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+        // report problems in the preamble against the original file
+        os << "#line 1 \"" << mainFilePath << "\"\n" << preambleText << "\n";
+    }
+    if (llvm::sys::fs::rename(tempPath, headerPath)) {
+        llvm::sys::fs::remove(tempPath);
+        return false;
+    }
+    return true;
+}
+
+bool PreambleCache::isUpToDate(const std::string& pchPath,
+                               const std::string& depPath) {
+    llvm::sys::fs::file_status pchStatus;
+    auto depBuffer = llvm::MemoryBuffer::getFile(depPath);
+    if (llvm::sys::fs::status(pchPath, pchStatus) || !depBuffer) {
+        return false;
+    }
+    std::vector<std::string> dependencies =
+        readDependencies((*depBuffer)->getBuffer());
+    if (dependencies.empty()) {
+        return false;
+    }
+    for (const auto& dependency : dependencies) {
+        llvm::sys::fs::file_status status;
+        if (llvm::sys::fs::status(dependency, status) ||
+            status.getLastModificationTime() >
+                pchStatus.getLastModificationTime()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PreambleCache::buildPCH(ClangTool& tool, const std::string& pchPath,
+                             const std::string& depPath) {
+    // write the dependency file under a temporary name, and only move it
+    // into place once the PCH is complete, so that a PCH is never used
+    // against a partial list
+    int fd;
+    llvm::SmallString<128> tempDepPath;
+    if (llvm::sys::fs::createUniqueFile(depPath + ".tmp-%%%%%%%%", fd,
+                                        tempDepPath)) {
+        return false;
+    }
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+    // don't compile to an object file, and keep the dependency file
+    tool.clearArgumentsAdjusters();
+    tool.appendArgumentsAdjuster(getClangStripOutputAdjuster());
+    tool.appendArgumentsAdjuster(getClangSyntaxOnlyAdjuster());
+    IgnoringDiagConsumer ignoreDiags;
+    tool.setDiagnosticConsumer(&ignoreDiags);
+    PreamblePCHActionFactory factory(pchPath, std::string(tempDepPath.str()));
+    if (tool.run(&factory) != 0 ||
+        llvm::sys::fs::rename(tempDepPath, depPath)) {
+        llvm::sys::fs::remove(tempDepPath);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace spf_ie
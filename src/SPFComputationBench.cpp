@@ -0,0 +1,163 @@
+/*!
+ * \file SPFComputationBench.cpp
+ *
+ * \brief Benchmarks of parsing and building Computations from generated
+ * kernels of configurable size and shape.
+ *
+ * Run with --benchmark_format=json (or --benchmark_out=<file>) to get results
+ * suitable for comparing between releases.
+ */
+#include <sys/resource.h>
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "SPFComputationBuilder.hpp"
+#include "Utils.hpp"
+#include "benchmark/benchmark.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/Tooling.h"
+#include "iegenlib.h"
+
+using namespace clang;
+using namespace spf_ie;
+
+/*!
+ * \struct KernelShape
+ *
+ * \brief Parameters of a generated kernel
+ */
+struct KernelShape {
+    //! Number of statements in the innermost loop
+    int numStmts;
+    //! Depth of the loop nest around the statements
+    int loopDepth;
+    //! Number of nested if statements guarding each statement
+    int numGuards;
+    //! Number of index arrays each read goes through, as in A[B[C[i]]]
+    int indirectionDepth;
+};
+
+//! Read a KernelShape from benchmark arguments
+static KernelShape getShape(const benchmark::State& state) {
+    return {static_cast<int>(state.range(0)), static_cast<int>(state.range(1)),
+            static_cast<int>(state.range(2)),
+            static_cast<int>(state.range(3))};
+}
+
+//! Generate C source for a function named "kernel" with the given shape
+static std::string generateKernel(const KernelShape& shape) {
+    std::ostringstream os;
+    os << "void kernel(int n, int* out, int* A";
+    for (int d = 0; d < shape.indirectionDepth; ++d) {
+        os << ", int* X" << d;
+    }
+    os << ") {\n";
+    for (int l = 0; l < shape.loopDepth; ++l) {
+        os << "for (int i" << l << " = 0; i" << l << " < n; i" << l
+           << "++) {\n";
+    }
+    std::string index =
+        shape.loopDepth > 0 ? "i" + std::to_string(shape.loopDepth - 1) : "n";
+    for (int s = 0; s < shape.numStmts; ++s) {
+        for (int g = 1; g <= shape.numGuards; ++g) {
+            os << "if (" << index << " >= " << g << ") {\n";
+        }
+        std::string read = index;
+        for (int d = shape.indirectionDepth - 1; d >= 0; --d) {
+            read = "X" + std::to_string(d) + "[" + read + "]";
+        }
+        os << "out[" << index << "] += A[" << read << "] + " << s << ";\n";
+        for (int g = 0; g < shape.numGuards; ++g) {
+            os << "}\n";
+        }
+    }
+    for (int l = 0; l < shape.loopDepth; ++l) {
+        os << "}\n";
+    }
+    os << "}\n";
+    return os.str();
+}
+
+//! Parse generated code into an AST
+static std::unique_ptr<ASTUnit> parseKernel(const std::string& code) {
+    return tooling::buildASTFromCode(
+        code, "bench_input.c", std::make_shared<PCHContainerOperations>());
+}
+
+//! Find the generated kernel function in an AST
+static FunctionDecl* findKernel(ASTUnit* AST) {
+    for (auto it : AST->getASTContext().getTranslationUnitDecl()->decls()) {
+        FunctionDecl* func = dyn_cast<FunctionDecl>(it);
+        if (func && func->doesThisDeclarationHaveABody()) {
+            return func;
+        }
+    }
+    return nullptr;
+}
+
+//! Time parsing a generated kernel
+static void BM_ParseKernel(benchmark::State& state) {
+    std::string code = generateKernel(getShape(state));
+    for (auto _ : state) {
+        std::unique_ptr<ASTUnit> AST = parseKernel(code);
+        benchmark::DoNotOptimize(AST.get());
+    }
+    state.counters["source_bytes"] = code.size();
+}
+
+//! Time building the Computation from an already-parsed kernel
+static void BM_BuildComputation(benchmark::State& state) {
+    std::unique_ptr<ASTUnit> AST = parseKernel(generateKernel(getShape(state)));
+    FunctionDecl* kernel = findKernel(AST.get());
+    if (!kernel) {
+        state.SkipWithError("generated kernel failed to parse");
+        return;
+    }
+    SPFComputationBuilder builder(AST->getASTContext());
+    for (auto _ : state) {
+        std::unique_ptr<iegenlib::Computation> computation =
+            builder.buildComputationFromFunction(kernel);
+        std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+        computation.reset();
+    }
+}
+
+//! Sweep each kernel dimension from small to large
+static void kernelShapes(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"stmts", "depth", "guards", "indirection"});
+    for (int numStmts : {16, 128, 1024}) {
+        for (int loopDepth : {1, 3}) {
+            for (int numGuards : {0, 2}) {
+                for (int indirectionDepth : {0, 3}) {
+                    b->Args({numStmts, loopDepth, numGuards,
+                             indirectionDepth});
+                }
+            }
+        }
+    }
+    b->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_ParseKernel)->Apply(kernelShapes);
+BENCHMARK(BM_BuildComputation)->Apply(kernelShapes);
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    // the peak is over the life of the process and cannot be reset, so it
+    // is only meaningful for the run as a whole, not for each shape
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cerr << "Peak resident set size: " << usage.ru_maxrss << " KB\n";
+    return 0;
+}
@@ -3,12 +3,21 @@
 #include <algorithm>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "CodeGenerator.hpp"
+#include "DependenceAnalysis.hpp"
+#include "Instrumentation.hpp"
+#include "IntensityEstimator.hpp"
+#include "LocalityAnalysis.hpp"
+#include "LoopFusion.hpp"
+#include "LoopTiling.hpp"
+#include "ScheduleOptimizer.hpp"
 #include "Utils.hpp"
 #include "clang/AST/Decl.h"
 #include "clang/AST/Stmt.h"
@@ -20,86 +29,162 @@ namespace spf_ie {
 
 /* SPFComputationBuilder */
 
-SPFComputationBuilder::SPFComputationBuilder(){};
+SPFComputationBuilder::SPFComputationBuilder(const ASTContext& astContext,
+                                             bool recoverableErrors)
+    : session(astContext, recoverableErrors){};
 
 std::unique_ptr<iegenlib::Computation>
 SPFComputationBuilder::buildComputationFromFunction(FunctionDecl* funcDecl) {
+    try {
+        return buildComputation(funcDecl);
+    } catch (const SPFError& error) {
+        if (session.areErrorsRecoverable()) {
+            throw;
+        }
+        Utils::printErrorAndExit(error, session.getASTContext());
+    }
+}
+
+std::unique_ptr<iegenlib::Computation> SPFComputationBuilder::buildComputation(
+    FunctionDecl* funcDecl) {
     if (CompoundStmt* funcBody = dyn_cast<CompoundStmt>(funcDecl->getBody())) {
         // reset builder components
         stmtNumber = 0;
         largestScheduleDimension = 0;
-        currentStmtContext = StmtContext();
+        currentScope = nullptr;
+        currentSchedule = ExecSchedule();
         stmtContexts.clear();
-        computation = std::make_unique<iegenlib::Computation>();
+        tiledBands.clear();
+        session.startFunction();
+        const ASTContext& Ctx = session.getASTContext();
+        std::string funcName = funcDecl->getQualifiedNameAsString();
 
         // perform processing
-        processBody(funcBody);
+        {
+            PhaseTimer timer(Instrumentation::Phase::ProcessBody, funcName);
+            processBody(funcBody);
+        }
 
         // collect results into Computation
-        for (auto& stmtContext : stmtContexts) {
-            // source code
-            std::string stmtSourceCode = Utils::stmtToString(stmtContext.stmt);
-            // iteration space
-            std::string iterationSpace = stmtContext.getIterSpaceString();
-            // execution schedule
-            // zero-pad schedule to maximum dimension encountered
-            stmtContext.schedule.zeroPadDimension(largestScheduleDimension);
-            std::string executionSchedule = stmtContext.getExecScheduleString();
-            // data accesses
-            std::vector<std::pair<std::string, std::string>> dataReads;
-            std::vector<std::pair<std::string, std::string>> dataWrites;
-            for (auto& it_accesses : stmtContext.dataAccesses.arrayAccesses) {
-                std::string dataSpaceAccessed =
-                    Utils::stmtToString(it_accesses.second.base);
-                // enforce loop invariance
-                if (!it_accesses.second.isRead) {
-                    for (const auto& invariantGroup : stmtContext.invariants) {
-                        if (std::find(
-                                invariantGroup.begin(), invariantGroup.end(),
-                                dataSpaceAccessed) != invariantGroup.end()) {
-                            Utils::printErrorAndExit(
-                                "Code may not modify loop-invariant data "
-                                "space '" +
-                                    dataSpaceAccessed + "'",
-                                stmtContext.stmt);
-                        }
+        std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+        computation = std::make_unique<iegenlib::Computation>();
+        {
+            PhaseTimer timer(Instrumentation::Phase::BuildStmts, funcName);
+            for (auto& stmtContext : stmtContexts) {
+                iegenlib::Stmt stmt;
+                // source code
+                stmt.setStmtSourceCode(
+                    session.getSourceText(stmtContext.stmt));
+                // iteration space, built without a round trip through a string
+                stmt.setIterationSpace(stmtContext.buildIterSpace());
+                // execution schedule
+                // zero-pad schedule to maximum dimension encountered
+                stmtContext.schedule.zeroPadDimension(largestScheduleDimension);
+                stmt.setExecutionSchedule(stmtContext.buildExecSchedule());
+                // data accesses
+                for (auto& it_accesses :
+                     stmtContext.dataAccesses.arrayAccesses) {
+                    std::string dataSpaceAccessed =
+                        session.getSPFString(it_accesses.second.base);
+                    // enforce loop invariance
+                    if (!it_accesses.second.isRead &&
+                        Scope::isInvariant(stmtContext.scope.get(),
+                                           dataSpaceAccessed)) {
+                        Utils::throwError(
+                            "Code may not modify loop-invariant data space '" +
+                                dataSpaceAccessed + "'",
+                            stmtContext.stmt, Ctx);
+                    }
+                    // insert data access
+                    std::string accessString;
+                    {
+                        PhaseTimer timer(Instrumentation::Phase::AccessStrings);
+                        accessString = stmtContext.getDataAccessString(
+                            &it_accesses.second);
+                    }
+                    if (it_accesses.second.isRead) {
+                        stmt.addRead(dataSpaceAccessed, accessString);
+                    } else {
+                        stmt.addWrite(dataSpaceAccessed, accessString);
                     }
                 }
-                // insert data access
-                (it_accesses.second.isRead ? dataReads : dataWrites)
-                    .push_back(std::make_pair(
-                        dataSpaceAccessed,
-                        stmtContext.getDataAccessString(&it_accesses.second)));
-            }
 
-            // insert Computation data spaces
-            auto stmtDataSpaces = stmtContext.dataAccesses.dataSpaces;
-            for (const auto& dataSpaceName :
-                 stmtContext.dataAccesses.dataSpaces) {
-                computation->addDataSpace(dataSpaceName);
-            }
+                // insert Computation data spaces
+                for (const auto& dataSpace :
+                     stmtContext.dataAccesses.dataSpaces) {
+                    computation->addDataSpace(dataSpace.first);
+                }
 
-            // create and insert iegenlib Stmt
-            computation->addStmt(std::move(
-                iegenlib::Stmt(stmtSourceCode, iterationSpace,
-                               executionSchedule, dataReads, dataWrites)));
+                // insert iegenlib Stmt
+                computation->addStmt(std::move(stmt));
+            }
         }
 
         // sanity check Computation completeness
-        if (!computation->isComplete()) {
-            Utils::printErrorAndExit(
+        bool isComplete;
+        {
+            PhaseTimer timer(Instrumentation::Phase::CheckComplete, funcName);
+            isComplete = computation->isComplete();
+        }
+        if (!isComplete) {
+            Utils::throwError(
                 "Computation is in an inconsistent/incomplete state after "
                 "building from function '" +
-                    funcDecl->getQualifiedNameAsString() +
+                    funcName +
                     "'. This "
                     "should not be possible and most likely indicates a bug.",
-                funcBody);
+                funcBody, Ctx);
         }
 
         return std::move(computation);
     } else {
-        Utils::printErrorAndExit("Invalid function body", funcDecl->getBody());
+        Utils::throwError("Invalid function body", funcDecl->getBody(),
+                          session.getASTContext());
+    }
+}
+
+DependenceGraph SPFComputationBuilder::analyzeDependences() {
+    return DependenceAnalysis(stmtContexts, session).analyze();
+}
+
+LocalityReport SPFComputationBuilder::analyzeLocality() {
+    return LocalityAnalysis(stmtContexts, session).analyze();
+}
+
+IntensityReport SPFComputationBuilder::estimateIntensity() {
+    return IntensityEstimator(stmtContexts, session).estimate();
+}
+
+std::string SPFComputationBuilder::generateCode(FunctionDecl* funcDecl,
+                                                CodeGenerator::Target target) {
+    DependenceGraph dependences = analyzeDependences();
+    return CodeGenerator(stmtContexts, dependences, session, tiledBands)
+        .generate(funcDecl, target);
+}
+
+bool SPFComputationBuilder::optimizeSchedules(
+    iegenlib::Computation* computation, std::string& reason) {
+    ScheduleOptimizer optimizer(stmtContexts, session);
+    if (!optimizer.optimize(computation)) {
+        reason = optimizer.getReason();
+        return false;
     }
+    return true;
+}
+
+unsigned int SPFComputationBuilder::fuseLoops(
+    iegenlib::Computation* computation) {
+    return LoopFusion(stmtContexts, session).fuse(computation);
+}
+
+unsigned int SPFComputationBuilder::tileLoops(
+    iegenlib::Computation* computation,
+    const std::vector<unsigned int>& sizes) {
+    DependenceGraph dependences = analyzeDependences();
+    LoopTiling tiling(stmtContexts, dependences);
+    unsigned int numTiled = tiling.tile(computation, sizes);
+    tiledBands = tiling.getBands();
+    return numTiled;
 }
 
 void SPFComputationBuilder::processBody(clang::Stmt* stmt) {
@@ -119,64 +204,79 @@ void SPFComputationBuilder::processSingleStmt(clang::Stmt* stmt) {
         isa<AttributedStmt>(stmt) || isa<GotoStmt>(stmt) ||
         isa<ContinueStmt>(stmt) || isa<BreakStmt>(stmt) ||
         isa<CallExpr>(stmt)) {
-        Utils::printErrorAndExit("Unsupported stmt type " +
-                                     std::string(stmt->getStmtClassName()),
-                                 stmt);
+        Utils::throwError("Unsupported stmt type " +
+                              std::string(stmt->getStmtClassName()),
+                          stmt, session.getASTContext());
     }
 
     if (ForStmt* asForStmt = dyn_cast<ForStmt>(stmt)) {
-        currentStmtContext.schedule.advanceSchedule();
-        currentStmtContext.enterFor(asForStmt);
+        currentSchedule.advanceSchedule();
+        std::shared_ptr<const Scope> outerScope = currentScope;
+        currentScope = Scope::makeLoop(outerScope, asForStmt, session);
+        currentSchedule.pushIterator();
         processBody(asForStmt->getBody());
-        currentStmtContext.exitFor();
+        currentSchedule.popValue();
+        currentSchedule.popValue();
+        currentScope = outerScope;
     } else if (IfStmt* asIfStmt = dyn_cast<IfStmt>(stmt)) {
         if (asIfStmt->getConditionVariable()) {
-            Utils::printErrorAndExit(
+            Utils::throwError(
                 "If statement condition variable declarations are unsupported",
-                asIfStmt);
+                asIfStmt, session.getASTContext());
         }
-        currentStmtContext.enterIf(asIfStmt);
+        std::shared_ptr<const Scope> outerScope = currentScope;
+        currentScope = Scope::makeGuard(outerScope, asIfStmt, false, session);
         processBody(asIfStmt->getThen());
-        currentStmtContext.exitIf();
+        currentScope = outerScope;
         // treat else clause (if present) as another if statement, but with
         // condition inverted
         if (asIfStmt->hasElseStorage()) {
-            currentStmtContext.enterIf(asIfStmt, true);
+            currentScope =
+                Scope::makeGuard(outerScope, asIfStmt, true, session);
             processBody(asIfStmt->getElse());
-            currentStmtContext.exitIf();
+            currentScope = outerScope;
         }
     } else {
-        currentStmtContext.schedule.advanceSchedule();
+        currentSchedule.advanceSchedule();
         addStmt(stmt);
     }
 }
 
 void SPFComputationBuilder::addStmt(clang::Stmt* stmt) {
+    StmtContext stmtContext(&session, currentScope, currentSchedule);
+    stmtContext.stmt = stmt;
+
     // capture reads and writes made in statement
     if (DeclStmt* asDeclStmt = dyn_cast<DeclStmt>(stmt)) {
         VarDecl* decl = cast<VarDecl>(asDeclStmt->getSingleDecl());
         if (decl->hasInit()) {
-            currentStmtContext.dataAccesses.processAsReads(decl->getInit());
+            stmtContext.dataAccesses.processAsReads(decl->getInit(), session);
         }
     } else if (BinaryOperator* asBinOper = dyn_cast<BinaryOperator>(stmt)) {
         if (ArraySubscriptExpr* lhsAsArrayAccess =
-                dyn_cast<ArraySubscriptExpr>(asBinOper->getLHS())) {
-            currentStmtContext.dataAccesses.processAsWrite(lhsAsArrayAccess);
+                DataAccessHandler::getWrittenArrayAccess(stmt)) {
+            stmtContext.dataAccesses.processAsWrite(lhsAsArrayAccess,
+                                                    session);
         }
         if (asBinOper->isCompoundAssignmentOp()) {
-            currentStmtContext.dataAccesses.processAsReads(asBinOper->getLHS());
+            stmtContext.dataAccesses.processAsReads(asBinOper->getLHS(),
+                                                    session);
         }
-        currentStmtContext.dataAccesses.processAsReads(asBinOper->getRHS());
+        stmtContext.dataAccesses.processAsReads(asBinOper->getRHS(), session);
+    } else if (ArraySubscriptExpr* subAsArrayAccess =
+                   DataAccessHandler::getWrittenArrayAccess(stmt)) {
+        // an increment or decrement, which reads the element it writes
+        stmtContext.dataAccesses.processAsWrite(subAsArrayAccess, session);
+        stmtContext.dataAccesses.processAsReads(subAsArrayAccess, session);
     }
 
     // increase largest schedule dimension, if necessary
     largestScheduleDimension = std::max(
-        largestScheduleDimension, currentStmtContext.schedule.getDimension());
+        largestScheduleDimension, currentSchedule.getDimension());
 
     // store processed statement
-    currentStmtContext.stmt = stmt;
-    stmtContexts.push_back(currentStmtContext);
-    currentStmtContext = StmtContext(&currentStmtContext);
+    stmtContexts.push_back(std::move(stmtContext));
+    Instrumentation::count(Instrumentation::Counter::Statements);
     stmtNumber++;
 }
 
@@ -14,23 +14,30 @@
 #include <utility>
 #include <vector>
 
-#include "Driver.hpp"
+#include "ComputationServer.hpp"
+#include "PreambleCache.hpp"
 #include "SPFComputationBuilder.hpp"
+#include "SPFExprPrinter.hpp"
 #include "Utils.hpp"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
+#include "clang/AST/Stmt.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/CompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
 #include "gtest/gtest.h"
 #include "iegenlib.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace clang;
 using namespace spf_ie;
 
-const ASTContext* spf_ie::Context;
-
 /*!
  * \class SPFComputationTest
  *
@@ -51,11 +58,16 @@ class SPFComputationTest : public ::testing::Test {
     buildSPFComputationsFromCode(std::string code) {
         std::unique_ptr<ASTUnit> AST = tooling::buildASTFromCode(
             code, "test_input.cpp", std::make_shared<PCHContainerOperations>());
-        Context = &AST->getASTContext();
+        return buildSPFComputations(AST->getASTContext());
+    }
 
+    //! Build SPFComputations from every function in a parsed translation
+    //! unit.
+    std::vector<std::unique_ptr<iegenlib::Computation>> buildSPFComputations(
+        const ASTContext& Ctx) {
         std::vector<std::unique_ptr<iegenlib::Computation>> computations;
-        SPFComputationBuilder builder;
-        for (auto it : Context->getTranslationUnitDecl()->decls()) {
+        SPFComputationBuilder builder(Ctx);
+        for (auto it : Ctx.getTranslationUnitDecl()->decls()) {
             FunctionDecl* func = dyn_cast<FunctionDecl>(it);
             if (func && func->doesThisDeclarationHaveABody()) {
                 computations.push_back(
@@ -65,6 +77,33 @@ class SPFComputationTest : public ::testing::Test {
         return computations;
     }
 
+    //! Parse the provided code, keeping its AST and a builder over it for
+    //! the rest of the test.
+    //! \param[in] recoverableErrors Whether the builder throws errors
+    //! instead of exiting
+    //! \return Every function in the code which has a body, in order
+    std::vector<FunctionDecl*> parseFunctions(std::string code,
+                                              bool recoverableErrors = false) {
+        AST = tooling::buildASTFromCode(
+            code, "test_input.cpp", std::make_shared<PCHContainerOperations>());
+        const ASTContext& Ctx = AST->getASTContext();
+        builder =
+            std::make_unique<SPFComputationBuilder>(Ctx, recoverableErrors);
+        std::vector<FunctionDecl*> functions;
+        for (auto it : Ctx.getTranslationUnitDecl()->decls()) {
+            FunctionDecl* func = dyn_cast<FunctionDecl>(it);
+            if (func && func->doesThisDeclarationHaveABody()) {
+                functions.push_back(func);
+            }
+        }
+        return functions;
+    }
+
+    //! AST of the code last given to parseFunctions
+    std::unique_ptr<ASTUnit> AST;
+    //! Builder over the AST of the code last given to parseFunctions
+    std::unique_ptr<SPFComputationBuilder> builder;
+
     //! Use assertions/expectations to compare an SPFComputation to
     //! expected values.
     void compareComputationToExpectations(
@@ -278,6 +317,973 @@ int CSR_SpMV(int a, int N, int A[a], int index[N + 1], int col[a], int x[N], int
         expectedExecSchedules, expectedReads, expectedWrites);
 }
 
+//! Test that replacement variable names depend only on the function being
+//! built, not on what the builder processed before it
+TEST_F(SPFComputationTest, replacement_names_per_function) {
+    std::string code =
+        "\
+void gather(int n, int A[n], int idx[n], int out[n]) {\
+    int i;\
+    for (i = 0; i < n; i++) {\
+        out[i] = A[idx[i]];\
+    }\
+}\
+void scatter(int n, int A[n], int idx[n], int out[n]) {\
+    int i;\
+    for (i = 0; i < n; i++) {\
+        out[idx[i]] = A[i];\
+    }\
+}\
+";
+
+    std::vector<std::unique_ptr<iegenlib::Computation>> computations =
+        buildSPFComputationsFromCode(code);
+    ASSERT_EQ(2, computations.size());
+
+    std::vector<std::string> expectedIterSpaces = {"{[]}",
+                                                   "{[i]: 0 <= i && i < n}"};
+    std::vector<std::string> expectedExecSchedules = {"{[]->[0,0,0]}",
+                                                      "{[i]->[1,i,0]}"};
+
+    std::vector<std::vector<std::pair<std::string, std::string>>>
+        expectedGatherReads = {
+            {},
+            {{"idx", "{[i]->[i]}"},
+             {"A", "{[i]->[" + replacementVarName + "0]: " +
+                       replacementVarName + "0 = idx(i)}"}}};
+    std::vector<std::vector<std::pair<std::string, std::string>>>
+        expectedGatherWrites = {{}, {{"out", "{[i]->[i]}"}}};
+    compareComputationToExpectations(
+        computations[0].get(), 2, {"A", "idx", "out"}, expectedIterSpaces,
+        expectedExecSchedules, expectedGatherReads, expectedGatherWrites);
+
+    std::vector<std::vector<std::pair<std::string, std::string>>>
+        expectedScatterReads = {
+            {}, {{"idx", "{[i]->[i]}"}, {"A", "{[i]->[i]}"}}};
+    std::vector<std::vector<std::pair<std::string, std::string>>>
+        expectedScatterWrites = {
+            {},
+            {{"out", "{[i]->[" + replacementVarName + "0]: " +
+                         replacementVarName + "0 = idx(i)}"}}};
+    compareComputationToExpectations(
+        computations[1].get(), 2, {"A", "idx", "out"}, expectedIterSpaces,
+        expectedExecSchedules, expectedScatterReads, expectedScatterWrites);
+}
+
+//! Test that declared iterators and affine expressions in loop bounds and
+//! conditions are handled
+TEST_F(SPFComputationTest, affine_bounds_correct) {
+    std::string code =
+        "void f(int n, int A[n]) {\
+    for (int i = 1; i < n - 1; i++) {\
+        if (-i + n >= 3) {\
+            A[i] = 0;\
+        }\
+    }\
+}";
+
+    std::vector<std::unique_ptr<iegenlib::Computation>> computations =
+        buildSPFComputationsFromCode(code);
+    ASSERT_EQ(1, computations.size());
+
+    compareComputationToExpectations(
+        computations.back().get(), 1, {"A"},
+        {"{[i]: 1 <= i && i < n - 1 && n - i >= 3}"}, {"{[i]->[0,i,0]}"},
+        {{}}, {{{"A", "{[i]->[i]}"}}});
+}
+
+//! Test that accesses written through macros are printed from the AST rather
+//! than from their source spelling
+TEST_F(SPFComputationTest, macro_accesses_correct) {
+    std::string code =
+        "#define NEXT(arr, i) arr[i + 1]\n\
+#define GATHER(arr, idx, i) arr[idx[i]]\n\
+void f(int n, int A[n], int B[n], int idx[n]) {\
+    for (int i = 0; i < n - 1; i++) {\
+        B[i] = NEXT(A, i) + GATHER(A, idx, i);\
+    }\
+}";
+
+    std::vector<std::unique_ptr<iegenlib::Computation>> computations =
+        buildSPFComputationsFromCode(code);
+    ASSERT_EQ(1, computations.size());
+
+    std::vector<std::vector<std::pair<std::string, std::string>>>
+        expectedReads = {
+            {{"A", "{[i]->[" + replacementVarName + "0]: " +
+                       replacementVarName + "0 = i + 1}"},
+             {"idx", "{[i]->[i]}"},
+             {"A", "{[i]->[" + replacementVarName + "1]: " +
+                       replacementVarName + "1 = idx(i)}"}}};
+    compareComputationToExpectations(
+        computations.back().get(), 1, {"A", "B", "idx"},
+        {"{[i]: 0 <= i && i < n - 1}"}, {"{[i]->[0,i,0]}"}, expectedReads,
+        {{{"B", "{[i]->[i]}"}}});
+}
+
+//! Test that nested prefix operators are printed apart, so that they do not
+//! read as increments or decrements
+TEST_F(SPFComputationTest, nested_unary_operators_printed_apart) {
+    std::string code =
+        "int negate(int i) {\n"
+        "    return - -i + +(+i) - -(int)-i;\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(1, functions.size());
+
+    ReturnStmt* ret = cast<ReturnStmt>(
+        cast<CompoundStmt>(functions[0]->getBody())->body_back());
+    EXPECT_EQ("- -i + +(+i) - - -i",
+              SPFExprPrinter::print(ret->getRetValue(), AST->getASTContext()));
+}
+
+//! Test that with recoverable errors, a function which cannot be built throws
+//! and the builder can still build the functions after it
+TEST_F(SPFComputationTest, recoverable_error_skips_function) {
+    std::string code =
+        "void bad(int n, int A[n]) {\
+    int i = 0;\
+    while (i < n) {\
+        A[i] = 0;\
+    }\
+}\
+void good(int n, int A[n]) {\
+    for (int i = 0; i < n; i++) {\
+        A[i] = 0;\
+    }\
+}";
+
+    std::vector<FunctionDecl*> functions =
+        parseFunctions(code, /*recoverableErrors=*/true);
+    ASSERT_EQ(2, functions.size());
+
+    EXPECT_THROW(builder->buildComputationFromFunction(functions[0]),
+                 SPFError);
+    std::unique_ptr<iegenlib::Computation> computation =
+        builder->buildComputationFromFunction(functions[1]);
+
+    compareComputationToExpectations(
+        computation.get(), 1, {"A"}, {"{[i]: 0 <= i && i < n}"},
+        {"{[i]->[0,i,0]}"}, {{}}, {{{"A", "{[i]->[i]}"}}});
+}
+
+//! Test that the server answers a request for a file on disk with the
+//! functions defined in it, leaving out those of the headers it includes
+TEST_F(SPFComputationTest, server_request_correct) {
+    llvm::SmallString<128> headerPath;
+    llvm::SmallString<128> sourcePath;
+    int headerFD;
+    int sourceFD;
+    ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("spfie_server", "h",
+                                                    headerFD, headerPath));
+    llvm::FileRemover headerRemover(headerPath);
+    ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("spfie_server", "c",
+                                                    sourceFD, sourcePath));
+    llvm::FileRemover sourceRemover(sourcePath);
+    {
+        llvm::raw_fd_ostream header(headerFD, /*shouldClose=*/true);
+        header << "void fill(int n, int A[n]) {\n"
+                  "    for (int i = 0; i < n; i++) {\n"
+                  "        A[i] = 1;\n"
+                  "    }\n"
+                  "}\n";
+        llvm::raw_fd_ostream source(sourceFD, /*shouldClose=*/true);
+        source << "#include \"" << headerPath << "\"\n"
+               << "void zero(int n, int A[n]) {\n"
+                  "    for (int i = 0; i < n; i++) {\n"
+                  "        A[i] = 0;\n"
+                  "    }\n"
+                  "}\n";
+    }
+
+    tooling::FixedCompilationDatabase compilations(".", {});
+    ComputationServer server(compilations, "");
+    llvm::Expected<llvm::json::Value> response =
+        llvm::json::parse(server.handleRequest(
+            "{\"id\": 7, \"file\": \"" + sourcePath.str().str() + "\"}"));
+    ASSERT_TRUE(static_cast<bool>(response));
+    const llvm::json::Object* object = response->getAsObject();
+    ASSERT_NE(nullptr, object);
+    ASSERT_TRUE(object->getInteger("id"));
+    EXPECT_EQ(7, *object->getInteger("id"));
+    const llvm::json::Array* errors = object->getArray("errors");
+    ASSERT_NE(nullptr, errors);
+    EXPECT_TRUE(errors->empty());
+
+    const llvm::json::Array* computations = object->getArray("computations");
+    ASSERT_NE(nullptr, computations);
+    ASSERT_EQ(1, computations->size());
+    const llvm::json::Object* computation = (*computations)[0].getAsObject();
+    ASSERT_NE(nullptr, computation);
+    EXPECT_EQ("zero",
+              computation->getString("function").getValueOr("").str());
+    const llvm::json::Array* stmts = computation->getArray("stmts");
+    ASSERT_NE(nullptr, stmts);
+    ASSERT_EQ(1, stmts->size());
+    const llvm::json::Object* stmt = (*stmts)[0].getAsObject();
+    ASSERT_NE(nullptr, stmt);
+    iegenlib::Set expectedIterSpace("{[i]: 0 <= i && i < n}");
+    EXPECT_EQ(expectedIterSpace.prettyPrintString(),
+              stmt->getString("iterationSpace").getValueOr("").str());
+}
+
+//! Test that a translation unit saved to an AST file is loaded back with
+//! everything needed to build its Computations
+TEST_F(SPFComputationTest, ast_file_input_correct) {
+    std::string code =
+        "void zero(int n, int A[n]) {\
+    for (int i = 0; i < n; i++) {\
+        A[i] = 0;\
+    }\
+}";
+
+    llvm::SmallString<128> astPath;
+    ASSERT_FALSE(
+        llvm::sys::fs::createTemporaryFile("spfie_input", "ast", astPath));
+    llvm::FileRemover astRemover(astPath);
+    {
+        std::unique_ptr<ASTUnit> AST = tooling::buildASTFromCode(
+            code, "test_input.c", std::make_shared<PCHContainerOperations>());
+        // true on failure
+        ASSERT_FALSE(AST->Save(astPath));
+    }
+
+    std::unique_ptr<ASTUnit> unit =
+        PreambleCache::loadASTFile(astPath.str().str());
+    ASSERT_NE(nullptr, unit);
+    std::vector<std::unique_ptr<iegenlib::Computation>> computations =
+        buildSPFComputations(unit->getASTContext());
+    ASSERT_EQ(1, computations.size());
+
+    compareComputationToExpectations(
+        computations[0].get(), 1, {"A"}, {"{[i]: 0 <= i && i < n}"},
+        {"{[i]->[0,i,0]}"}, {{}}, {{{"A", "{[i]->[i]}"}}});
+}
+
+//! Test that dependences are found, with the loop level carrying each, both
+//! through affine subscripts and through uninterpreted functions
+TEST_F(SPFComputationTest, dependences_correct) {
+    std::string code =
+        "void recurrence(int n, int A[n], int B[n]) {\
+    for (int i = 1; i < n; i++) {\
+        A[i] = A[i - 1] + B[i];\
+        B[i] = 0;\
+    }\
+}\
+void scatter(int n, int col[n], int x[n], int y[n]) {\
+    for (int k = 0; k < n; k++) {\
+        x[col[k]] = x[col[k]] + y[k];\
+    }\
+}";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(2, functions.size());
+
+    // the recurrence on A is carried by the loop; B is only reused within
+    // an iteration
+    builder->buildComputationFromFunction(functions[0]);
+    DependenceGraph recurrence = builder->analyzeDependences();
+    EXPECT_EQ(
+        "S0 -> S0: flow on A, carried at level 1 (<): {[i]->[ip]: 1 <= i && "
+        "i < n && 1 <= ip && ip < n && i = ip - 1 && i < ip}\n"
+        "S0 -> S1: anti on B, loop-independent (=): {[i]->[ip]: 1 <= i && "
+        "i < n && 1 <= ip && ip < n && i = ip}\n",
+        recurrence.toString());
+
+    // nothing is known about col, so every access to x may conflict across
+    // iterations
+    builder->buildComputationFromFunction(functions[1]);
+    DependenceGraph scatter = builder->analyzeDependences();
+    const std::vector<Dependence>& dependences = scatter.getDependences();
+    ASSERT_EQ(3, dependences.size());
+    EXPECT_EQ(Dependence::Kind::Output, dependences[0].kind);
+    EXPECT_EQ(Dependence::Kind::Flow, dependences[1].kind);
+    EXPECT_EQ(Dependence::Kind::Anti, dependences[2].kind);
+    for (const auto& dependence : dependences) {
+        EXPECT_EQ("x", dependence.dataSpace);
+        EXPECT_EQ(1, dependence.level);
+        EXPECT_TRUE(scatter.isCarried(dependence.loop));
+    }
+    EXPECT_EQ(
+        "{[k]->[kp]: 0 <= k && k < n && 0 <= kp && kp < n && "
+        "col(k) = col(kp) && k < kp}",
+        dependences[1].relation);
+}
+
+//! Test that increments of array elements are recorded as writes, and that
+//! writes the analysis cannot locate keep their loops serial
+TEST_F(SPFComputationTest, unknown_accesses_carried) {
+    std::string code =
+        "void histogram(int n, int m, int idx[n], int a[m]) {\
+    for (int i = 0; i < n; i++) {\
+        a[idx[i]]++;\
+    }\
+}\
+void total(int n, int a[n], int* sum) {\
+    for (int i = 0; i < n; i++) {\
+        *sum += a[i];\
+    }\
+}";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(2, functions.size());
+
+    // the increment both reads and writes a, at an element only known
+    // through idx
+    std::unique_ptr<iegenlib::Computation> histogram =
+        builder->buildComputationFromFunction(functions[0]);
+    ASSERT_EQ(1, histogram->getNumStmts());
+    auto writes = histogram->getStmt(0)->getDataWrites();
+    ASSERT_EQ(1, writes.size());
+    EXPECT_EQ("a", writes[0].first);
+    DependenceGraph increments = builder->analyzeDependences();
+    ASSERT_FALSE(increments.getDependences().empty());
+    for (const auto& dependence : increments.getDependences()) {
+        EXPECT_EQ("a", dependence.dataSpace);
+        EXPECT_EQ(1, dependence.level);
+        EXPECT_FALSE(increments.isParallelizable(dependence.loop));
+    }
+
+    // sum may point into a, or anywhere else, so the accumulation is not a
+    // reduction
+    builder->buildComputationFromFunction(functions[1]);
+    DependenceGraph accumulation = builder->analyzeDependences();
+    EXPECT_TRUE(accumulation.getReductions().empty());
+    bool isSumRewritten = false;
+    for (const auto& dependence : accumulation.getDependences()) {
+        EXPECT_EQ(1, dependence.level);
+        EXPECT_FALSE(accumulation.isParallelizable(dependence.loop));
+        isSumRewritten = isSumRewritten ||
+                         (dependence.kind == Dependence::Kind::Output &&
+                          dependence.dataSpace == "*sum");
+    }
+    EXPECT_TRUE(isSumRewritten);
+}
+
+//! Test that subscripts through a scalar written inside the loop are not
+//! taken to have the same value in every iteration
+TEST_F(SPFComputationTest, private_scalar_subscripts_carried) {
+    std::string code =
+        "void shift(int n, int A[n + 2]) {\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        int k = n - i;\n"
+        "        A[k] = A[k + 1];\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(1, functions.size());
+
+    // each iteration reads the element the one before it wrote
+    builder->buildComputationFromFunction(functions[0]);
+    DependenceGraph shift = builder->analyzeDependences();
+    bool isFlowCarried = false;
+    for (const auto& dependence : shift.getDependences()) {
+        if (dependence.dataSpace == "A" &&
+            dependence.kind == Dependence::Kind::Flow &&
+            dependence.level == 1) {
+            isFlowCarried = true;
+            EXPECT_FALSE(shift.isParallelizable(dependence.loop));
+        }
+    }
+    EXPECT_TRUE(isFlowCarried);
+    std::string generated =
+        builder->generateCode(functions[0], CodeGenerator::Target::COpenMP);
+    EXPECT_EQ(std::string::npos, generated.find("#pragma"));
+}
+
+//! Test that generated OpenMP code parallelizes only loops which carry no
+//! dependence, privatizing inner iterators declared outside them
+TEST_F(SPFComputationTest, openmp_codegen_correct) {
+    std::string code =
+        "void matrix_add(int a, int b, int x[a][b], int y[a][b], "
+        "int sum[a][b]) {\n"
+        "    int i;\n"
+        "    int j;\n"
+        "    for (i = 0; i < a; i++) {\n"
+        "        for (j = 0; j < b; j++) {\n"
+        "            sum[i][j] = x[i][j] + y[i][j];\n"
+        "        }\n"
+        "    }\n"
+        "}\n"
+        "int CSR_SpMV(int a, int N, int A[a], int index[N + 1], int col[a], "
+        "int x[N], int product[N]) {\n"
+        "    for (int i = 0; i < N; i++) {\n"
+        "        for (int k = index[i]; k < index[i + 1]; k++) {\n"
+        "            product[i] += A[k] * x[col[k]];\n"
+        "        }\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(2, functions.size());
+
+    builder->buildComputationFromFunction(functions[0]);
+    EXPECT_EQ(
+        "void matrix_add(int a, int b, int x[a][b], int y[a][b], "
+        "int sum[a][b]) {\n"
+        "    int i;\n"
+        "    int j;\n"
+        "    #pragma omp parallel for private(j)\n"
+        "    for (i = 0; i < a; i++) {\n"
+        "        for (j = 0; j < b; j++) {\n"
+        "            sum[i][j] = x[i][j] + y[i][j];\n"
+        "        }\n"
+        "    }\n"
+        "}\n",
+        builder->generateCode(functions[0], CodeGenerator::Target::COpenMP));
+
+    // the inner loop carries the accumulation into product[i]
+    builder->buildComputationFromFunction(functions[1]);
+    EXPECT_EQ(
+        "int CSR_SpMV(int a, int N, int A[a], int index[N + 1], int col[a], "
+        "int x[N], int product[N]) {\n"
+        "    #pragma omp parallel for\n"
+        "    for (int i = 0; i < N; i++) {\n"
+        "        for (int k = index[i]; k < index[i + 1]; k++) {\n"
+        "            product[i] += A[k] * x[col[k]];\n"
+        "        }\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n",
+        builder->generateCode(functions[1], CodeGenerator::Target::COpenMP));
+}
+
+//! Test that loops writing through pointers or calling functions which may
+//! have side effects are not marked parallel
+TEST_F(SPFComputationTest, openmp_codegen_unknown_accesses_serial) {
+    std::string code =
+        "int next(int value);\n"
+        "void advance(int n, int a[n], int* sum) {\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        *sum += a[i];\n"
+        "    }\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        a[i] = next(a[i]);\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(1, functions.size());
+
+    builder->buildComputationFromFunction(functions[0]);
+    std::string generated =
+        builder->generateCode(functions[0], CodeGenerator::Target::COpenMP);
+    EXPECT_NE(std::string::npos, generated.find("*sum += a[i];"));
+    EXPECT_NE(std::string::npos, generated.find("a[i] = next(a[i]);"));
+    EXPECT_EQ(std::string::npos, generated.find("#pragma"));
+}
+
+//! Test that accumulations are recognized as reductions over the loops whose
+//! iterations all update the same location, and reduced in parallel
+TEST_F(SPFComputationTest, reductions_correct) {
+    std::string code =
+        "double dot(int n, double x[n], double y[n]) {\n"
+        "    double sum = 0;\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        sum += x[i] * y[i];\n"
+        "    }\n"
+        "    return sum;\n"
+        "}\n"
+        "void matrix_vector_multiply(int a, int b, int product[a], "
+        "int x[a][b], int y[b]) {\n"
+        "    for (int i = 0; i < a; i++) {\n"
+        "        product[i] = 0;\n"
+        "        for (int j = 0; j < b; j++) {\n"
+        "            product[i] += x[i][j] * y[j];\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(2, functions.size());
+
+    // the loop carries dependences only through the accumulation into sum
+    builder->buildComputationFromFunction(functions[0]);
+    DependenceGraph dot = builder->analyzeDependences();
+    ASSERT_EQ(1, dot.getReductions().size());
+    EXPECT_EQ("S1: + reduction into sum over level 1",
+              dot.getReductions()[0].toString());
+    for (const auto& dependence : dot.getDependences()) {
+        EXPECT_EQ(dependence.level == 1, dependence.isReduction);
+    }
+    EXPECT_TRUE(dot.isCarried(dot.getReductions()[0].loop));
+    EXPECT_TRUE(dot.isParallelizable(dot.getReductions()[0].loop));
+    EXPECT_EQ(
+        "double dot(int n, double x[n], double y[n]) {\n"
+        "    double sum = 0;\n"
+        "    #pragma omp parallel for reduction(+:sum)\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        sum += x[i] * y[i];\n"
+        "    }\n"
+        "    return sum;\n"
+        "}\n",
+        builder->generateCode(functions[0], CodeGenerator::Target::COpenMP));
+
+    // product[i] is only reduced over the inner loop; the outer loop is
+    // already parallel without it
+    builder->buildComputationFromFunction(functions[1]);
+    DependenceGraph multiply = builder->analyzeDependences();
+    ASSERT_EQ(1, multiply.getReductions().size());
+    EXPECT_EQ("S1: + reduction into product(i) over level 2",
+              multiply.getReductions()[0].toString());
+    EXPECT_EQ(
+        "void matrix_vector_multiply(int a, int b, int product[a], "
+        "int x[a][b], int y[b]) {\n"
+        "    #pragma omp parallel for\n"
+        "    for (int i = 0; i < a; i++) {\n"
+        "        product[i] = 0;\n"
+        "        for (int j = 0; j < b; j++) {\n"
+        "            product[i] += x[i][j] * y[j];\n"
+        "        }\n"
+        "    }\n"
+        "}\n",
+        builder->generateCode(functions[1], CodeGenerator::Target::COpenMP));
+}
+
+//! Test that an outermost loop carrying dependences through an index array
+//! is run as level sets found by an inspector
+TEST_F(SPFComputationTest, level_set_codegen_correct) {
+    std::string code =
+        "void lower_solve(int n, int nnz, int rowptr[n + 1], int col[nnz], "
+        "double val[nnz], double b[n], double x[n]) {\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        x[i] = b[i];\n"
+        "        for (int k = rowptr[i]; k < rowptr[i + 1] - 1; k++) {\n"
+        "            x[i] -= val[k] * x[col[k]];\n"
+        "        }\n"
+        "        x[i] /= val[rowptr[i + 1] - 1];\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(1, functions.size());
+    FunctionDecl* func = functions[0];
+    builder->buildComputationFromFunction(func);
+
+    // plain OpenMP leaves the loop serial
+    EXPECT_EQ(std::string::npos,
+              builder->generateCode(func, CodeGenerator::Target::COpenMP)
+                  .find("#pragma"));
+
+    EXPECT_EQ(
+        "void lower_solve(int n, int nnz, int rowptr[n + 1], int col[nnz], "
+        "double val[nnz], double b[n], double x[n]) {\n"
+        "    {\n"
+        "        /* inspector: each iteration over i goes one level after "
+        "those it depends on */\n"
+        "        int ls_count = 0;\n"
+        "        for (int i = 0; i < n; i++) {\n"
+        "            ls_count++;\n"
+        "        }\n"
+        "        int* ls_level = (int*)malloc((ls_count + 1) * sizeof(int));\n"
+        "        int* ls_x_read = (int*)calloc((size_t)(n), sizeof(int));\n"
+        "        int* ls_x_written = (int*)calloc((size_t)(n), sizeof(int));\n"
+        "        int ls_num_levels = 0;\n"
+        "        int ls_t = 0;\n"
+        "        for (int i = 0; i < n; i++) {\n"
+        "            int ls_l = 0;\n"
+        "            ls_l = ls_x_written[i] > ls_l ? ls_x_written[i] : ls_l;\n"
+        "            ls_l = ls_x_read[i] > ls_l ? ls_x_read[i] : ls_l;\n"
+        "            for (int k = rowptr[i]; k < rowptr[i + 1] - 1; k++) {\n"
+        "                ls_l = ls_x_written[col[k]] > ls_l ? "
+        "ls_x_written[col[k]] : ls_l;\n"
+        "                ls_l = ls_x_written[i] > ls_l ? ls_x_written[i] : "
+        "ls_l;\n"
+        "                ls_l = ls_x_read[i] > ls_l ? ls_x_read[i] : ls_l;\n"
+        "            }\n"
+        "            ls_l = ls_x_written[i] > ls_l ? ls_x_written[i] : ls_l;\n"
+        "            ls_l = ls_x_read[i] > ls_l ? ls_x_read[i] : ls_l;\n"
+        "            ls_x_written[i] = ls_l + 1;\n"
+        "            for (int k = rowptr[i]; k < rowptr[i + 1] - 1; k++) {\n"
+        "                ls_x_read[col[k]] = ls_x_read[col[k]] > ls_l ? "
+        "ls_x_read[col[k]] : ls_l + 1;\n"
+        "                ls_x_written[i] = ls_l + 1;\n"
+        "            }\n"
+        "            ls_x_written[i] = ls_l + 1;\n"
+        "            ls_level[ls_t++] = ls_l;\n"
+        "            if (ls_l >= ls_num_levels) {\n"
+        "                ls_num_levels = ls_l + 1;\n"
+        "            }\n"
+        "        }\n"
+        "        free(ls_x_read);\n"
+        "        free(ls_x_written);\n"
+        "        int* ls_start = (int*)calloc(ls_num_levels + 1, "
+        "sizeof(int));\n"
+        "        for (ls_t = 0; ls_t < ls_count; ls_t++) {\n"
+        "            ls_start[ls_level[ls_t] + 1]++;\n"
+        "        }\n"
+        "        for (int ls_l = 0; ls_l < ls_num_levels; ls_l++) {\n"
+        "            ls_start[ls_l + 1] += ls_start[ls_l];\n"
+        "        }\n"
+        "        int* ls_next = (int*)malloc((ls_num_levels + 1) * "
+        "sizeof(int));\n"
+        "        for (int ls_l = 0; ls_l < ls_num_levels; ls_l++) {\n"
+        "            ls_next[ls_l] = ls_start[ls_l];\n"
+        "        }\n"
+        "        int* ls_order = (int*)malloc((ls_count + 1) * sizeof(int));\n"
+        "        ls_t = 0;\n"
+        "        for (int i = 0; i < n; i++) {\n"
+        "            ls_order[ls_next[ls_level[ls_t++]]++] = i;\n"
+        "        }\n"
+        "        free(ls_next);\n"
+        "        free(ls_level);\n"
+        "        /* executor: levels in order, the iterations of each in "
+        "parallel */\n"
+        "        for (int ls_l = 0; ls_l < ls_num_levels; ls_l++) {\n"
+        "            #pragma omp parallel for\n"
+        "            for (int ls_k = ls_start[ls_l]; "
+        "ls_k < ls_start[ls_l + 1]; ls_k++) {\n"
+        "                int i = ls_order[ls_k];\n"
+        "                x[i] = b[i];\n"
+        "                for (int k = rowptr[i]; k < rowptr[i + 1] - 1; k++) "
+        "{\n"
+        "                    x[i] -= val[k] * x[col[k]];\n"
+        "                }\n"
+        "                x[i] /= val[rowptr[i + 1] - 1];\n"
+        "            }\n"
+        "        }\n"
+        "        free(ls_start);\n"
+        "        free(ls_order);\n"
+        "    }\n"
+        "}\n",
+        builder->generateCode(func, CodeGenerator::Target::COpenMPLevelSets));
+}
+
+//! Test that a loop whose guards read an array it writes is left as a plain
+//! serial loop, since an inspector could not evaluate them ahead of time
+TEST_F(SPFComputationTest, level_set_codegen_guard_falls_back) {
+    std::string code =
+        "void scatter_positive(int n, int col[n], int x[n], int y[n]) {\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        if (x[i] > 0) {\n"
+        "            x[col[i]] += y[i];\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(1, functions.size());
+
+    builder->buildComputationFromFunction(functions[0]);
+    std::string generated = builder->generateCode(
+        functions[0], CodeGenerator::Target::COpenMPLevelSets);
+    EXPECT_NE(std::string::npos, generated.find("x[col[i]] += y[i];"));
+    EXPECT_EQ(std::string::npos, generated.find("ls_"));
+    EXPECT_EQ(std::string::npos, generated.find("#pragma"));
+}
+
+//! Test that isl's scheduler moves a parallel loop outermost, and that
+//! functions it cannot represent are left alone
+TEST_F(SPFComputationTest, optimized_schedules_correct) {
+    std::string code =
+        "void column_recurrence(int n, int m, int A[n][m], int B[n][m]) {\n"
+        "    for (int i = 1; i < n; i++) {\n"
+        "        for (int j = 0; j < m; j++) {\n"
+        "            A[i][j] = A[i - 1][j] + B[i][j];\n"
+        "        }\n"
+        "    }\n"
+        "}\n"
+        "int CSR_SpMV(int a, int N, int A[a], int index[N + 1], int col[a], "
+        "int x[N], int product[N]) {\n"
+        "    for (int i = 0; i < N; i++) {\n"
+        "        for (int k = index[i]; k < index[i + 1]; k++) {\n"
+        "            product[i] += A[k] * x[col[k]];\n"
+        "        }\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n"
+        "void first_rows(int n, int A[n]) {\n"
+        "    int m = n - 1;\n"
+        "    for (int i = 0; i < m; i++) {\n"
+        "        A[i] = 0;\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(3, functions.size());
+    std::string reason;
+
+    // the dependence is carried by i, so j is run outermost
+    std::unique_ptr<iegenlib::Computation> recurrence =
+        builder->buildComputationFromFunction(functions[0]);
+    ASSERT_TRUE(builder->optimizeSchedules(recurrence.get(), reason))
+        << reason;
+    auto* expectedSchedule =
+        new iegenlib::Relation("{[i,j]->[t0,t1]: t0 = j && t1 = i}");
+    EXPECT_EQ(
+        expectedSchedule->prettyPrintString(),
+        recurrence->getStmt(0)->getExecutionSchedule()->prettyPrintString());
+    delete expectedSchedule;
+
+    // isl cannot represent loop bounds read from index
+    std::unique_ptr<iegenlib::Computation> spmv =
+        builder->buildComputationFromFunction(functions[1]);
+    std::string original =
+        spmv->getStmt(0)->getExecutionSchedule()->prettyPrintString();
+    EXPECT_FALSE(builder->optimizeSchedules(spmv.get(), reason));
+    EXPECT_EQ("the iteration space of S0 goes through an index array",
+              reason);
+    EXPECT_EQ(original,
+              spmv->getStmt(0)->getExecutionSchedule()->prettyPrintString());
+
+    // isl parameters are constant throughout, and m is assigned
+    std::unique_ptr<iegenlib::Computation> firstRows =
+        builder->buildComputationFromFunction(functions[2]);
+    EXPECT_FALSE(builder->optimizeSchedules(firstRows.get(), reason));
+    EXPECT_EQ(
+        "the iteration space of S1 depends on a scalar the function writes",
+        reason);
+}
+
+//! Test that adjacent loops are fused, along with the loops nested in them,
+//! unless a dependence would be reversed
+TEST_F(SPFComputationTest, loop_fusion_correct) {
+    std::string code =
+        "void split_add(int a, int b, int x[a][b], int y[a][b], int t[a][b], "
+        "int sum[a][b]) {\n"
+        "    for (int i = 0; i < a; i++) {\n"
+        "        for (int j = 0; j < b; j++) {\n"
+        "            t[i][j] = x[i][j] + y[i][j];\n"
+        "        }\n"
+        "    }\n"
+        "    for (int i = 0; i < a; i++) {\n"
+        "        for (int j = 0; j < b; j++) {\n"
+        "            sum[i][j] = t[i][j] * 2;\n"
+        "        }\n"
+        "    }\n"
+        "    for (int k = 0; k < a; k++) {\n"
+        "        x[k][0] = sum[a - 1 - k][0];\n"
+        "    }\n"
+        "}\n"
+        "int forward_solve(int n, int l[n][n], double b[n], double x[n]) {\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        x[i] = b[i];\n"
+        "    }\n"
+        "    for (int j = 0; j < n; j++) {\n"
+        "        x[j] /= l[j][j];\n"
+        "        for (int i = j + 1; i < n; i++) {\n"
+        "            x[i] -= l[i][j] * x[j];\n"
+        "        }\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(2, functions.size());
+
+    // the last loop reads the rows of sum in reverse, so it stays separate
+    std::unique_ptr<iegenlib::Computation> splitAdd =
+        builder->buildComputationFromFunction(functions[0]);
+    EXPECT_EQ(2, builder->fuseLoops(splitAdd.get()));
+    std::vector<std::string> expectedSchedules = {
+        "{[i,j]->[0,i,0,j,0]}", "{[i,j]->[0,i,0,j,1]}", "{[k]->[1,k,0,0,0]}"};
+    ASSERT_EQ(expectedSchedules.size(), splitAdd->getNumStmts());
+    for (unsigned int i = 0; i < expectedSchedules.size(); ++i) {
+        auto* expectedSchedule = new iegenlib::Relation(expectedSchedules[i]);
+        EXPECT_EQ(
+            expectedSchedule->prettyPrintString(),
+            splitAdd->getStmt(i)->getExecutionSchedule()->prettyPrintString());
+        delete expectedSchedule;
+    }
+
+    // fusing would update x[i] before it is first assigned
+    std::unique_ptr<iegenlib::Computation> forwardSolve =
+        builder->buildComputationFromFunction(functions[1]);
+    EXPECT_EQ(0, builder->fuseLoops(forwardSolve.get()));
+}
+
+//! Test that loop nests are tiled in both their schedules and generated
+//! code, unless a dependence would be reversed
+TEST_F(SPFComputationTest, loop_tiling_correct) {
+    std::string code =
+        "void mvm(int a, int b, int product[a], int x[a][b], int y[b]) {\n"
+        "    for (int i = 0; i < a; i++) {\n"
+        "        product[i] = 0;\n"
+        "        for (int j = 0; j < b; j++) {\n"
+        "            product[i] += x[i][j] * y[j];\n"
+        "        }\n"
+        "    }\n"
+        "}\n"
+        "void skew(int n, int A[n][n]) {\n"
+        "    for (int i = 1; i < n; i++) {\n"
+        "        for (int j = 0; j < n - 1; j++) {\n"
+        "            A[i][j] = A[i - 1][j + 1];\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(2, functions.size());
+
+    // product[i] = 0 runs in the first tile of the inner loop
+    std::unique_ptr<iegenlib::Computation> mvm =
+        builder->buildComputationFromFunction(functions[0]);
+    EXPECT_EQ(1, builder->tileLoops(mvm.get(), {32, 16}));
+    std::vector<std::string> expectedSchedules = {
+        "{[i]->[0,tile_i,0,i,0,0,0]: 32*tile_i <= i && i < 32*tile_i + 32}",
+        "{[i,j]->[0,tile_i,tile_j,i,1,j,0]: 32*tile_i <= i && "
+        "i < 32*tile_i + 32 && 16*tile_j <= j && j < 16*tile_j + 16}"};
+    ASSERT_EQ(expectedSchedules.size(), mvm->getNumStmts());
+    for (unsigned int i = 0; i < expectedSchedules.size(); ++i) {
+        auto* expectedSchedule = new iegenlib::Relation(expectedSchedules[i]);
+        EXPECT_EQ(expectedSchedule->prettyPrintString(),
+                  mvm->getStmt(i)->getExecutionSchedule()->prettyPrintString());
+        delete expectedSchedule;
+    }
+    EXPECT_EQ(
+        "void mvm(int a, int b, int product[a], int x[a][b], int y[b]) {\n"
+        "    #pragma omp parallel for\n"
+        "    for (int tile_i = 0; tile_i < a; tile_i += 32) {\n"
+        "        for (int tile_j = 0; tile_j < b || tile_j == 0; "
+        "tile_j += 16) {\n"
+        "            for (int i = tile_i; i < tile_i + 32 && i < a; i++) {\n"
+        "                if (tile_j == 0) {\n"
+        "                    product[i] = 0;\n"
+        "                }\n"
+        "                for (int j = tile_j; j < tile_j + 16 && j < b; "
+        "j++) {\n"
+        "                    product[i] += x[i][j] * y[j];\n"
+        "                }\n"
+        "            }\n"
+        "        }\n"
+        "    }\n"
+        "}\n",
+        builder->generateCode(functions[0], CodeGenerator::Target::COpenMP));
+
+    // A[i][j] depends on A[i - 1][j + 1], which a later tile of j writes
+    std::unique_ptr<iegenlib::Computation> skew =
+        builder->buildComputationFromFunction(functions[1]);
+    EXPECT_EQ(0, builder->tileLoops(skew.get(), {32, 32}));
+}
+
+//! Test that array accesses are classified by their stride along the
+//! innermost loop enclosing them
+TEST_F(SPFComputationTest, locality_report_correct) {
+    std::string code =
+        "int forward_solve(int n, int l[n][n], double b[n], double x[n]) {\n"
+        "    int i;\n"
+        "    for (i = 0; i < n; i++) {\n"
+        "        x[i] = b[i];\n"
+        "    }\n"
+        "    int j;\n"
+        "    for (j = 0; j < n; j++) {\n"
+        "        x[j] /= l[j][j];\n"
+        "        for (i = j + 1; i < n; i++) {\n"
+        "            if (l[i][j] > 0) {\n"
+        "                x[i] -= l[i][j] * x[j];\n"
+        "            }\n"
+        "        }\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n"
+        "void CSR_SpMV(int a, int N, int A[a], int index[N + 1], int col[a], "
+        "int x[N], int product[N]) {\n"
+        "    for (int i = 0; i < N; i++) {\n"
+        "        for (int k = index[i]; k < index[i + 1]; k++) {\n"
+        "            product[i] += A[k] * x[col[k]];\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(2, functions.size());
+
+    // the inner loop over i walks down the columns of l, a row of n apart
+    builder->buildComputationFromFunction(functions[0]);
+    EXPECT_EQ(
+        "loop i (level 1):\n"
+        "  S1 write x(i): unit-stride\n"
+        "  S1 read b(i): unit-stride\n"
+        "loop j (level 1):\n"
+        "  S3 write x(j): unit-stride\n"
+        "  S3 read x(j): unit-stride\n"
+        "  S3 read l(j,j): constant-stride n + 1, column walk\n"
+        "loop i (level 2):\n"
+        "  S4 write x(i): unit-stride\n"
+        "  S4 read x(i): unit-stride\n"
+        "  S4 read l(i,j): constant-stride n, column walk\n"
+        "  S4 read x(j): stride-0\n",
+        builder->analyzeLocality().toString());
+
+    // x is read through col, which changes with k
+    builder->buildComputationFromFunction(functions[1]);
+    LocalityReport spmv = builder->analyzeLocality();
+    ASSERT_EQ(1, spmv.getLoops().size());
+    const LoopLocality& loop = spmv.getLoops()[0];
+    EXPECT_EQ("k", loop.iterator);
+    EXPECT_EQ(2, loop.level);
+    std::vector<std::pair<std::string, AccessLocality::Kind>> expected = {
+        {"product(i)", AccessLocality::Kind::Invariant},
+        {"product(i)", AccessLocality::Kind::Invariant},
+        {"A(k)", AccessLocality::Kind::Unit},
+        {"col(k)", AccessLocality::Kind::Unit},
+        {"x(col(k))", AccessLocality::Kind::Gather}};
+    ASSERT_EQ(expected.size(), loop.accesses.size());
+    for (unsigned int i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].first, loop.accesses[i].access);
+        EXPECT_EQ(expected[i].second, loop.accesses[i].kind);
+    }
+}
+
+//! Test that traffic and arithmetic are estimated from the element types of
+//! the arrays accessed
+TEST_F(SPFComputationTest, intensity_estimate_correct) {
+    std::string code =
+        "int forward_solve(int n, int l[n][n], double b[n], double x[n]) {\n"
+        "    int i;\n"
+        "    for (i = 0; i < n; i++) {\n"
+        "        x[i] = b[i];\n"
+        "    }\n"
+        "    int j;\n"
+        "    for (j = 0; j < n; j++) {\n"
+        "        x[j] /= l[j][j];\n"
+        "        for (i = j + 1; i < n; i++) {\n"
+        "            if (l[i][j] > 0) {\n"
+        "                x[i] -= l[i][j] * x[j];\n"
+        "            }\n"
+        "        }\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n"
+        "void power(int n, float x[n], float y[n]) {\n"
+        "    for (int i = 0; i < n; i++) {\n"
+        "        y[i] = x[i] * x[i] * x[i] * x[i] + 1;\n"
+        "    }\n"
+        "}\n";
+
+    std::vector<FunctionDecl*> functions = parseFunctions(code);
+    ASSERT_EQ(2, functions.size());
+
+    // l holds ints and x doubles; x[j] stays in a register over the inner
+    // loop, so the nest over j moves less per iteration than S4 does
+    builder->buildComputationFromFunction(functions[0]);
+    EXPECT_EQ(
+        "        bytes read  bytes written   ops  ops/byte\n"
+        "S1               8              8     0      0.00  memory-bound\n"
+        "S3              12              8     1      0.05  memory-bound\n"
+        "S4              20              8     2      0.07  memory-bound\n"
+        "loop i           8              8     0      0.00  memory-bound\n"
+        "loop j          12              8     2      0.10  memory-bound\n",
+        builder->estimateIntensity().toString(1));
+
+    // x[i] is read once, however many times the statement uses it
+    builder->buildComputationFromFunction(functions[1]);
+    IntensityReport power = builder->estimateIntensity();
+    ASSERT_EQ(1, power.getStmts().size());
+    const TrafficEstimate& stmt = power.getStmts()[0];
+    EXPECT_EQ(4, stmt.bytesRead);
+    EXPECT_EQ(4, stmt.bytesWritten);
+    EXPECT_EQ(4, stmt.operations);
+    EXPECT_DOUBLE_EQ(0.5, stmt.getIntensity());
+    ASSERT_EQ(1, power.getNests().size());
+    EXPECT_EQ("loop i", power.getNests()[0].label);
+    EXPECT_NE(std::string::npos,
+              power.toString(0.25).find("0.50  compute-bound"));
+}
+
 /** Death tests, checking failure on invalid input **/
 
 TEST_F(SPFComputationDeathTest, incorrect_increment_fails) {
@@ -382,6 +1388,17 @@ TEST_F(SPFComputationDeathTest, invalid_condition_fails) {
         "Not-equal conditions are unsupported by SPF: in condition x != 0");
 }
 
+TEST_F(SPFComputationDeathTest, non_affine_condition_fails) {
+    std::string code =
+        "void f(int n, int A[n]) {\
+    for (int i = 0; i < n * n; i++) {\
+        A[i] = 0;\
+    }\
+}";
+    ASSERT_DEATH(buildSPFComputationsFromCode(code),
+                 "Non-affine expression unsupported by SPF");
+}
+
 //! Set up and run tests
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
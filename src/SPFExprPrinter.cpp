@@ -0,0 +1,123 @@
+#include "SPFExprPrinter.hpp"
+
+#include <string>
+#include <vector>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/OperationKinds.h"
+#include "clang/Basic/CharInfo.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/* SPFExprPrinter */
+
+std::string SPFExprPrinter::print(Expr* expr, const ASTContext& Ctx) {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    print(expr, Ctx, os);
+    return os.str();
+}
+
+void SPFExprPrinter::print(Expr* expr, const ASTContext& Ctx,
+                           raw_ostream& os) {
+    SPFExprPrinter printer(Ctx, os);
+    printer.TraverseStmt(expr);
+}
+
+bool SPFExprPrinter::TraverseStmt(Stmt* stmt) {
+    if (!stmt) {
+        return true;
+    }
+    if (isa<ParenExpr>(stmt) || isa<ImplicitCastExpr>(stmt) ||
+        isa<CStyleCastExpr>(stmt) || isa<IntegerLiteral>(stmt) ||
+        isa<DeclRefExpr>(stmt) || isa<ArraySubscriptExpr>(stmt) ||
+        isa<UnaryOperator>(stmt) ||
+        (isa<BinaryOperator>(stmt) && !isa<CompoundAssignOperator>(stmt))) {
+        return RecursiveASTVisitor::TraverseStmt(stmt);
+    }
+    stmt->printPretty(os, nullptr, policy);
+    return true;
+}
+
+bool SPFExprPrinter::TraverseParenExpr(ParenExpr* expr) {
+    os << "(";
+    TraverseStmt(expr->getSubExpr());
+    os << ")";
+    return true;
+}
+
+bool SPFExprPrinter::TraverseImplicitCastExpr(ImplicitCastExpr* expr) {
+    return TraverseStmt(expr->getSubExpr());
+}
+
+bool SPFExprPrinter::TraverseCStyleCastExpr(CStyleCastExpr* expr) {
+    return TraverseStmt(expr->getSubExpr());
+}
+
+bool SPFExprPrinter::TraverseIntegerLiteral(IntegerLiteral* expr) {
+    expr->getValue().print(os, expr->getType()->isSignedIntegerType());
+    return true;
+}
+
+bool SPFExprPrinter::TraverseDeclRefExpr(DeclRefExpr* expr) {
+    os << expr->getNameInfo().getAsString();
+    return true;
+}
+
+bool SPFExprPrinter::TraverseArraySubscriptExpr(ArraySubscriptExpr* expr) {
+    // collect indexes from the innermost subscript outward, so that
+    // A[i][j] prints as A(i,j)
+    std::vector<Expr*> indexes;
+    Expr* base = expr;
+    while (ArraySubscriptExpr* access =
+               dyn_cast<ArraySubscriptExpr>(base->IgnoreParenImpCasts())) {
+        indexes.push_back(access->getIdx());
+        base = access->getBase();
+    }
+    TraverseStmt(base->IgnoreParenImpCasts());
+    os << "(";
+    for (auto it = indexes.rbegin(); it != indexes.rend(); ++it) {
+        if (it != indexes.rbegin()) {
+            os << ",";
+        }
+        TraverseStmt(*it);
+    }
+    os << ")";
+    return true;
+}
+
+bool SPFExprPrinter::TraverseUnaryOperator(UnaryOperator* expr) {
+    if (expr->isPostfix()) {
+        TraverseStmt(expr->getSubExpr());
+        os << UnaryOperator::getOpcodeStr(expr->getOpcode());
+    } else {
+        StringRef oper = UnaryOperator::getOpcodeStr(expr->getOpcode());
+        os << oper;
+        // casts are not printed, so "-(int)-i" would otherwise come out as
+        // a decrement, and "__real x" as one identifier
+        if (isa<UnaryOperator>(expr->getSubExpr()->IgnoreCasts()) ||
+            isIdentifierBody(oper.back())) {
+            os << " ";
+        }
+        TraverseStmt(expr->getSubExpr());
+    }
+    return true;
+}
+
+bool SPFExprPrinter::TraverseBinaryOperator(BinaryOperator* expr) {
+    TraverseStmt(expr->getLHS());
+    if (expr->getOpcode() == BO_EQ) {
+        os << " = ";
+    } else {
+        os << " " << expr->getOpcodeStr() << " ";
+    }
+    TraverseStmt(expr->getRHS());
+    return true;
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,460 @@
+#include "ScheduleOptimizer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AffineExpr.hpp"
+#include "DependenceAnalysis.hpp"
+#include "StmtContext.hpp"
+#include "Utils.hpp"
+#include "clang/AST/OperationKinds.h"
+#include "iegenlib.h"
+#include "isl/aff.h"
+#include "isl/ctx.h"
+#include "isl/map.h"
+#include "isl/options.h"
+#include "isl/schedule.h"
+#include "isl/set.h"
+#include "isl/union_map.h"
+#include "isl/union_set.h"
+#include "isl/val.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+//! Join strings with a separator
+static std::string join(const std::vector<std::string>& strings,
+                        const std::string& separator) {
+    std::string joined;
+    for (unsigned int i = 0; i < strings.size(); ++i) {
+        joined += (i == 0 ? "" : separator) + strings[i];
+    }
+    return joined;
+}
+
+//! Get an identifier isl accepts for a data space, which may be something
+//! like "s.x"; arrays and scalars are kept apart by a prefix
+static std::string getIslDataSpaceName(const std::string& dataSpace,
+                                       bool isScalar) {
+    std::string name = isScalar ? "V_" : "A_";
+    for (char c : dataSpace) {
+        name += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    return name;
+}
+
+//! Collect the schedule map of each statement (isl_union_map_foreach_map
+//! callback)
+static isl_stat collectMap(isl_map* map, void* user) {
+    auto* maps = static_cast<std::vector<isl_map*>*>(user);
+    unsigned int index =
+        std::stoul(std::string(isl_map_get_tuple_name(map, isl_dim_in) + 1));
+    if (index < maps->size() && !(*maps)[index]) {
+        (*maps)[index] = map;
+    } else {
+        isl_map_free(map);
+    }
+    return isl_stat_ok;
+}
+
+//! Take the expression of a single-piece isl_pw_aff
+//! (isl_pw_aff_foreach_piece callback)
+static isl_stat takeAff(isl_set* set, isl_aff* aff, void* user) {
+    isl_set_free(set);
+    *static_cast<isl_aff**>(user) = aff;
+    return isl_stat_ok;
+}
+
+//! Get an integer coefficient out of an isl_val, which is consumed
+static long takeNum(isl_val* val) {
+    long num = isl_val_get_num_si(val);
+    isl_val_free(val);
+    return num;
+}
+
+//! Get the IEGenLib form of an isl affine expression, like "i + 2*j - 1"
+//! \return false if it needs integer division
+static bool affToString(isl_aff* aff, const std::vector<std::string>& iterators,
+                        std::string& result) {
+    isl_val* denominator = isl_aff_get_denominator_val(aff);
+    bool isIntegral = isl_val_is_one(denominator) == isl_bool_true;
+    isl_val_free(denominator);
+    int numDivs = isl_aff_dim(aff, isl_dim_div);
+    for (int i = 0; i < numDivs && isIntegral; ++i) {
+        isIntegral = takeNum(isl_aff_get_coefficient_val(aff, isl_dim_div,
+                                                         i)) == 0;
+    }
+    if (!isIntegral) {
+        return false;
+    }
+
+    std::ostringstream os;
+    bool first = true;
+    auto addTerm = [&os, &first](long coefficient, const std::string& name) {
+        if (coefficient == 0) {
+            return;
+        }
+        if (first) {
+            os << (coefficient < 0 ? "-" : "");
+        } else {
+            os << (coefficient < 0 ? " - " : " + ");
+        }
+        first = false;
+        if (std::labs(coefficient) != 1) {
+            os << std::labs(coefficient) << "*";
+        }
+        os << name;
+    };
+    for (unsigned int i = 0; i < iterators.size(); ++i) {
+        addTerm(takeNum(isl_aff_get_coefficient_val(aff, isl_dim_in, i)),
+                iterators[i]);
+    }
+    int numParams = isl_aff_dim(aff, isl_dim_param);
+    for (int i = 0; i < numParams; ++i) {
+        addTerm(takeNum(isl_aff_get_coefficient_val(aff, isl_dim_param, i)),
+                isl_aff_get_dim_name(aff, isl_dim_param, i));
+    }
+    long constant = takeNum(isl_aff_get_constant_val(aff));
+    if (first) {
+        os << constant;
+    } else if (constant != 0) {
+        os << (constant < 0 ? " - " : " + ") << std::labs(constant);
+    }
+    result = os.str();
+    return true;
+}
+
+/* ScheduleOptimizer */
+
+ScheduleOptimizer::ScheduleOptimizer(
+    const std::vector<StmtContext>& stmtContexts, BuilderSession& session)
+    : stmtContexts(stmtContexts), session(session) {}
+
+bool ScheduleOptimizer::optimize(iegenlib::Computation* computation) {
+    schedules.clear();
+    reason.clear();
+    if (stmtContexts.empty()) {
+        reason = "there are no statements";
+        return false;
+    }
+
+    std::string domains;
+    std::string originalSchedules;
+    std::string reads;
+    std::string writes;
+    std::set<std::string> params;
+    if (!buildIslInput(domains, originalSchedules, reads, writes, params)) {
+        return false;
+    }
+    std::string paramPrefix;
+    if (!params.empty()) {
+        paramPrefix = "[" +
+                      join(std::vector<std::string>(params.begin(),
+                                                    params.end()),
+                           ", ") +
+                      "] -> ";
+    }
+    if (!computeSchedules(paramPrefix + domains,
+                          paramPrefix + originalSchedules,
+                          paramPrefix + reads, paramPrefix + writes)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(Utils::iegenlibMutex);
+    for (unsigned int i = 0; i < schedules.size(); ++i) {
+        computation->getStmt(i)->setExecutionSchedule(
+            new iegenlib::Relation(schedules[i]));
+    }
+    return true;
+}
+
+bool ScheduleOptimizer::buildIslInput(std::string& domains,
+                                      std::string& originalSchedules,
+                                      std::string& reads, std::string& writes,
+                                      std::set<std::string>& params) {
+    DependenceAnalysis analysis(stmtContexts, session);
+    analysis.analyze();
+    // isl takes parameters to be constant throughout, which only holds for
+    // scalars the function never writes
+    std::set<std::string> written;
+    for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+         ++stmtIndex) {
+        for (const auto& access : analysis.getAccesses(stmtIndex)) {
+            if (access.scalar && !access.isRead) {
+                written.insert(access.scalar->getNameAsString());
+            }
+        }
+    }
+
+    int scheduleDimension = 0;
+    for (const auto& stmtContext : stmtContexts) {
+        scheduleDimension =
+            std::max(scheduleDimension, stmtContext.schedule.getDimension());
+    }
+
+    std::vector<std::string> domainParts;
+    std::vector<std::string> scheduleParts;
+    std::vector<std::string> readParts;
+    std::vector<std::string> writeParts;
+    for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+         ++stmtIndex) {
+        const StmtContext& stmtContext = stmtContexts[stmtIndex];
+        std::vector<std::string> iterators = stmtContext.getIterators();
+        std::string tuple =
+            getTupleName(stmtIndex) + "[" + join(iterators, ", ") + "]";
+
+        // iteration space
+        std::vector<std::string> conditions;
+        for (const Constraint* constraint : stmtContext.getConstraints()) {
+            std::string lhs;
+            std::string rhs;
+            if (!toIsl(constraint->lhs, written, params, lhs) ||
+                !toIsl(constraint->rhs, written, params, rhs)) {
+                bool isIndexed = false;
+                for (const AffineExpr* side :
+                     {&constraint->lhs, &constraint->rhs}) {
+                    for (const auto& term : side->getTerms()) {
+                        isIndexed = isIndexed ||
+                                    term.kind == AffineTerm::Kind::UFCall;
+                    }
+                }
+                reason = "the iteration space of S" +
+                         std::to_string(stmtIndex) +
+                         (isIndexed ? " goes through an index array"
+                                    : " depends on a scalar the function "
+                                      "writes");
+                return false;
+            }
+            std::string oper =
+                constraint->oper == BO_EQ
+                    ? "="
+                    : BinaryOperator::getOpcodeStr(constraint->oper).str();
+            conditions.push_back(lhs + " " + oper + " " + rhs);
+        }
+        domainParts.push_back(
+            tuple +
+            (conditions.empty() ? "" : " : " + join(conditions, " and ")));
+
+        // source order
+        std::vector<std::string> times;
+        for (const auto& val : stmtContext.schedule.scheduleTuple) {
+            times.push_back(val.valueIsVar ? iterators[val.value]
+                                           : std::to_string(val.value));
+        }
+        times.resize(scheduleDimension, "0");
+        scheduleParts.push_back(tuple + " -> [" + join(times, ", ") + "]");
+
+        // accesses; an element which cannot be located, through an index
+        // array or a scalar the function writes, may be any element
+        unsigned int numUnknown = 0;
+        for (const auto& access : analysis.getAccesses(stmtIndex)) {
+            if (access.isUnknown) {
+                reason = "S" + std::to_string(stmtIndex) + " accesses " +
+                         access.dataSpace + ", which cannot be located";
+                return false;
+            }
+            std::vector<std::string> elements;
+            if (access.scalar) {
+                // a scalar private to some loops is a separate variable in
+                // each of their iterations
+                elements.assign(iterators.begin(),
+                                iterators.begin() + access.privateDepth);
+            } else {
+                for (unsigned int dim = 0; dim < access.subscripts.size();
+                     ++dim) {
+                    std::string element;
+                    if (!access.isAffine[dim] ||
+                        !toIsl(access.subscripts[dim], written, params,
+                               element)) {
+                        element = "spf_e" + std::to_string(numUnknown++);
+                    }
+                    elements.push_back(element);
+                }
+            }
+            (access.isRead ? readParts : writeParts)
+                .push_back(tuple + " -> " +
+                           getIslDataSpaceName(access.dataSpace,
+                                               access.scalar != nullptr) +
+                           "[" + join(elements, ", ") + "]");
+        }
+    }
+    domains = "{ " + join(domainParts, "; ") + " }";
+    originalSchedules = "{ " + join(scheduleParts, "; ") + " }";
+    reads = "{ " + join(readParts, "; ") + " }";
+    writes = "{ " + join(writeParts, "; ") + " }";
+    return true;
+}
+
+bool ScheduleOptimizer::computeSchedules(const std::string& domains,
+                                         const std::string& originalSchedules,
+                                         const std::string& reads,
+                                         const std::string& writes) {
+    isl_ctx* ctx = isl_ctx_alloc();
+    isl_options_set_on_error(ctx, ISL_ON_ERROR_CONTINUE);
+    // prefer parallelism in the outermost dimensions
+    isl_options_set_schedule_outer_coincidence(ctx, 1);
+
+    isl_union_set* domain = isl_union_set_read_from_str(ctx, domains.c_str());
+    isl_union_map* original =
+        isl_union_map_read_from_str(ctx, originalSchedules.c_str());
+    isl_union_map* readMap = isl_union_map_read_from_str(ctx, reads.c_str());
+    isl_union_map* writeMap = isl_union_map_read_from_str(ctx, writes.c_str());
+    if (!domain || !original || !readMap || !writeMap) {
+        isl_union_set_free(domain);
+        isl_union_map_free(original);
+        isl_union_map_free(readMap);
+        isl_union_map_free(writeMap);
+        isl_ctx_free(ctx);
+        reason = "isl could not read the statements";
+        return false;
+    }
+    original = isl_union_map_intersect_domain(original,
+                                              isl_union_set_copy(domain));
+    readMap = isl_union_map_intersect_domain(readMap,
+                                             isl_union_set_copy(domain));
+    writeMap = isl_union_map_intersect_domain(writeMap,
+                                              isl_union_set_copy(domain));
+
+    // pairs of instances touching the same element, at least one of them
+    // writing it, in their original order
+    isl_union_map* flow = isl_union_map_apply_range(
+        isl_union_map_copy(writeMap),
+        isl_union_map_reverse(isl_union_map_copy(readMap)));
+    isl_union_map* anti = isl_union_map_apply_range(
+        readMap, isl_union_map_reverse(isl_union_map_copy(writeMap)));
+    isl_union_map* output = isl_union_map_apply_range(
+        isl_union_map_copy(writeMap), isl_union_map_reverse(writeMap));
+    isl_union_map* dependences =
+        isl_union_map_union(isl_union_map_union(flow, anti), output);
+    dependences = isl_union_map_intersect(
+        dependences, isl_union_map_lex_lt_union_map(
+                         isl_union_map_copy(original), original));
+    dependences = isl_union_map_coalesce(dependences);
+
+    // dependences must be respected (validity), should not be carried by
+    // outer dimensions (coincidence), and should be short (proximity)
+    isl_schedule_constraints* constraints =
+        isl_schedule_constraints_on_domain(domain);
+    constraints = isl_schedule_constraints_set_validity(
+        constraints, isl_union_map_copy(dependences));
+    constraints = isl_schedule_constraints_set_coincidence(
+        constraints, isl_union_map_copy(dependences));
+    constraints =
+        isl_schedule_constraints_set_proximity(constraints, dependences);
+    isl_schedule* schedule =
+        isl_schedule_constraints_compute_schedule(constraints);
+    if (!schedule) {
+        isl_ctx_free(ctx);
+        reason = "isl found no schedule";
+        return false;
+    }
+    isl_union_map* scheduleMap = isl_schedule_get_map(schedule);
+    isl_schedule_free(schedule);
+
+    std::vector<isl_map*> maps(stmtContexts.size(), nullptr);
+    isl_union_map_foreach_map(scheduleMap, &collectMap, &maps);
+    isl_union_map_free(scheduleMap);
+
+    // statements may be scheduled in different numbers of dimensions, so
+    // pad them all to the longest
+    std::vector<std::vector<std::string>> times(stmtContexts.size());
+    unsigned int scheduleDimension = 0;
+    for (unsigned int stmtIndex = 0;
+         stmtIndex < stmtContexts.size() && reason.empty(); ++stmtIndex) {
+        if (!maps[stmtIndex]) {
+            reason = "S" + std::to_string(stmtIndex) + " never runs";
+            break;
+        }
+        std::vector<std::string> iterators =
+            stmtContexts[stmtIndex].getIterators();
+        isl_pw_multi_aff* timeFunctions =
+            isl_pw_multi_aff_from_map(maps[stmtIndex]);
+        maps[stmtIndex] = nullptr;
+        int numDims = isl_pw_multi_aff_dim(timeFunctions, isl_dim_out);
+        for (int dim = 0; dim < numDims && reason.empty(); ++dim) {
+            isl_pw_aff* time = isl_pw_multi_aff_get_pw_aff(timeFunctions, dim);
+            isl_aff* aff = nullptr;
+            std::string expr;
+            if (isl_pw_aff_n_piece(time) != 1 ||
+                isl_pw_aff_foreach_piece(time, &takeAff, &aff) < 0 ||
+                !affToString(aff, iterators, expr)) {
+                reason = "the schedule of S" + std::to_string(stmtIndex) +
+                         " is not affine";
+            }
+            times[stmtIndex].push_back(expr);
+            isl_aff_free(aff);
+            isl_pw_aff_free(time);
+        }
+        isl_pw_multi_aff_free(timeFunctions);
+        scheduleDimension =
+            std::max(scheduleDimension, (unsigned int)numDims);
+    }
+    for (isl_map* map : maps) {
+        isl_map_free(map);
+    }
+    isl_ctx_free(ctx);
+    if (!reason.empty()) {
+        return false;
+    }
+
+    for (unsigned int stmtIndex = 0; stmtIndex < stmtContexts.size();
+         ++stmtIndex) {
+        std::vector<std::string> iterators =
+            stmtContexts[stmtIndex].getIterators();
+        times[stmtIndex].resize(scheduleDimension, "0");
+        // name the time dimensions apart from the iterators
+        std::string prefix = "t";
+        while (std::any_of(iterators.begin(), iterators.end(),
+                           [&prefix](const std::string& iterator) {
+                               return iterator.compare(0, prefix.size(),
+                                                       prefix) == 0;
+                           })) {
+            prefix += "t";
+        }
+        std::vector<std::string> names;
+        std::vector<std::string> equalities;
+        for (unsigned int dim = 0; dim < scheduleDimension; ++dim) {
+            names.push_back(prefix + std::to_string(dim));
+            equalities.push_back(names.back() + " = " + times[stmtIndex][dim]);
+        }
+        schedules.push_back("{[" + join(iterators, ",") + "]->[" +
+                            join(names, ",") +
+                            "]: " + join(equalities, " && ") + "}");
+    }
+    return true;
+}
+
+bool ScheduleOptimizer::toIsl(const AffineExpr& expr,
+                              const std::set<std::string>& written,
+                              std::set<std::string>& params,
+                              std::string& result) {
+    std::ostringstream os;
+    os << expr.getConstant();
+    for (const auto& term : expr.getTerms()) {
+        if (term.kind == AffineTerm::Kind::UFCall ||
+            (term.kind == AffineTerm::Kind::Symbol &&
+             written.count(term.name))) {
+            return false;
+        }
+        if (term.kind == AffineTerm::Kind::Symbol) {
+            params.insert(term.name);
+        }
+        os << (term.coefficient < 0 ? " - " : " + ")
+           << std::abs(term.coefficient) << "*" << term.name;
+    }
+    result = os.str();
+    return true;
+}
+
+std::string ScheduleOptimizer::getTupleName(unsigned int stmtIndex) {
+    return "S" + std::to_string(stmtIndex);
+}
+
+}  // namespace spf_ie
@@ -1,128 +1,48 @@
 #include "StmtContext.hpp"
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
 #include <stack>
 #include <string>
-#include <tuple>
 #include <vector>
 
+#include "AffineExpr.hpp"
 #include "DataAccessHandler.hpp"
-#include "Driver.hpp"
 #include "ExecSchedule.hpp"
+#include "Instrumentation.hpp"
 #include "Utils.hpp"
 #include "clang/AST/Decl.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/OperationKinds.h"
 #include "clang/AST/Stmt.h"
+#include "iegenlib.h"
 
 using namespace clang;
 
 namespace spf_ie {
 
-/* StmtContext */
-
-StmtContext::StmtContext() {}
-
-StmtContext::StmtContext(StmtContext* other) {
-    iterators = other->iterators;
-    constraints = other->constraints;
-    schedule = other->schedule;
-    invariants = other->invariants;
-}
-
-std::string StmtContext::getIterSpaceString() {
-    std::ostringstream os;
-    if (!constraints.empty()) {
-        os << "{" << getItersTupleString() << ": ";
-        for (const auto& it : constraints) {
-            if (it != *constraints.begin()) {
-                os << " and ";
-            }
-            os << std::get<0>(*it) << " "
-               << Utils::binaryOperatorKindToString(std::get<2>(*it)) << " "
-               << std::get<1>(*it);
-        }
-        os << "}";
-    } else {
-        os << "{[]}";
-    }
-    return os.str();
-}
+/* Scope */
 
-std::string StmtContext::getExecScheduleString() {
-    std::ostringstream os;
-    os << "{" << getItersTupleString() << "->[";
-    for (const auto& it : schedule.scheduleTuple) {
-        if (it != *schedule.scheduleTuple.begin()) {
-            os << ",";
-        }
-        if (it->valueIsVar) {
-            os << it->var;
-        } else {
-            os << it->num;
-        }
-    }
-    os << "]}";
-    return os.str();
-}
-
-std::string StmtContext::getDataAccessString(ArrayAccess* access) {
-    std::ostringstream os;
-    std::vector<std::pair<std::string, std::string>> constraintsToAdd;
-    os << "{" << getItersTupleString() << "->[";
-    for (const auto& it : access->indexes) {
-        if (it != *access->indexes.begin()) {
-            os << ",";
-        }
-        std::vector<ArraySubscriptExpr*> subAccesses;
-        Utils::getExprArrayAccesses(it, subAccesses);
-        if (!subAccesses.empty()) {
-            std::string replacementName = Utils::getVarReplacementName();
-            os << replacementName;
-            constraintsToAdd.push_back(
-                {replacementName, exprToStringWithSafeArrays(it)});
-        } else if (isa<DeclRefExpr>(it->IgnoreParenImpCasts())) {
-            os << Utils::stmtToString(it);
-        } else {
-            // if the expression is not a nested access or single variable
-            // simply assign it to a replacement variable and use that
-            std::string replacementName = Utils::getVarReplacementName();
-            os << replacementName;
-            constraintsToAdd.push_back(
-                {replacementName, Utils::stmtToString(it)});
-        }
-    }
-    os << "]";
-    if (!constraintsToAdd.empty()) {
-        os << ": ";
-        for (const auto& constraint : constraintsToAdd) {
-            if (constraint != *constraintsToAdd.begin()) {
-                os << " && ";
-            }
-            os << constraint.first << " = " << constraint.second;
-        }
-    }
-    os << "}";
-    return os.str();
-}
-
-void StmtContext::enterFor(ForStmt* forStmt) {
+std::shared_ptr<const Scope> Scope::makeLoop(
+    std::shared_ptr<const Scope> parent, ForStmt* forStmt,
+    BuilderSession& session) {
+    const ASTContext& Ctx = session.getASTContext();
+    auto scope = std::make_shared<Scope>(Kind::Loop, parent, forStmt);
     std::string error;
     std::string errorReason;
 
     // initializer
     std::string initVar;
+    Expr* initVal = nullptr;
     if (BinaryOperator* init = dyn_cast<BinaryOperator>(forStmt->getInit())) {
-        makeAndInsertConstraint(init->getRHS(), init->getLHS(),
-                                BinaryOperatorKind::BO_LE);
-        initVar = Utils::stmtToString(init->getLHS());
+        initVar = session.getSourceText(init->getLHS());
+        initVal = init->getRHS();
     } else if (DeclStmt* init = dyn_cast<DeclStmt>(forStmt->getInit())) {
-        if (VarDecl* initDecl = dyn_cast<VarDecl>(init->getSingleDecl())) {
-            makeAndInsertConstraint(initDecl->getNameAsString(),
-                                    initDecl->getInit(),
-                                    BinaryOperatorKind::BO_LE);
+        VarDecl* initDecl = dyn_cast<VarDecl>(init->getSingleDecl());
+        if (initDecl && initDecl->hasInit()) {
             initVar = initDecl->getNameAsString();
+            initVal = initDecl->getInit();
         } else {
             error = "initializer";
             errorReason = "declarative initializer must declare a variable";
@@ -131,26 +51,34 @@ void StmtContext::enterFor(ForStmt* forStmt) {
         error = "initializer";
         errorReason = "must initialize iterator";
     }
+    // the iterator is in scope for the loop's own constraints
+    scope->iterator = initVar;
+    std::vector<std::string> iterators = getIterators(scope.get());
+    if (initVal) {
+        scope->constraints.push_back(Constraint(
+            AffineExpr::fromExpr(initVal, iterators, session),
+            AffineExpr::makeIterator(initVar, iterators.size() - 1),
+            BinaryOperatorKind::BO_LE));
+    }
 
     // condition
     if (BinaryOperator* cond = dyn_cast<BinaryOperator>(forStmt->getCond())) {
-        makeAndInsertConstraint(cond->getLHS(), cond->getRHS(),
-                                cond->getOpcode());
+        scope->constraints.push_back(makeConstraint(
+            cond->getLHS(), cond->getRHS(), cond->getOpcode(), iterators,
+            session));
         // add any data spaces accessed in the condition to loop invariants
-        std::vector<std::string> newInvariants;
         std::vector<ArraySubscriptExpr*> accessExprs;
         Utils::getExprArrayAccesses(cond->getLHS(), accessExprs);
         Utils::getExprArrayAccesses(cond->getRHS(), accessExprs);
         std::vector<std::pair<std::string, ArrayAccess>> accessComponents;
         for (const auto& accessExpr : accessExprs) {
             DataAccessHandler::buildDataAccess(accessExpr, true,
-                                               accessComponents);
+                                               accessComponents, session);
         }
         for (const auto& accessInfo : accessComponents) {
-            newInvariants.push_back(
-                Utils::stmtToString(accessInfo.second.base));
+            scope->invariants.push_back(
+                session.getSPFString(accessInfo.second.base));
         }
-        invariants.push_back(newInvariants);
     } else {
         error = "condition";
         errorReason = "must be a binary operation";
@@ -168,7 +96,7 @@ void StmtContext::enterFor(ForStmt* forStmt) {
         if (oper == BO_AddAssign || oper == BO_SubAssign) {
             // operator is += or -=
             Expr::EvalResult result;
-            if (incOper->getRHS()->EvaluateAsInt(result, *Context)) {
+            if (incOper->getRHS()->EvaluateAsInt(result, Ctx)) {
                 llvm::APSInt incVal = result.Val.getInt();
                 validIncrement = (oper == BO_AddAssign && incVal == 1) ||
                                  (oper == BO_SubAssign && incVal == -1);
@@ -180,20 +108,20 @@ void StmtContext::enterFor(ForStmt* forStmt) {
             // (e.g. with i = i + 1, this is i + 1)
             BinaryOperator* secondOp = cast<BinaryOperator>(incOper->getRHS());
             // Get variable being incremented
-            std::string iterStr = Utils::stmtToString(incOper->getLHS());
+            std::string iterStr = Utils::stmtToString(incOper->getLHS(), Ctx);
             if (secondOp->getOpcode() == BO_Add) {
                 // Get our lh and rh expression, also in string form
                 Expr* lhs = secondOp->getLHS();
                 Expr* rhs = secondOp->getRHS();
-                std::string lhsStr = Utils::stmtToString(lhs);
-                std::string rhsStr = Utils::stmtToString(rhs);
+                std::string lhsStr = Utils::stmtToString(lhs, Ctx);
+                std::string rhsStr = Utils::stmtToString(rhs, Ctx);
                 Expr::EvalResult result;
                 // one side must be iter var, other must be 1
                 validIncrement = (lhsStr.compare(iterStr) == 0 &&
-                                  rhs->EvaluateAsInt(result, *Context) &&
+                                  rhs->EvaluateAsInt(result, Ctx) &&
                                   result.Val.getInt() == 1) ||
                                  (rhsStr.compare(iterStr) == 0 &&
-                                  lhs->EvaluateAsInt(result, *Context) &&
+                                  lhs->EvaluateAsInt(result, Ctx) &&
                                   result.Val.getInt() == 1);
             }
         }
@@ -204,72 +132,181 @@ void StmtContext::enterFor(ForStmt* forStmt) {
     }
 
     if (!error.empty()) {
-        Utils::printErrorAndExit(
-            "Invalid " + error + " in for loop -- " + errorReason, forStmt);
-    } else {
-        iterators.push_back(initVar);
-        schedule.pushValue(initVar);
+        Utils::throwError(
+            "Invalid " + error + " in for loop -- " + errorReason, forStmt,
+            Ctx);
     }
+    return scope;
 }
 
-void StmtContext::exitFor() {
-    constraints.pop_back();
-    constraints.pop_back();
-    iterators.pop_back();
-    schedule.popValue();
-    schedule.popValue();
-    invariants.pop_back();
-}
-
-void StmtContext::enterIf(IfStmt* ifStmt, bool invert) {
+std::shared_ptr<const Scope> Scope::makeGuard(
+    std::shared_ptr<const Scope> parent, IfStmt* ifStmt, bool invert,
+    BuilderSession& session) {
+    auto scope = std::make_shared<Scope>(Kind::Guard, parent, ifStmt);
     if (BinaryOperator* cond = dyn_cast<BinaryOperator>(ifStmt->getCond())) {
-        makeAndInsertConstraint(
+        scope->constraints.push_back(makeConstraint(
             cond->getLHS(), cond->getRHS(),
             (invert ? BinaryOperator::negateComparisonOp(cond->getOpcode())
-                    : cond->getOpcode()));
+                    : cond->getOpcode()),
+            getIterators(scope.get()), session));
     } else {
-        Utils::printErrorAndExit(
-            "If statement condition must be a binary operation", ifStmt);
+        Utils::throwError(
+            "If statement condition must be a binary operation", ifStmt,
+            session.getASTContext());
     }
+    return scope;
 }
 
-void StmtContext::exitIf() { constraints.pop_back(); }
+std::vector<std::string> Scope::getIterators(const Scope* scope) {
+    std::vector<std::string> iterators;
+    for (; scope; scope = scope->parent.get()) {
+        if (scope->kind == Kind::Loop) {
+            iterators.push_back(scope->iterator);
+        }
+    }
+    std::reverse(iterators.begin(), iterators.end());
+    return iterators;
+}
 
-void StmtContext::makeAndInsertConstraint(Expr* lower, Expr* upper,
-                                          BinaryOperatorKind oper) {
-    makeAndInsertConstraint(exprToStringWithSafeArrays(lower), upper, oper);
+std::vector<const Constraint*> Scope::getConstraints(const Scope* scope) {
+    std::vector<const Constraint*> constraints;
+    for (; scope; scope = scope->parent.get()) {
+        for (auto it = scope->constraints.rbegin();
+             it != scope->constraints.rend(); ++it) {
+            constraints.push_back(&*it);
+        }
+    }
+    std::reverse(constraints.begin(), constraints.end());
+    return constraints;
 }
 
-void StmtContext::makeAndInsertConstraint(std::string lower, Expr* upper,
-                                          BinaryOperatorKind oper) {
+bool Scope::isInvariant(const Scope* scope, const std::string& dataSpace) {
+    for (; scope; scope = scope->parent.get()) {
+        if (std::find(scope->invariants.begin(), scope->invariants.end(),
+                      dataSpace) != scope->invariants.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Constraint Scope::makeConstraint(Expr* lower, Expr* upper,
+                                 BinaryOperatorKind oper,
+                                 const std::vector<std::string>& iterators,
+                                 BuilderSession& session) {
     if (oper == BinaryOperatorKind::BO_NE) {
-        Utils::printErrorAndExit(
+        const ASTContext& Ctx = session.getASTContext();
+        Utils::throwError(
             "Not-equal conditions are unsupported by SPF: in condition " +
-                lower + " != " + Utils::stmtToString(upper),
-            upper);
+                Utils::stmtToString(lower, Ctx) + " != " +
+                Utils::stmtToString(upper, Ctx),
+            upper, Ctx);
     }
-    constraints.push_back(
-        std::make_shared<
-            std::tuple<std::string, std::string, BinaryOperatorKind>>(
-            lower, exprToStringWithSafeArrays(upper), oper));
+    return Constraint(AffineExpr::fromExpr(lower, iterators, session),
+                      AffineExpr::fromExpr(upper, iterators, session), oper);
 }
 
-std::string StmtContext::exprToStringWithSafeArrays(Expr* expr) {
-    std::string initialStr = Utils::stmtToString(expr);
-    std::vector<ArraySubscriptExpr*> accesses;
-    Utils::getExprArrayAccesses(expr, accesses);
-    for (const auto& access : accesses) {
-        std::vector<std::pair<std::string, ArrayAccess>> accessComponents;
-        DataAccessHandler::buildDataAccess(access, true, accessComponents);
-        std::string accessStr = DataAccessHandler::makeStringForArrayAccess(
-            &accessComponents.back().second, accessComponents);
-        initialStr = Utils::replaceInString(
-            initialStr, Utils::stmtToString(access), accessStr);
+/* StmtContext */
+
+StmtContext::StmtContext(BuilderSession* session,
+                         std::shared_ptr<const Scope> scope,
+                         const ExecSchedule& schedule)
+    : session(session), stmt(nullptr), scope(scope), schedule(schedule) {}
+
+std::vector<std::string> StmtContext::getIterators() const {
+    return Scope::getIterators(scope.get());
+}
+
+std::vector<const Constraint*> StmtContext::getConstraints() const {
+    return Scope::getConstraints(scope.get());
+}
+
+std::string StmtContext::getIterSpaceString() const {
+    std::vector<const Constraint*> constraints = getConstraints();
+    std::ostringstream os;
+    if (!constraints.empty()) {
+        os << "{" << getItersTupleString(getIterators()) << ": ";
+        for (const auto& it : constraints) {
+            if (it != *constraints.begin()) {
+                os << " and ";
+            }
+            os << it->toString();
+        }
+        os << "}";
+    } else {
+        os << "{[]}";
+    }
+    return os.str();
+}
+
+iegenlib::Set* StmtContext::buildIterSpace() const {
+    std::vector<std::string> iterators = getIterators();
+    iegenlib::TupleDecl tupleDecl(iterators.size());
+    for (unsigned int i = 0; i < iterators.size(); ++i) {
+        tupleDecl.setTupleElem(i, iterators[i]);
+    }
+    iegenlib::Conjunction* conjunction = new iegenlib::Conjunction(tupleDecl);
+    std::vector<const Constraint*> constraints = getConstraints();
+    for (const auto& constraint : constraints) {
+        constraint->addToConjunction(conjunction);
+    }
+    Instrumentation::count(Instrumentation::Counter::Constraints,
+                           constraints.size());
+    iegenlib::Set* iterSpace = new iegenlib::Set(iterators.size());
+    iterSpace->addConjunction(conjunction);
+    return iterSpace;
+}
+
+std::string StmtContext::getExecScheduleString() const {
+    return schedule.toString(getIterators());
+}
+
+iegenlib::Relation* StmtContext::buildExecSchedule() const {
+    return schedule.toRelation(getIterators());
+}
+
+std::string StmtContext::getDataAccessString(ArrayAccess* access) const {
+    std::ostringstream os;
+    std::vector<std::pair<std::string, std::string>> constraintsToAdd;
+    os << "{" << getItersTupleString(getIterators()) << "->[";
+    for (const auto& it : access->indexes) {
+        if (it != *access->indexes.begin()) {
+            os << ",";
+        }
+        std::vector<ArraySubscriptExpr*> subAccesses;
+        Utils::getExprArrayAccesses(it, subAccesses);
+        if (!subAccesses.empty()) {
+            std::string replacementName = session->getVarReplacementName();
+            os << replacementName;
+            constraintsToAdd.push_back(
+                {replacementName, session->getSPFString(it)});
+        } else if (isa<DeclRefExpr>(it->IgnoreParenImpCasts())) {
+            os << session->getSPFString(it);
+        } else {
+            // if the expression is not a nested access or single variable
+            // simply assign it to a replacement variable and use that
+            std::string replacementName = session->getVarReplacementName();
+            os << replacementName;
+            constraintsToAdd.push_back(
+                {replacementName, session->getSPFString(it)});
+        }
+    }
+    os << "]";
+    if (!constraintsToAdd.empty()) {
+        os << ": ";
+        for (const auto& constraint : constraintsToAdd) {
+            if (constraint != *constraintsToAdd.begin()) {
+                os << " && ";
+            }
+            os << constraint.first << " = " << constraint.second;
+        }
     }
-    return initialStr;
+    os << "}";
+    return os.str();
 }
 
-std::string StmtContext::getItersTupleString() {
+std::string StmtContext::getItersTupleString(
+    const std::vector<std::string>& iterators) {
     std::ostringstream os;
     os << "[";
     for (const auto& it : iterators) {
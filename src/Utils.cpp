@@ -1,9 +1,9 @@
 #include "Utils.hpp"
 
 #include <map>
+#include <mutex>
 #include <string>
 
-#include "Driver.hpp"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/Stmt.h"
@@ -15,42 +15,43 @@ using namespace clang;
 
 namespace spf_ie {
 
-void Utils::printErrorAndExit(std::string message) {
-    printErrorAndExit(message, nullptr);
+void Utils::throwError(std::string message) {
+    throw SPFError(message, SourceLocation());
 }
 
-void Utils::printErrorAndExit(std::string message, clang::Stmt* stmt) {
-    llvm::errs() << "ERROR: " << message << "\n";
-    if (stmt) {
-        llvm::errs() << "At "
-                     << stmt->getBeginLoc().printToString(
-                            Context->getSourceManager())
-                     << ":\n"
-                     << stmtToString(stmt) << "\n";
+void Utils::throwError(std::string message, clang::Stmt* stmt,
+                       const ASTContext& Ctx) {
+    if (!stmt) {
+        throwError(message);
+    }
+    throw SPFError(message, stmt->getBeginLoc(), stmtToString(stmt, Ctx));
+}
+
+void Utils::printErrorAndExit(const SPFError& error, const ASTContext& Ctx) {
+    llvm::errs() << "ERROR: " << error.what() << "\n";
+    if (error.getLocation().isValid()) {
+        std::string location;
+        {
+            std::lock_guard<std::mutex> lock(sourceManagerMutex);
+            location =
+                error.getLocation().printToString(Ctx.getSourceManager());
+        }
+        llvm::errs() << "At " << location << ":\n"
+                     << error.getContext() << "\n";
     }
     exit(1);
 }
 
 void Utils::printSmallLine() { llvm::outs() << "---------------\n"; }
 
-std::string Utils::stmtToString(clang::Stmt* stmt) {
+std::string Utils::stmtToString(clang::Stmt* stmt, const ASTContext& Ctx) {
+    std::lock_guard<std::mutex> lock(sourceManagerMutex);
     return Lexer::getSourceText(
                CharSourceRange::getTokenRange(stmt->getSourceRange()),
-               Context->getSourceManager(), Context->getLangOpts())
+               Ctx.getSourceManager(), Ctx.getLangOpts())
         .str();
 }
 
-std::string Utils::replaceInString(std::string input, std::string toFind,
-                                   std::string replaceWith) {
-    size_t pos = input.find(toFind);
-    if (pos == std::string::npos) {
-        return input;
-    } else {
-        return replaceInString(input.replace(pos, toFind.length(), replaceWith),
-                               toFind, replaceWith);
-    }
-}
-
 void Utils::getExprArrayAccesses(
     Expr* expr, std::vector<ArraySubscriptExpr*>& currentList) {
     Expr* usableExpr = expr->IgnoreParenImpCasts();
@@ -63,13 +64,9 @@ void Utils::getExprArrayAccesses(
     }
 }
 
-std::string Utils::getVarReplacementName() {
-    return REPLACEMENT_VAR_BASE_NAME + std::to_string(replacementVarNumber++);
-}
-
 std::string Utils::binaryOperatorKindToString(BinaryOperatorKind bo) {
     if (!operatorStrings.count(bo)) {
-        printErrorAndExit("Invalid operator type encountered.");
+        throwError("Invalid operator type encountered.");
     }
     return operatorStrings.at(bo);
 }
@@ -79,6 +76,8 @@ const std::map<BinaryOperatorKind, std::string> Utils::operatorStrings = {
     {BinaryOperatorKind::BO_GT, ">"}, {BinaryOperatorKind::BO_GE, ">="},
     {BinaryOperatorKind::BO_EQ, "="}, {BinaryOperatorKind::BO_NE, "!="}};
 
-unsigned int Utils::replacementVarNumber = 0;
+std::mutex Utils::iegenlibMutex;
+
+std::mutex Utils::sourceManagerMutex;
 
 }  // namespace spf_ie